@@ -10,6 +10,6 @@ include/external/imgui/imgui_widgets.cpp
 include/external/imgui/imgui_impl_glfw.cpp
 include/external/imgui/imgui_impl_opengl3.cpp"
 
-if (g++ src/*.cpp $IMGUI_SOURCES include/external/glad/glad.c -I./include -I./include/external -lglfw -ldl -lGL -lfmt -o sven); then
+if (g++ src/*.cpp $IMGUI_SOURCES include/external/glad/glad.c -I./include -I./include/external -lglfw -ldl -lGL -lfmt -pthread -o sven); then
     ./sven
 fi
\ No newline at end of file
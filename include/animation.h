@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace tinygltf
+{
+class Model;
+}
+
+class TransformHierarchy;
+struct CompressedClip;
+
+enum class AnimTarget : uint8_t
+{
+    Translation,
+    Rotation,
+    Scale
+};
+
+enum class AnimInterpolation : uint8_t
+{
+    Linear,
+    Step,
+    CubicSpline
+};
+
+// One animated property of one node. Its keys live in the clip's shared arrays.
+struct AnimChannel
+{
+    int node;
+    AnimTarget target;
+    AnimInterpolation interpolation;
+    uint32_t firstKey; // Into AnimationClip::times
+    uint32_t keyCount;
+    uint32_t firstValue; // Into AnimationClip::values, three per key for CubicSpline
+};
+
+// A glTF animation compiled for sampling: all channels' key times and values sit in two flat
+// arrays, so a sample is index arithmetic with no strings or allocations
+struct AnimationClip
+{
+    std::string name;
+    float duration = 0.0f;
+    std::vector<AnimChannel> channels;
+    std::vector<float> times;
+    // xyz for translation and scale, xyzw quaternion for rotation. CubicSpline keys are stored as
+    // in-tangent, value, out-tangent.
+    std::vector<glm::vec4> values;
+};
+
+// Key each channel landed on last time. Playback mostly moves forward a key or so per frame, so
+// the next lookup usually finishes right there instead of searching.
+struct AnimationCursor
+{
+    std::vector<uint32_t> keys;
+    // Compressed clips keep the two keys around each channel's decoded, two values per channel,
+    // for the clip they were decoded from. decodedKeys[i] is the first of the pair, or UINT32_MAX.
+    const CompressedClip* decodedClip = nullptr;
+    std::vector<uint32_t> decodedKeys;
+    std::vector<glm::vec4> decoded;
+};
+
+// Every animation in the model. Channels glTF defines but we can't play (morph weights) are left
+// out.
+std::vector<AnimationClip> compileAnimationClips(const tinygltf::Model& model);
+
+// Writes the value of every channel at time to out, one per channel in clip order. Without a
+// cursor each lookup is a binary search.
+void sampleClip(const AnimationClip& clip, float time, AnimationCursor* cursor, glm::vec4* out);
+
+// Sets the nodes the channels animate to values sampled from their clip, one per channel. Call
+// update() on the hierarchy after.
+void applyChannels(const std::vector<AnimChannel>& channels, const glm::vec4* values,
+                   TransformHierarchy& hierarchy);
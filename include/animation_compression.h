@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "animation.h"
+
+// Largest error a dropped key may leave behind, measured against the authored curve
+struct AnimCompressionSettings
+{
+    float translationTolerance = 0.0005f; // Meters
+    float rotationTolerance = 0.0005f;    // Radians
+    float scaleTolerance = 0.0005f;
+    float resampleRate = 30.0f; // Keys per second CubicSpline channels are resampled to
+};
+
+// An AnimationClip at a fraction of the size. Every key is a 16 bit time and three 16 bit words:
+// rotations are smallest-three quaternions, translations and scales are fractions of their
+// channel's range. Keys that interpolation rebuilds within tolerance are gone.
+struct CompressedClip
+{
+    std::string name;
+    float duration = 0.0f;
+    float timeScale = 0.0f; // Seconds to time units, 65535 is the end of the clip
+    // Same channels as the source. firstKey indexes times and words, firstValue the range of a
+    // translation or scale channel. CubicSpline channels come out Linear.
+    std::vector<AnimChannel> channels;
+    // value = rangeMin + word * rangeStep
+    std::vector<glm::vec3> rangeMin;
+    std::vector<glm::vec3> rangeStep;
+    std::vector<uint16_t> times;
+    std::vector<uint16_t> words; // Three per key
+};
+
+struct AnimCompressionReport
+{
+    size_t rawKeys = 0;
+    size_t compressedKeys = 0;
+    size_t rawBytes = 0;
+    size_t compressedBytes = 0;
+    // Against the source clip, at its key times and halfway between them
+    float maxTranslationError = 0.0f;
+    float maxRotationError = 0.0f; // Radians
+    float maxScaleError = 0.0f;
+};
+
+CompressedClip compressClip(const AnimationClip& clip, const AnimCompressionSettings& settings,
+                            AnimCompressionReport* report = nullptr);
+
+// Same output as sampleClip on the source clip, within the tolerances
+void sampleCompressedClip(const CompressedClip& clip, float time, AnimationCursor* cursor,
+                          glm::vec4* out);
+
+size_t clipBytes(const AnimationClip& clip);
+size_t clipBytes(const CompressedClip& clip);
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "cooked_model.h"
+#include "mesh_pool.h"
+#include "mesh_simplify.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+
+enum class AssetState : uint8_t
+{
+    Queued,    // Not started, drawn as a placeholder
+    Loading,   // A worker is reading, parsing and decoding it
+    Uploading, // Decoded, going to the GPU a budget at a time
+    Resident,
+    Failed // Stays a placeholder
+};
+
+struct AssetStreamSettings
+{
+    // Bytes staged for the GPU per frame at most, also the size of each staging buffer
+    size_t uploadBudget = 4 << 20;
+    int maxJobsInFlight = 4;
+    // Uses within one square of this many meters count once when ranking assets by distance
+    float useCellSize = 32.0f;
+    // Meters the view moves before pending assets are ranked again
+    float reprioritizeDistance = 4.0f;
+};
+
+// The triangles of an asset that share a base color texture, drawn as one instanced batch
+struct StreamedBatch
+{
+    MeshRange lods[MAX_MESH_LODS]; // A batch with fewer LODs than its asset repeats its last
+    GLuint texture = 0;            // The placeholder for primitives without one
+};
+
+// What a renderer draws for an asset. It has no batches until it's resident.
+struct StreamedAsset
+{
+    std::vector<StreamedBatch> batches;
+    int lodCount = 0;
+    VertexQuantization quantization; // Of the packed positions, set it on the shader
+    glm::vec3 boundsMin{ 0.0f };     // Known from Uploading on
+    glm::vec3 boundsMax{ 0.0f };
+};
+
+using AssetHandle = uint32_t;
+
+// Static glTF models loaded in the background. Workers do the file I/O, parsing and image
+// decoding, bake node transforms into the vertices and simplify the meshes into LODs. The GL
+// thread then moves the results to the GPU through a ring of staging buffers, vertices, indices
+// and one mip level at a time, within a byte budget per frame. Assets nearest to where they're
+// used go first. A texture whose contents another asset already brought in is shared through
+// the cache instead of uploaded.
+class AssetStreamer
+{
+public:
+    explicit AssetStreamer(const AssetStreamSettings& settings = AssetStreamSettings());
+    ~AssetStreamer();
+
+    AssetStreamer(const AssetStreamer&) = delete;
+    AssetStreamer& operator=(const AssetStreamer&) = delete;
+
+    // Without a pool (or workers) one asset a frame loads on the calling thread
+    void setThreadPool(ThreadPool* pool) { m_threadPool = pool; }
+    // Needed before update(), and has to outlive the streamer
+    void setTextureCache(TextureCache* cache) { m_textureCache = cache; }
+    void initialize();
+
+    // Same path, same handle. Loading starts in update().
+    AssetHandle request(const std::string& path);
+    // A place the asset is used, the one closest to the view (to within useCellSize) decides
+    // its priority
+    void addUse(AssetHandle asset, const glm::vec3& position);
+
+    // Starts the nearest queued assets, collects finished ones and uploads within the budget
+    void update(const glm::vec3& viewPos);
+
+    AssetState getState(AssetHandle asset) const { return m_assets[asset].state; }
+    const StreamedAsset& getAsset(AssetHandle asset) const { return m_assets[asset].data; }
+    const std::string& getPath(AssetHandle asset) const { return m_assets[asset].path; }
+    size_t getAssetCount() const { return m_assets.size(); }
+    MeshPool& getMeshPool() { return m_meshPool; }
+    GLuint getPlaceholderTexture() const { return m_placeholderTexture; }
+
+    int getResidentCount() const { return m_residentCount; }
+    int getPendingCount() const { return m_pendingCount; }
+    size_t getUploadedBytes() const { return m_uploadedBytes; } // Last frame
+
+private:
+    struct DecodedBatch
+    {
+        MeshLod lods[MAX_MESH_LODS]; // Into the indices, padded with the last
+        int texture;                 // Into the textures, -1 for the placeholder
+    };
+
+    // CPU side result of a worker, owned jointly with the job so dropping it early is fine
+    struct Decoded
+    {
+        std::vector<MeshVertex> vertices; // Emptied once packed
+        std::vector<StaticVertex> packed;
+        VertexQuantization quantization;
+        std::vector<uint32_t> indices; // Every batch's LODs, one after the other
+        std::vector<DecodedBatch> batches;
+        int lodCount = 0;
+        std::vector<CookedTexture> textures; // Base colors, distinct by hash
+        std::vector<CookedMip> mips;         // RGBA8, only those of textures left to upload
+        std::vector<uint8_t> pixels;
+        bool ok = false;
+        std::atomic<bool> ready{ false };
+    };
+
+    struct Asset
+    {
+        std::string path;
+        AssetState state = AssetState::Queued;
+        StreamedAsset data;
+        std::vector<glm::ivec2> useCells; // Of the x/z grid, made unique when ranked
+        bool useCellsUnique = true;
+        float distance = 0.0f; // From the view to the closest use cell, refreshed until resident
+        std::shared_ptr<Decoded> decoded;
+        // Uploading: vertices, indices, then each mip level, into these
+        size_t nextItem = 0;
+        MeshRange mesh;
+        std::vector<GLuint> textures; // Per decoded texture, cache references
+    };
+
+    struct StagingBuffer
+    {
+        GLuint buffer = 0;
+        GLsync fence = nullptr; // Set once the copies out of it are queued
+    };
+
+    static void decode(const std::string& path, Decoded& decoded);
+    static size_t itemCount(const Decoded& decoded) { return 2 + decoded.mips.size(); }
+    static size_t itemSize(const Decoded& decoded, size_t item);
+    static const uint8_t* itemData(const Decoded& decoded, size_t item);
+
+    void startJobs();
+    // Shares the textures of a newly decoded asset, or creates them for the mips to fill
+    void acquireTextures(Asset& asset);
+    void upload();
+    // Queues the GPU copy of an item staged at offset bytes into source
+    void finishItem(Asset& asset, size_t item, GLuint source, size_t offset);
+
+    AssetStreamSettings m_settings;
+    ThreadPool* m_threadPool;
+    TextureCache* m_textureCache;
+    MeshPool m_meshPool;
+    GLuint m_placeholderTexture;
+    StagingBuffer m_staging[3]; // One per frame the GPU may still be copying from
+    uint32_t m_frame;
+
+    std::vector<Asset> m_assets;
+    std::unordered_map<std::string, AssetHandle> m_handles; // By path
+    std::vector<AssetHandle> m_order; // Scratch for sorting by distance
+    glm::vec3 m_rankedFrom;           // View position the distances were last taken from
+    bool m_rankingStale;              // New uses since then
+    int m_jobsInFlight;
+    int m_residentCount;
+    int m_pendingCount;
+    size_t m_uploadedBytes;
+};
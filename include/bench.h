@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Offline micro-benchmarks, run with `./sven --bench [name...]` before any window is created
+int runBenchmarks(const std::vector<std::string>& names);
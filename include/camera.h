@@ -29,6 +29,9 @@ public:
     void processMouseMovement(float xoffset, float yoffset);
     void processMouseScroll(float yoffset);
     void updatePosition(glm::vec3 newTarget);
+    // Moves the eye, e.g. in front of an occluder, still looking at the target. Lasts until the
+    // next update recomputes the orbit.
+    void setPosition(glm::vec3 newPosition);
 
     std::array<FrustumPlane, 6> getFrustumPlanes(float aspectRatio) const;
     glm::mat4 getViewMatrix() const;
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "animation.h"
+#include "animation_compression.h"
+#include "mesh_pool.h"
+#include "skinning.h"
+#include "texture_cache.h"
+#include "transform_hierarchy.h"
+#include "vertex_format.h"
+
+namespace tinygltf
+{
+class Model;
+struct Image;
+}
+
+// A character cooked offline into the layout the runtime wants, so loading is a mmap and a few
+// uploads straight out of it with no parsing, decoding or per vertex work. The file is a header
+// followed by 16 byte aligned sections of plain structs, little endian, read in place.
+constexpr uint32_t COOKED_MODEL_MAGIC = 0x4b4f4f43; // "COOK"
+// Bump whenever any struct below or the cooking changes, older files are then cooked again
+constexpr uint32_t COOKED_MODEL_VERSION = 4;
+
+// count elements starting offset bytes into the file
+struct CookedRange
+{
+    uint64_t offset;
+    uint64_t count;
+};
+
+// One glTF primitive. Indices count from the model's first vertex, so the whole model can be
+// drawn as one range.
+struct CookedPart
+{
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    int32_t texture; // Base color of its material, -1 without one
+};
+
+// A CompressedClip, its arrays are slices of the shared clip sections
+struct CookedClip
+{
+    float duration;
+    float timeScale;
+    uint32_t firstChannel;
+    uint32_t channelCount;
+    uint32_t firstRange; // Into rangeMin and rangeStep
+    uint32_t rangeCount;
+    uint32_t firstKey; // Into times, three words per key from firstKey * 3
+    uint32_t keyCount;
+    uint32_t firstName; // Into names, not null terminated
+    uint32_t nameLength;
+};
+
+// RGBA8, levels down to 1x1
+struct CookedTexture
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t firstMip;
+    uint32_t mipCount;
+    TextureHash hash; // Of the first level, the key it's shared under at runtime
+};
+
+struct CookedMip
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset; // Into pixels, in bytes
+    uint64_t size;
+};
+
+struct CookedHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileSize;
+
+    CookedRange vertices;            // SkinnedVertex
+    CookedRange indices;             // uint32_t
+    CookedRange parts;               // CookedPart
+    CookedRange nodes;               // NodeTransform, glTF order
+    CookedRange attachments;         // int32_t node of each palette slot past the skin joints
+    CookedRange skinJoints;          // int32_t node of each joint
+    CookedRange inverseBindMatrices; // glm::mat4, one per joint
+    CookedRange clips;               // CookedClip
+    CookedRange channels;            // AnimChannel
+    CookedRange rangeMin;            // glm::vec3
+    CookedRange rangeStep;           // glm::vec3
+    CookedRange times;               // uint16_t
+    CookedRange words;               // uint16_t
+    CookedRange names;               // char
+    CookedRange textures;            // CookedTexture
+    CookedRange mips;                // CookedMip
+    CookedRange pixels;              // uint8_t
+
+    int32_t baseColorTexture; // Of the first textured part, -1 without one
+    VertexQuantization quantization;
+    uint32_t reserved[1];
+};
+
+static_assert(sizeof(CookedHeader) % 16 == 0, "Sections start 16 byte aligned");
+static_assert(std::is_trivially_copyable<SkinnedVertex>::value &&
+                  std::is_trivially_copyable<NodeTransform>::value &&
+                  std::is_trivially_copyable<AnimChannel>::value,
+              "Cooked data is read in place");
+static_assert(sizeof(SkinnedVertex) == 28 && sizeof(NodeTransform) == 112 &&
+                  sizeof(AnimChannel) == 20 && sizeof(glm::vec3) == 12,
+              "Changing a cooked struct needs a COOKED_MODEL_VERSION bump");
+
+// Every primitive of every mesh node, merged, indices counting from the first vertex. Skinned
+// vertices keep up to four joints of the first skin, everything else is weighted fully to its
+// node's attachment slot, numbered from skinJointCount. Primitives without normals get smooth
+// ones, tangents without their own come from the texcoords. Each part's texture is left as the glTF
+// image of its material's base color, for the caller to number its own way.
+void cookGeometry(const tinygltf::Model& model, size_t skinJointCount,
+                  std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices,
+                  std::vector<CookedPart>& parts, std::vector<int32_t>& attachments);
+// Reorders each part's triangles for the vertex cache and overdraw, then the vertices for fetch
+// order, dropping unused ones and moving the parts' vertex ranges along
+void optimizeParts(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices,
+                   std::vector<CookedPart>& parts);
+// Converts the image to RGBA8, hashes it and box filters it down to 1x1, false for formats we
+// can't read
+bool cookTexture(const tinygltf::Image& image, CookedTexture& texture,
+                 std::vector<CookedMip>& mips, std::vector<uint8_t>& pixels);
+// The glTF image of the material's base color texture, -1 without
+int findBaseColorImage(const tinygltf::Model& model, int material);
+// Cooks every image the parts draw with, once each, also when two images hold the same pixels,
+// and renumbers the parts' textures from glTF images to indices into textures. Parts whose image
+// can't be read end up with -1, like those without one.
+void cookPartTextures(const tinygltf::Model& model, const std::string& sourcePath,
+                      std::vector<CookedPart>& parts, std::vector<CookedTexture>& textures,
+                      std::vector<CookedMip>& mips, std::vector<uint8_t>& pixels);
+
+// Loads a .glb or .gltf and cooks it. Meshes of plain nodes (weapons, hats) are weighted to a
+// palette slot of their own after the skin joints, as JointPaletteBuffer draws them.
+bool cookModel(const std::string& sourcePath, std::vector<uint8_t>& blob);
+// Writes the blob so that readers see either the old file or the whole new one
+bool writeCookedModel(const std::string& path, const std::vector<uint8_t>& blob);
+
+// A cooked model, mapped read only. The pointers stay valid until it's closed.
+class CookedModel
+{
+public:
+    CookedModel();
+    ~CookedModel();
+
+    CookedModel(const CookedModel&) = delete;
+    CookedModel& operator=(const CookedModel&) = delete;
+
+    // Maps the file, false when it's missing, truncated or another version
+    bool open(const std::string& path);
+    // Same checks on a blob already in memory, which the model keeps
+    bool open(std::vector<uint8_t> blob);
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+    size_t getFileSize() const { return m_size; }
+
+    const SkinnedVertex* getVertices() const
+    {
+        return section<SkinnedVertex>(m_header->vertices);
+    }
+    size_t getVertexCount() const { return m_header->vertices.count; }
+    const VertexQuantization& getQuantization() const { return m_header->quantization; }
+    const uint32_t* getIndices() const { return section<uint32_t>(m_header->indices); }
+    size_t getIndexCount() const { return m_header->indices.count; }
+    // In index order, consecutive ones mostly sharing a texture
+    const CookedPart* getParts() const { return section<CookedPart>(m_header->parts); }
+    size_t getPartCount() const { return m_header->parts.count; }
+    const NodeTransform* getNodes() const { return section<NodeTransform>(m_header->nodes); }
+    size_t getNodeCount() const { return m_header->nodes.count; }
+    const int32_t* getAttachments() const { return section<int32_t>(m_header->attachments); }
+    size_t getAttachmentCount() const { return m_header->attachments.count; }
+
+    // Small enough to copy out, unlike the geometry and textures
+    Skin getSkin() const;
+    std::vector<CompressedClip> getClips() const;
+
+    size_t getTextureCount() const { return m_header->textures.count; }
+    int getBaseColorTexture() const { return m_header->baseColorTexture; }
+    // The cache's texture with the same contents, or a new one uploaded straight from the
+    // mapping. 0 for a missing texture, otherwise release it through the cache.
+    GLuint loadTexture(int index, TextureCache& cache) const;
+    // Runs of consecutive parts with the same texture, each one draw
+    std::vector<CookedPart> getMaterialBatches() const;
+
+private:
+    template <typename T>
+    const T* section(const CookedRange& range) const
+    {
+        return reinterpret_cast<const T*>(m_data + range.offset);
+    }
+    bool validate();
+
+    const uint8_t* m_data;
+    size_t m_size;
+    void* m_mapping; // Null for in memory blobs
+    std::vector<uint8_t> m_memory;
+    const CookedHeader* m_header;
+};
+
+// Opens the cooked file next to the source (same name, .cooked), cooking it first when it's
+// missing, stale or from another version. Falls back to cooking in memory if it can't be written.
+bool loadCookedModel(const std::string& sourcePath, CookedModel& cooked);
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "camera.h"
+#include "shader.h"
+#include "texture_cache.h"
+#include "vertex_format.h"
+
+// Animation LOD. Instances closer than tierDistances[0] are posed every frame and blend between
+// baked frames, further ones snap to the nearest frame and only repose every updateIntervals[tier]
+// frames, staggered so the work spreads out.
+struct CrowdLodSettings
+{
+    float tierDistances[2] = { 20.0f, 50.0f };
+    int updateIntervals[3] = { 1, 2, 4 };
+    float bakeRate = 30.0f; // Baked frames per second, read when a character is added
+
+    int tierAt(float distance) const
+    {
+        return distance < tierDistances[0] ? 0 : distance < tierDistances[1] ? 1 : 2;
+    }
+};
+
+// Many copies of a few skinned characters. Every clip's joint palettes are baked into a float
+// texture when a character is added, so posing an instance is a clip, a time and two frame
+// numbers, and each character type is drawn with one instanced call however many copies there
+// are. Attachments hanging from nodes (weapons, hats) are baked as extra joints and ride along in
+// the same draw.
+class CrowdRenderer
+{
+public:
+    CrowdRenderer();
+    ~CrowdRenderer();
+
+    CrowdRenderer(const CrowdRenderer&) = delete;
+    CrowdRenderer& operator=(const CrowdRenderer&) = delete;
+
+    void initialize();
+    // Characters' textures come from it, set it before adding any. It has to outlive the crowd.
+    void setTextureCache(TextureCache* cache) { m_textureCache = cache; }
+
+    // Loads a character through its cooked file and bakes its clips, returns its type or -1
+    int addCharacter(const std::string& path);
+    int getClipCount(int type) const { return static_cast<int>(m_types[type].clips.size()); }
+    const std::string& getClipName(int type, int clip) const
+    {
+        return m_types[type].clips[clip].name;
+    }
+
+    // Yaw in degrees about +Y, clip time starts at timeOffset
+    void addInstance(int type, const glm::vec3& position, float yaw, int clip, float timeOffset);
+    void clearInstances();
+
+    void update(float deltaTime) { m_time += deltaTime; }
+    // Culls, reposes whatever the LOD asks for and draws every type
+    void render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos,
+                const std::array<Camera::FrustumPlane, 6>& frustumPlanes);
+
+    void setLodSettings(const CrowdLodSettings& settings) { m_lod = settings; }
+    const CrowdLodSettings& getLodSettings() const { return m_lod; }
+
+    int getInstanceCount() const { return static_cast<int>(m_instances.size()); }
+    int getDrawnInstanceCount() const { return m_drawnInstances; }
+    int getPoseUpdateCount() const { return m_poseUpdates; }
+    size_t getPaletteBytes() const { return m_paletteBytes; }
+
+private:
+    struct BakedClip
+    {
+        std::string name;
+        float duration;
+        uint32_t firstFrame;
+        uint32_t frameCount;
+    };
+
+    // Layout of the per-instance vertex attributes
+    struct InstanceData
+    {
+        glm::vec4 rows[3];   // Model matrix without its constant last row
+        glm::vec4 animation; // Frame a, frame b, blend from a to b, unused
+    };
+
+    // Parts drawing with the same texture
+    struct MaterialBatch
+    {
+        GLuint texture = 0;
+        uint32_t firstIndex = 0;
+        GLsizei indexCount = 0;
+    };
+
+    struct CharacterType
+    {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ebo = 0;
+        GLuint instanceBuffer = 0;
+        GLuint paletteTexture = 0;
+        VertexQuantization quantization;
+        std::vector<MaterialBatch> batches;
+        int slotsPerFrame = 0; // Joints plus attachments
+        float bakeRate = 0.0f;
+        std::vector<BakedClip> clips;
+        glm::vec3 boundsCenter{ 0.0f }; // Bind pose, loose enough for the animations
+        float boundsRadius = 0.0f;
+        std::vector<InstanceData> visible; // Rebuilt every frame
+        size_t instanceCapacity = 0;
+    };
+
+    struct Instance
+    {
+        int type;
+        int clip;
+        float timeOffset;
+        glm::vec3 position;
+        InstanceData data; // Pose kept between LOD updates
+    };
+
+    glm::vec4 poseAt(const CharacterType& type, int clip, float time, bool blend) const;
+
+    std::vector<CharacterType> m_types;
+    std::vector<Instance> m_instances;
+    CrowdLodSettings m_lod;
+    ShaderProgram m_shader;
+    TextureCache* m_textureCache;
+    float m_time;
+    uint32_t m_frame;
+    GLint m_maxTextureSize;
+
+    int m_drawnInstances;
+    int m_poseUpdates;
+    size_t m_paletteBytes;
+};
@@ -1951,11 +1951,27 @@ static void load_GL_VERSION_4_6(GLADloadproc load)
         (PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC)load("glMultiDrawElementsIndirectCount");
     glad_glPolygonOffsetClamp = (PFNGLPOLYGONOFFSETCLAMPPROC)load("glPolygonOffsetClamp");
 }
+int GLAD_GL_ARB_transform_feedback2 = 0;
+static void load_GL_ARB_transform_feedback2(GLADloadproc load)
+{
+    if (!GLAD_GL_ARB_transform_feedback2)
+        return;
+    glad_glBindTransformFeedback = (PFNGLBINDTRANSFORMFEEDBACKPROC)load("glBindTransformFeedback");
+    glad_glDeleteTransformFeedbacks =
+        (PFNGLDELETETRANSFORMFEEDBACKSPROC)load("glDeleteTransformFeedbacks");
+    glad_glGenTransformFeedbacks = (PFNGLGENTRANSFORMFEEDBACKSPROC)load("glGenTransformFeedbacks");
+    glad_glIsTransformFeedback = (PFNGLISTRANSFORMFEEDBACKPROC)load("glIsTransformFeedback");
+    glad_glPauseTransformFeedback =
+        (PFNGLPAUSETRANSFORMFEEDBACKPROC)load("glPauseTransformFeedback");
+    glad_glResumeTransformFeedback =
+        (PFNGLRESUMETRANSFORMFEEDBACKPROC)load("glResumeTransformFeedback");
+    glad_glDrawTransformFeedback = (PFNGLDRAWTRANSFORMFEEDBACKPROC)load("glDrawTransformFeedback");
+}
 static int find_extensionsGL(void)
 {
     if (!get_exts())
         return 0;
-    (void)&has_ext;
+    GLAD_GL_ARB_transform_feedback2 = has_ext("GL_ARB_transform_feedback2");
     free_exts();
     return 1;
 }
@@ -2054,5 +2070,6 @@ int gladLoadGLLoader(GLADloadproc load)
 
     if (!find_extensionsGL())
         return 0;
+    load_GL_ARB_transform_feedback2(load);
     return GLVersion.major != 0 || GLVersion.minor != 0;
 }
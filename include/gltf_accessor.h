@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tinygltf
+{
+class Model;
+}
+
+// A typed window onto an accessor's elements where they sit in the glTF buffer, honouring the
+// view's byte stride. Nothing is copied until asked: single components convert on the spot,
+// whole accessors convert in bulk into the caller's arrays, interleaved or not, with one loop
+// per component type. Normalized integers map to [0, 1] or [-1, 1] the way glTF defines, others
+// keep their integer value. Sparse accessors read as their base data with the substitutions
+// applied. Accessors that are missing, run past their buffer or have an unknown type give an
+// invalid view with no elements.
+class AccessorView
+{
+public:
+    AccessorView() = default;
+    AccessorView(const tinygltf::Model& model, int accessorIndex);
+
+    bool isValid() const { return m_valid; }
+    size_t getCount() const { return m_count; }
+    int getComponents() const { return m_components; }
+    int getComponentType() const { return m_componentType; }
+    bool isNormalized() const { return m_normalized; }
+    bool isSparse() const { return m_sparseCount > 0; }
+
+    // The elements in the buffer, getStride() bytes apart. Null for sparse accessors and ones
+    // without a buffer view, they only read through the functions below.
+    const uint8_t* getData() const { return isSparse() ? nullptr : m_data; }
+    size_t getStride() const { return m_stride; }
+    // True when getData() is the elements back to back, ready to upload as they are
+    bool isPacked() const;
+
+    float getFloat(size_t element, int component) const;
+    uint32_t getUint(size_t element, int component) const;
+
+    // Writes components values per element, each element outStride bytes after the last.
+    // Components the accessor doesn't have are 0.
+    void readFloats(float* out, int components, size_t outStride) const;
+    void readUints(uint32_t* out, int components, size_t outStride) const;
+
+private:
+    template <typename U>
+    void read(U* out, int components, size_t outStride, bool normalized) const;
+    uint32_t sparseIndex(size_t slot) const;
+    // Where the element's components are, its sparse substitute if it has one
+    const uint8_t* elementData(size_t element) const;
+
+    const uint8_t* m_data = nullptr; // Null when the base data is all zeros
+    size_t m_stride = 0;
+    size_t m_count = 0;
+    size_t m_componentSize = 0;
+    size_t m_elementSize = 0;
+    int m_components = 0;
+    int m_componentType = 0;
+    bool m_normalized = false;
+    bool m_valid = false;
+
+    const uint8_t* m_sparseIndices = nullptr; // Strictly increasing
+    int m_sparseIndexType = 0;
+    const uint8_t* m_sparseValues = nullptr; // Packed elements
+    size_t m_sparseCount = 0;
+};
+
+// Reads components values per element of the accessor as floats. Empty when the accessor is
+// invalid.
+std::vector<float> readAccessorFloats(const tinygltf::Model& model, int accessorIndex,
+                                      int components);
+
+// Same for unsigned integer data such as JOINTS_0 or indices, widened to 32 bits
+std::vector<uint32_t> readAccessorUints(const tinygltf::Model& model, int accessorIndex,
+                                        int components);
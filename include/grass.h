@@ -1,11 +1,17 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include "camera.h"
+#include "grass_cull.h"
+#include "scatter.h"
 #include "shader.h"
+#include "terrain_query.h"
 
 struct GrassBlade
 {
@@ -16,37 +22,233 @@ struct GrassBlade
     float rotation;
 };
 
+// Compact GPU form of GrassBlade, 16 bytes instead of 36. The root is stored relative to its cell
+// so 16 bits of position are plenty no matter how large the field gets.
+struct PackedGrassBlade
+{
+    uint16_t x;        // unorm16 across the cell
+    uint16_t z;        // unorm16 across the cell
+    uint16_t y;        // unorm16 across the cell's root height span
+    uint16_t cell;     // Index into the cell table
+    uint16_t width;    // half float
+    uint16_t height;   // half float
+    uint8_t color[3];  // unorm8
+    uint8_t rotation;  // 256 steps over 360 degrees
+};
+static_assert(sizeof(PackedGrassBlade) == 16, "PackedGrassBlade must match one RGBA32UI texel");
+
+// Fixed-size square patch of the field. Blades are sorted by cell so each cell owns a contiguous
+// range of the blade buffer.
+struct GrassCell
+{
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    int firstBlade;
+    int bladeCount;
+    glm::ivec2 coord; // World cell coordinate the blades belong to
+};
+
+// Distance LOD. Blades closer than tierDistances[0] get the full segment count, past
+// tierDistances[1] they are a single triangle. Between thinningStart and thinningEnd the density
+// falls to minDensity and the survivors widen to keep the same coverage.
+struct GrassLodSettings
+{
+    float tierDistances[2] = { 10.0f, 25.0f };
+    float thinningStart = 20.0f;
+    float thinningEnd = 80.0f;
+    float minDensity = 0.25f;
+
+    int tierAt(float distance) const
+    {
+        return distance < tierDistances[0] ? 0 : distance < tierDistances[1] ? 1 : 2;
+    }
+    float densityAt(float distance) const
+    {
+        float range = std::max(thinningEnd - thinningStart, 1e-3f);
+        float t = std::clamp((distance - thinningStart) / range, 0.0f, 1.0f);
+        return 1.0f + (minDensity - 1.0f) * t;
+    }
+};
+
 class GrassManager
 {
 public:
+    // Where the visible set is computed. The GPU modes keep every blade resident on the GPU and
+    // draw the survivors without reading the count back.
+    enum class CullMode
+    {
+        CPU,
+        TransformFeedback, // GL 3.3 geometry shader + transform feedback
+        Compute            // GL 4.3 compute shader + indirect draw
+    };
+
+    // GPU layout of the blade buffer, chosen before initialize()
+    enum class InstanceLayout
+    {
+        Float, // GrassBlade as is
+        Packed // PackedGrassBlade
+    };
+
+    static constexpr int LOD_TIERS = 3;
+    // Blade segments per tier, matches lodSegments in grass.geom.glsl
+    static constexpr int LOD_SEGMENTS[LOD_TIERS] = { 4, 2, 1 };
+
     GrassManager();
     ~GrassManager();
 
+    // Generation runs on the pool when there is one, and gives the same field for the same seed
+    // either way. Set these before initializing.
+    void setThreadPool(ThreadPool* pool) { m_threadPool = pool; }
+    void setSeed(uint64_t seed) { m_seed = seed; }
+    void setDensityMask(std::function<float(const glm::vec2&)> mask)
+    {
+        m_grassLayer.mask = std::move(mask);
+    }
+    // Ground the blade roots stand on, queried from the pool's threads. Flat at y = 0 without.
+    void setTerrain(const TerrainQuery* terrain) { m_terrain = terrain; }
+
+    // Fixed field of roughly numBlades blades centered on the origin
     void initialize(int numBlades, float areaWidth, float areaDepth);
+    // Streaming field: a square ring of cells reaching radius out from the center. Cells leaving
+    // the ring are reused for the ones entering it, so memory stays the same wherever it goes.
+    void initializeStreaming(const glm::vec3& center, float radius, float bladesPerSquareMeter);
+    void updateStreaming(const glm::vec3& center);
     void update(float deltaTime, const glm::vec3& windDirection);
     void render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos,
                 const std::array<Camera::FrustumPlane, 6>& frustumPlanes);
 
     void setWindStrength(float strength) { m_windStrength = strength; }
+    void setCellSize(float size) { m_cellSize = size; }
+    void setInstanceLayout(InstanceLayout layout) { m_instanceLayout = layout; }
+    InstanceLayout getInstanceLayout() const { return m_instanceLayout; }
+    void setCullMode(CullMode mode);
+    CullMode getCullMode() const { return m_cullMode; }
+    bool isCullModeSupported(CullMode mode) const;
+    void setStreamBudget(int cellsPerFrame) { m_streamBudget = cellsPerFrame; }
+    bool isStreaming() const { return m_streaming; }
+    int getPendingCellCount() const { return m_pendingCells; }
+    void setLodSettings(const GrassLodSettings& settings) { m_lod = settings; }
+    const GrassLodSettings& getLodSettings() const { return m_lod; }
+
+    size_t getBladeCount() const { return m_bladeCount; }
+    size_t getVisibleBladeCount() const { return m_visibleCount; }
+    // CPU cull mode only, the GPU modes never read their counts back
+    size_t getTierInstanceCount(int tier) const { return m_tierCounts[tier]; }
+    int getVisibleCellCount() const { return m_visibleCells; }
+    int getCellCount() const { return static_cast<int>(m_cells.size()); }
+    const char* getCullKernelName() const { return grassCullKernelName(m_cullKernel); }
+    size_t getBytesPerBlade() const;
 
 private:
+    enum class CellVisibility
+    {
+        Outside,
+        Intersecting,
+        Inside
+    };
+
+    struct VisibleCell
+    {
+        int cell;
+        int bladeCount; // After thinning
+        CellVisibility visibility;
+    };
+
+    struct PendingCell
+    {
+        float distance;
+        int gridX;
+        int gridZ;
+    };
+
     void generateGrassBlades(int numBlades, float areaWidth, float areaDepth);
+    void buildCells(float areaWidth, float areaDepth);
+    int cellSlot(int gridX, int gridZ) const;
+    glm::ivec2 slotCoord(int slot) const;
+    int scatterBlades(const ScatterLayer& layer, glm::ivec2 coord, GrassBlade* blades,
+                      ScatterPoint* points, size_t capacity) const;
+    void commitCell(int slot, glm::ivec2 coord, const GrassBlade* blades, int count);
+    glm::vec4 packCell(int slot, const GrassBlade* blades, int count, PackedGrassBlade* out) const;
+    void uploadCell(int slot, const GrassBlade* blades);
+    void buildBladeMeshes();
     void setupBuffers();
+    void setupGpuCulling();
+    void uploadBlades();
+    template <typename Program> void setBladeUniforms(const Program& program) const;
+    template <typename Program> void setLodUniforms(const Program& program) const;
+    void cullWithFeedback(const std::array<Camera::FrustumPlane, 6>& planes,
+                          const glm::vec3& viewPos);
+    void cullWithCompute(const std::array<Camera::FrustumPlane, 6>& planes,
+                         const glm::vec3& viewPos);
 
+    // Only kept until the blades are uploaded, after that culling runs on m_cullData alone
     std::vector<GrassBlade> m_grassBlades;
+    size_t m_bladeCount;
+    uint64_t m_seed;
+    ScatterLayer m_grassLayer;
+    const TerrainQuery* m_terrain;
+    ThreadPool* m_threadPool;
+    std::vector<GrassCell> m_cells;
+    GrassCullData m_cullData;
+    GrassCullKernel m_cullKernel;
+    glm::vec2 m_gridOrigin;
+    int m_gridWidth;
+    int m_gridDepth;
+
+    // Streaming ring. Grid cell (x, z) is world cell m_ringOrigin + (x, z) and lives in the slot
+    // given by cellSlot(), which wraps around so nothing moves when the ring does.
+    bool m_streaming;
+    glm::ivec2 m_ringOrigin;
+    int m_bladesPerCell;
+    int m_streamBudget; // Cells regenerated per frame at most
+    int m_pendingCells;
+    std::vector<PendingCell> m_pending;
+    std::vector<GrassBlade> m_streamBlades;
+    std::vector<ScatterPoint> m_streamPoints;
+    std::vector<int> m_streamCounts;
+    std::vector<PackedGrassBlade> m_streamPacked;
+
+    float m_cellSize;
+    float m_maxBladeHeight;
+    int m_visibleCells;
     Shader m_grassShader;
 
     GLuint m_VAO;
-    GLuint m_VBO;
-    GLuint m_instanceVBO;
+    GLuint m_VBO; // Blade meshes of every LOD tier back to back
+    GLuint m_instanceVBO; // Visible blade indices, one per instance
+
+    // Every blade stays resident in m_bladeVBO and is fetched by index through m_bladeTexture
+    InstanceLayout m_instanceLayout;
+    GLuint m_bladeVBO;
+    GLuint m_bladeTexture;
+    GLuint m_cellVBO; // Packed layout only: cell origins the blades are relative to
+    GLuint m_cellTexture;
+
+    CullMode m_cullMode;
+    GLuint m_cullVAO;
+    GLuint m_feedbackVBO;
+    GLuint m_feedbackVAO;
+    GLuint m_feedback;
+    GLuint m_feedbackQuery;
+    bool m_feedbackQueryPending;
+    GLsizei m_feedbackCount;
+    GLuint m_computeVAO;
+    GLuint m_computeOutput;
+    GLuint m_drawCommand;
+    bool m_computeSupported;
+    ShaderProgram m_feedbackCullProgram;
+    ShaderProgram m_feedbackDrawProgram;
+    ShaderProgram m_computeCullProgram;
 
     float m_windStrength;
     float m_time;
     glm::vec3 m_windDirection;
 
-    const std::vector<float> m_bladeVertices = { -0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-                                                 0.5f,  0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f,
-                                                 0.0f,  1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.5f, 1.0f };
+    // Position, normal, uv per vertex
+    std::vector<float> m_bladeVertices;
+    GLint m_tierFirstVertex[LOD_TIERS];
+    GLsizei m_tierVertexCount[LOD_TIERS];
+    GrassLodSettings m_lod;
 
     // Culling methods
     bool IsBladeVisible(const glm::vec3& position, float height,
@@ -64,28 +266,14 @@ private:
         return true;
     }
 
-    void CullGrassBlades(const std::array<Camera::FrustumPlane, 6>& planes)
-    {
-        visibleBlades.clear();
-        visibleBlades.reserve(m_grassBlades.size()); // Avoid reallocations
-
-        for (const auto& blade : m_grassBlades)
-        {
-            bool visible = true;
-            for (int i = 0; i < 6; i++)
-            {
-                if (glm::dot(planes[i].normal, blade.position) + planes[i].distance < -blade.height)
-                {
-                    visible = false;
-                    break;
-                }
-            }
-            if (visible)
-            {
-                visibleBlades.push_back(blade);
-            }
-        }
-    }
+    CellVisibility classifyCell(const GrassCell& cell,
+                                const std::array<Camera::FrustumPlane, 6>& planes) const;
+    void CullGrassBlades(const std::array<Camera::FrustumPlane, 6>& planes,
+                         const glm::vec3& viewPos);
 
-    std::vector<GrassBlade> visibleBlades; // New container for culled blades
+    // Indices of the culled blades grouped by tier, padded for the kernels
+    std::vector<uint32_t> visibleIndices;
+    std::array<std::vector<VisibleCell>, LOD_TIERS> m_tierCells;
+    size_t m_tierCounts[LOD_TIERS];
+    size_t m_visibleCount;
 };
\ No newline at end of file
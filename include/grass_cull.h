@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "camera.h"
+
+// Structure-of-arrays copy of the blade roots, kept in the same order as the blades themselves
+struct GrassCullData
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> height;
+
+    void resize(size_t count)
+    {
+        x.resize(count);
+        y.resize(count);
+        z.resize(count);
+        height.resize(count);
+    }
+    size_t size() const { return x.size(); }
+};
+
+// Tests blades [first, first + count) against the frustum and writes the indices of the survivors
+// to out, returning how many were written. Vector kernels store whole registers, so out needs
+// room for count + GRASS_CULL_PADDING entries.
+using GrassCullKernel = size_t (*)(const GrassCullData& data, size_t first, size_t count,
+                                   const std::array<Camera::FrustumPlane, 6>& planes,
+                                   uint32_t* out);
+
+constexpr size_t GRASS_CULL_PADDING = 8;
+
+size_t cullBladesScalar(const GrassCullData& data, size_t first, size_t count,
+                        const std::array<Camera::FrustumPlane, 6>& planes, uint32_t* out);
+#if defined(__x86_64__) || defined(__i386__)
+size_t cullBladesSSE(const GrassCullData& data, size_t first, size_t count,
+                     const std::array<Camera::FrustumPlane, 6>& planes, uint32_t* out);
+size_t cullBladesAVX2(const GrassCullData& data, size_t first, size_t count,
+                      const std::array<Camera::FrustumPlane, 6>& planes, uint32_t* out);
+#endif
+
+// Widest kernel the running CPU supports
+GrassCullKernel selectGrassCullKernel();
+const char* grassCullKernelName(GrassCullKernel kernel);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mesh_pool.h"
+
+// Post-transform cache behaviour of an index buffer on a FIFO cache of cacheSize vertices, about
+// what GPUs have. ACMR is vertices transformed per triangle (0.5 at best, 3 at worst), ATVR is
+// vertices transformed per vertex referenced (1 at best).
+struct VertexCacheStats
+{
+    size_t transformed = 0;
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount,
+                                    size_t vertexCount, size_t cacheSize = 16);
+
+// Reorders the triangles so consecutive ones share vertices, Forsyth's linear speed algorithm
+// on a 32 entry LRU cache. Winding and the set of triangles don't change.
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Cuts the cache ordered triangles into clusters where the cache starts cold anyway, then draws
+// the clusters facing out from the mesh's centre first, so they hide the ones behind them
+// before those are shaded. Gives up if the cache misses grow past threshold times what they were.
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices,
+                      size_t vertexCount, float threshold = 1.05f);
+
+// Moves the vertices into the order the indices first use them, so the fetches walk through
+// memory, and renumbers the indices. Vertices no index uses are dropped.
+void optimizeVertexFetch(std::vector<MeshVertex>& vertices, uint32_t* indices,
+                         size_t indexCount);
+
+// All three, in that order, the triangle ones within each [start, end) range of indices so
+// parts drawn on their own keep their triangles
+void optimizeMesh(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices,
+                  const std::vector<std::pair<size_t, size_t>>& ranges);
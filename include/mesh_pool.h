@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include "vertex_format.h"
+
+// Where a mesh lives in the pool. Its indices count from its own first vertex.
+struct MeshRange
+{
+    GLint baseVertex = 0;
+    uint32_t vertexCount = 0;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+};
+
+// Meshes suballocated from one vertex and one index buffer behind a single VAO. Drawing any
+// number of them is one bind and one multi-draw, so state changes don't grow with the mesh
+// count. Every vertex is in the pool's packed format. Both buffers grow by doubling when a mesh
+// doesn't fit.
+class MeshPool
+{
+public:
+    MeshPool();
+    ~MeshPool();
+
+    MeshPool(const MeshPool&) = delete;
+    MeshPool& operator=(const MeshPool&) = delete;
+
+    void initialize(VertexFormat format, size_t vertexCapacity = 1 << 16,
+                    size_t indexCapacity = 1 << 18);
+
+    // vertices are StaticVertex or SkinnedVertex, whichever the pool holds
+    MeshRange add(const void* vertices, size_t vertexCount, const uint32_t* indices,
+                  size_t indexCount);
+    // Room for a mesh without its data, for filling from another buffer with the copies below
+    MeshRange reserve(size_t vertexCount, size_t indexCount);
+    void remove(const MeshRange& range);
+
+    // GPU side copies into a reserved range, from offset bytes into source (a staging buffer)
+    void copyVertices(const MeshRange& range, GLuint source, size_t offset);
+    void copyIndices(const MeshRange& range, GLuint source, size_t offset);
+
+    // Binds the VAO, the draws below expect it
+    void bind() const { glBindVertexArray(m_vao); }
+    void draw(const MeshRange& range) const;
+    // Instance attributes are the caller's to set up on the VAO
+    void drawInstanced(const MeshRange& range, GLsizei instanceCount) const;
+    // One glMultiDrawElementsBaseVertex for all of them, core since GL 3.2
+    void draw(const std::vector<MeshRange>& ranges);
+
+    VertexFormat getVertexFormat() const { return m_format; }
+    size_t getVertexSize() const { return m_vertexSize; }
+    size_t getVertexCapacity() const { return m_vertexCapacity; }
+    size_t getIndexCapacity() const { return m_indexCapacity; }
+    size_t getUsedVertexCount() const { return m_usedVertices; }
+    size_t getUsedIndexCount() const { return m_usedIndices; }
+
+private:
+    struct FreeRange
+    {
+        size_t offset;
+        size_t count;
+    };
+
+    // First fit, SIZE_MAX when nothing is big enough
+    static size_t allocate(std::vector<FreeRange>& free, size_t count);
+    // Returns the range and merges it with its neighbours
+    static void release(std::vector<FreeRange>& free, size_t offset, size_t count);
+    // Copies the buffer into one at least twice as big and frees the new tail
+    void grow(GLenum target, GLuint& buffer, size_t& capacity, size_t elementSize, size_t needed,
+              std::vector<FreeRange>& free);
+    void setVertexLayout();
+
+    VertexFormat m_format;
+    size_t m_vertexSize;
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLuint m_ebo;
+    size_t m_vertexCapacity;
+    size_t m_indexCapacity;
+    size_t m_usedVertices;
+    size_t m_usedIndices;
+    std::vector<FreeRange> m_freeVertices; // Sorted by offset
+    std::vector<FreeRange> m_freeIndices;
+
+    // Reused by the multi-draw
+    std::vector<GLsizei> m_drawCounts;
+    std::vector<const void*> m_drawOffsets;
+    std::vector<GLint> m_drawBaseVertices;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mesh_pool.h"
+
+constexpr int MAX_MESH_LODS = 4;
+
+// Indices of a coarser version of the triangles that only uses their own vertices, so a LOD is
+// one more index buffer over the same vertex data. Edges collapse one vertex onto its neighbour,
+// cheapest first by quadric error (Garland and Heckbert), in passes of collapses that don't
+// touch each other. Vertices on a texture seam, a hard edge or an open edge never move, which
+// keeps the UVs, the shading of flat faces and the outline of cards and leaves, and collapses
+// that would flip a triangle are skipped.
+// Stops at targetIndexCount or when the next collapse would cost more than maxError, a distance
+// in model units, and writes the largest error it accepted to resultError.
+std::vector<uint32_t> simplifyMesh(const MeshVertex* vertices, size_t vertexCount,
+                                   const uint32_t* indices, size_t indexCount,
+                                   size_t targetIndexCount, float maxError,
+                                   float* resultError = nullptr);
+
+struct MeshLodSettings
+{
+    float reduction = 0.5f;   // Triangles each LOD aims for, relative to the one before
+    float maxError = 0.04f;   // Of LOD 1, relative to the mesh's bounding radius
+    float errorGrowth = 2.5f; // From one LOD's error limit to the next
+    // A LOD that doesn't get below this fraction of the one before isn't worth its draw
+    float minReduction = 0.85f;
+};
+
+struct MeshLod
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error; // In model units, 0 for the full mesh
+};
+
+// Appends LODs 1 and up to indices, whose whole contents are LOD 0, and returns them all
+std::vector<MeshLod> buildMeshLods(const std::vector<MeshVertex>& vertices,
+                                   std::vector<uint32_t>& indices,
+                                   const MeshLodSettings& settings = MeshLodSettings());
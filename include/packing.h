@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Helpers for quantized GPU formats. Decoding mirrors what the shaders do.
+
+// IEEE 754 binary16, round to nearest even
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t exponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (exponent == 0xFFu) // Inf / NaN
+        return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+
+    int halfExponent = static_cast<int>(exponent) - 127 + 15;
+    if (halfExponent >= 31) // Overflow
+        return static_cast<uint16_t>(sign | 0x7C00u);
+
+    if (halfExponent <= 0) // Subnormal or zero
+    {
+        if (halfExponent < -10)
+            return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000u;
+        uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1u);
+        uint32_t halfway = 1u << (shift - 1u);
+        if (remainder > halfway || (remainder == halfway && (half & 1u)))
+            half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    uint32_t remainder = mantissa & 0x1FFFu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+        half++; // A carry into the exponent is still the correctly rounded result
+    return static_cast<uint16_t>(sign | half);
+}
+
+inline float halfToFloat(uint16_t half)
+{
+    uint32_t sign = (half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1Fu;
+    uint32_t mantissa = half & 0x3FFu;
+
+    if (exponent == 0)
+    {
+        float value = std::ldexp(static_cast<float>(mantissa), -24);
+        return sign ? -value : value;
+    }
+
+    uint32_t bits;
+    if (exponent == 31)
+        bits = sign | 0x7F800000u | (mantissa << 13);
+    else
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline uint16_t packUnorm16(float value)
+{
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+inline uint8_t packUnorm8(float value)
+{
+    return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+}
+
+inline int16_t packSnorm16(float value)
+{
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+inline float unpackUnorm16(uint16_t value) { return value / 65535.0f; }
+inline float unpackUnorm8(uint8_t value) { return value / 255.0f; }
+inline float unpackSnorm16(int16_t value) { return std::max(value / 32767.0f, -1.0f); }
+
+// Unit vector folded onto the octahedron and flattened into two snorm16, within a few hundredths
+// of a degree. The lower half folds out over the diagonals.
+inline void packOctahedral(const float* v, int16_t* out)
+{
+    float length = std::fabs(v[0]) + std::fabs(v[1]) + std::fabs(v[2]);
+    float x = length > 0.0f ? v[0] / length : 0.0f;
+    float y = length > 0.0f ? v[1] / length : 0.0f;
+    if (v[2] < 0.0f)
+    {
+        float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    out[0] = packSnorm16(x);
+    out[1] = packSnorm16(y);
+}
+
+inline void unpackOctahedral(const int16_t* in, float* v)
+{
+    float x = unpackSnorm16(in[0]);
+    float y = unpackSnorm16(in[1]);
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    float fold = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -fold : fold;
+    y += y >= 0.0f ? -fold : fold;
+    float length = std::sqrt(x * x + y * y + z * z);
+    v[0] = x / length;
+    v[1] = y / length;
+    v[2] = z / length;
+}
@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "terrain_query.h"
 
 class Player
 {
@@ -11,7 +12,7 @@ public:
 
     void processInput(float deltaTime, bool moveForward, bool moveBackward, bool moveLeft,
                       bool moveRight, bool jump, float cameraYaw);
-    void update(float deltaTime, float terrainY);
+    void update(float deltaTime, const TerrainQuery& terrain);
 
     glm::vec3 getPosition() const;
     glm::vec3 getVelocity() const;
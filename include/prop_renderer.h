@@ -0,0 +1,146 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "asset_streamer.h"
+#include "camera.h"
+#include "mesh_simplify.h"
+#include "scatter.h"
+#include "shader.h"
+
+// LODs go by how big a prop looks, the radius of its bounding sphere over half the screen
+// height. LOD i + 1 takes over below screenSizes[i]. Each switch waits until the size is past the
+// threshold by the hysteresis fraction, so props sitting near one don't flicker between two LODs.
+// Props smaller than cullScreenSize aren't drawn at all.
+struct PropLodSettings
+{
+    float screenSizes[MAX_MESH_LODS - 1] = { 0.12f, 0.05f, 0.02f };
+    float hysteresis = 0.15f;
+    float cullScreenSize = 0.002f;
+};
+
+// Far away, props of at least minRadius (model units) swap to an impostor: a camera facing quad
+// showing the prototype as seen from the nearest of gridSize x gridSize directions over the upper
+// hemisphere, laid out hemi-octahedrally in an atlas baked once the prototype is resident. Over
+// fadeRange past distance the mesh dithers out as the impostor dithers in on the other pixels.
+struct PropImpostorSettings
+{
+    bool enabled = true;
+    float distance = 80.0f;
+    float fadeRange = 10.0f;
+    float minRadius = 1.5f;
+    int gridSize = 8;
+    int frameSize = 64;    // Pixels per side of each direction's frame
+    int bakesPerFrame = 2; // Prototypes, each is gridSize^2 draws
+};
+
+// Static environment props (rocks, bushes, trees) drawn instanced. Each prototype is one model,
+// registered once and streamed in through the AssetStreamer, with the transforms of all its
+// copies alongside. Every frame the copies are culled against the frustum, each picks a LOD, and
+// each prototype is one instanced draw per LOD in use and base color texture, so the draw count
+// follows the number of prototypes and not the number of props. Impostors add one more draw per
+// prototype.
+class PropRenderer
+{
+public:
+    PropRenderer();
+    ~PropRenderer();
+
+    PropRenderer(const PropRenderer&) = delete;
+    PropRenderer& operator=(const PropRenderer&) = delete;
+
+    // The streamer's meshes are drawn from its pool, it has to outlive the renderer
+    void initialize(AssetStreamer* streamer);
+
+    // Same path, same prototype
+    int addPrototype(const std::string& path);
+    // Yaw in degrees about +Y, uniform scale
+    void addInstance(int prototype, const glm::vec3& position, float yaw, float scale);
+    // Every placement, through the prototype of its layer's asset
+    void addPlacements(const std::vector<PropPlacement>& placements,
+                       const std::vector<PropLayer>& layers);
+    void clearInstances();
+
+    void render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos,
+                const std::array<Camera::FrustumPlane, 6>& frustumPlanes);
+
+    void setLodSettings(const PropLodSettings& settings) { m_lod = settings; }
+    const PropLodSettings& getLodSettings() const { return m_lod; }
+    // Frame layout changes only apply to atlases baked afterwards
+    void setImpostorSettings(const PropImpostorSettings& settings) { m_impostor = settings; }
+    const PropImpostorSettings& getImpostorSettings() const { return m_impostor; }
+
+    int getPrototypeCount() const { return static_cast<int>(m_prototypes.size()); }
+    int getInstanceCount() const { return m_instanceCount; }
+    int getDrawnInstanceCount() const { return m_drawnInstances; }
+    int getDrawCount() const { return m_drawCount; }
+    size_t getDrawnTriangleCount() const { return m_drawnTriangles; }
+    int getDrawnImpostorCount() const { return m_drawnImpostors; }
+    int getImpostorAtlasCount() const { return m_impostorAtlasCount; }
+    size_t getImpostorAtlasBytes() const { return m_impostorAtlasBytes; }
+
+private:
+    // Top three rows of the model matrix, as the shader reads them
+    struct InstanceData
+    {
+        glm::vec4 rows[3];
+    };
+
+    // What each draw reads per instance, fade is how much of it to keep (dithered)
+    struct DrawInstance
+    {
+        glm::vec4 rows[3];
+        float fade;
+    };
+
+    struct Prototype
+    {
+        AssetHandle asset = 0;
+        std::vector<InstanceData> instances;
+        std::vector<uint8_t> lods; // Each instance's, kept for the hysteresis
+        GLuint impostorAtlas = 0;  // 0 until baked
+        int impostorGrid = 0;      // The gridSize it was baked with
+        bool impostorChecked = false;
+        // Runs of m_visible per LOD, then the impostors, rebuilt every frame
+        size_t firstVisible[MAX_MESH_LODS] = {};
+        size_t visibleCount[MAX_MESH_LODS] = {};
+        size_t firstImpostor = 0;
+        size_t impostorCount = 0;
+    };
+
+    // Renders the prototype's LOD 0 into each frame of a new atlas
+    void bakeImpostor(Prototype& prototype);
+    // Points attributes 4 to 7 of the bound VAO at offset bytes into the bound GL_ARRAY_BUFFER
+    static void setInstanceAttributes(size_t offset);
+
+    AssetStreamer* m_streamer;
+    ShaderProgram m_shader;
+    ShaderProgram m_impostorShader;
+    std::vector<Prototype> m_prototypes;
+    std::unordered_map<AssetHandle, int> m_prototypeOf;
+    std::vector<DrawInstance> m_visible; // Grouped by prototype, then LOD, impostors last
+    std::vector<DrawInstance> m_lodVisible[MAX_MESH_LODS];
+    std::vector<DrawInstance> m_impostorVisible;
+    PropLodSettings m_lod;
+    PropImpostorSettings m_impostor;
+    GLuint m_instanceBuffer;
+    size_t m_instanceCapacity;
+    GLuint m_impostorVao; // Instance attributes only, the corners come from gl_VertexID
+    GLuint m_bakeFramebuffer;
+    GLuint m_bakeDepth;
+    int m_bakeDepthSize;
+    GLuint m_bakeInstanceBuffer; // One identity instance
+
+    int m_instanceCount;
+    int m_drawnInstances;
+    int m_drawCount;
+    size_t m_drawnTriangles;
+    int m_drawnImpostors;
+    int m_impostorAtlasCount;
+    size_t m_impostorAtlasBytes;
+};
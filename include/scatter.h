@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "thread_pool.h"
+
+// Counter-based generator: the n-th value depends only on the key and n, so a cell can be
+// generated on any thread and in any order and still come out bit-identical
+class ScatterRng
+{
+public:
+    explicit ScatterRng(uint64_t key)
+        : m_key(key)
+        , m_counter(0)
+    {
+    }
+
+    uint32_t next();
+    float uniform() { return (next() >> 8) * (1.0f / 16777216.0f); } // [0, 1)
+    float range(float min, float max) { return min + (max - min) * uniform(); }
+
+private:
+    uint64_t m_key;
+    uint64_t m_counter;
+};
+
+// Key for one layer of one cell under a world seed
+uint64_t scatterKey(uint64_t seed, glm::ivec2 cell, uint32_t layer);
+
+enum class ScatterPattern
+{
+    Jittered, // One point per stratum of a square grid in shuffled order, cheap enough for grass
+    Poisson   // Dart throwing with a minimum spacing, also kept across cell borders
+};
+
+struct ScatterLayer
+{
+    uint32_t id = 0; // Keeps layers that share a seed independent
+    ScatterPattern pattern = ScatterPattern::Jittered;
+    float density = 1.0f;    // Points per square meter before the mask
+    float minSpacing = 1.0f; // Poisson only
+    // Chance in [0, 1] of keeping a point at a world x/z, keeps everything when empty. Masking
+    // only removes points, the rest stay where they were.
+    std::function<float(const glm::vec2&)> mask;
+};
+
+struct ScatterPoint
+{
+    glm::vec2 position; // World x/z
+    uint32_t hash;      // Seed for the point's own attributes, see ScatterRng
+};
+
+// Most points scatterCell can write for one cell
+size_t scatterCapacity(const ScatterLayer& layer, float cellSize);
+
+// Scatters the square world cell [cell * cellSize, (cell + 1) * cellSize) and returns the number
+// of points written to out
+size_t scatterCell(uint64_t seed, const ScatterLayer& layer, glm::ivec2 cell, float cellSize,
+                   ScatterPoint* out);
+
+// Environment props, one layer per kind of prop with the asset variants to pick from
+struct PropLayer
+{
+    std::string name;
+    std::vector<std::string> assets;
+    ScatterLayer scatter;
+    float minScale = 1.0f;
+    float maxScale = 1.0f;
+};
+
+struct PropPlacement
+{
+    uint16_t layer;
+    uint16_t asset; // Index into the layer's assets
+    glm::vec3 position;
+    float rotation; // Degrees about +Y
+    float scale;
+};
+
+// Trees, rocks and bushes found among the .gltf files in directory, in name order
+std::vector<PropLayer> loadEnvironmentPropLayers(const std::string& directory);
+
+// Every layer over the world cells [cellMin, cellMax]. Cells run in parallel on pool when given,
+// the result is in cell order either way.
+std::vector<PropPlacement> scatterProps(uint64_t seed, const std::vector<PropLayer>& layers,
+                                        glm::ivec2 cellMin, glm::ivec2 cellMax, float cellSize,
+                                        ThreadPool* pool);
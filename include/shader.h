@@ -56,7 +56,8 @@ class ShaderProgram
 {
 public:
     ShaderProgram();
-    explicit ShaderProgram(const std::vector<Shader>& shaders);
+    explicit ShaderProgram(const std::vector<Shader>& shaders,
+                           const std::vector<std::string>& feedbackVaryings = {});
 
     void use() const { glUseProgram(id_); }
 
@@ -129,10 +130,18 @@ public:
         return *this;
     }
 
-    [[nodiscard]] ShaderProgram build() const { return ShaderProgram{ shaders_ }; }
+    // Outputs captured (interleaved) by transform feedback, must be set before build()
+    ShaderBuilder& feedback(std::vector<std::string> varyings)
+    {
+        varyings_ = std::move(varyings);
+        return *this;
+    }
+
+    [[nodiscard]] ShaderProgram build() const { return ShaderProgram{ shaders_, varyings_ }; }
 
 private:
     std::vector<Shader> shaders_;
+    std::vector<std::string> varyings_;
 };
 
 // Add Blade constructor for grass.cpp
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+class TransformHierarchy;
+
+namespace tinygltf
+{
+class Model;
+}
+
+// Most joints one palette holds, matches MAX_JOINTS in shaders/vertex.glsl
+constexpr int MAX_JOINTS = 128;
+// Uniform buffer binding of the palette, 0 is the camera UBO
+constexpr GLuint JOINT_PALETTE_BINDING = 1;
+
+struct Skin
+{
+    std::vector<int> joints; // Node of each joint
+    std::vector<glm::mat4> inverseBindMatrices;
+};
+
+std::vector<Skin> loadSkins(const tinygltf::Model& model);
+
+// One matrix per joint taking a bind pose vertex to where the pose puts it, relative to the
+// scene root: the joint's world matrix times its inverse bind matrix. Runs once per character
+// per frame, the vertices are blended on the GPU.
+void computeJointPalette(const Skin& skin, const TransformHierarchy& hierarchy,
+                         std::vector<glm::mat4>& palette);
+
+// Points the program's JointPalette block at JOINT_PALETTE_BINDING
+void bindJointPaletteBlock(GLuint program);
+
+// std140 uniform buffer the current palette is streamed into
+class JointPaletteBuffer
+{
+public:
+    JointPaletteBuffer();
+    ~JointPaletteBuffer();
+
+    JointPaletteBuffer(const JointPaletteBuffer&) = delete;
+    JointPaletteBuffer& operator=(const JointPaletteBuffer&) = delete;
+
+    void initialize();
+    // Uploads the palette and binds it for the next draws
+    void upload(const std::vector<glm::mat4>& palette);
+
+private:
+    GLuint m_buffer;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "camera.h"
+#include "shader.h"
+#include "terrain_query.h"
+#include "thread_pool.h"
+
+class FastNoiseLite;
+
+struct TerrainSettings
+{
+    uint64_t seed = 1;
+    float chunkSize = 32.0f;   // Meters per chunk side
+    int chunkResolution = 32;  // Quads per chunk side at full detail, a power of two <= 128
+    int viewRadius = 5;        // Chunks kept around the center
+    float heightScale = 14.0f;
+    float noiseFrequency = 0.004f;
+    int noiseOctaves = 5;
+    float lodDistance = 40.0f; // Distance covered by each LOD level
+    int uploadBudget = 4;      // Chunks uploaded per frame at most
+    int maxJobsInFlight = 16;
+};
+
+// FBm noise heightfield. Only reads its state, so any thread can sample it.
+class TerrainGenerator
+{
+public:
+    explicit TerrainGenerator(const TerrainSettings& settings);
+    ~TerrainGenerator();
+
+    // Raw noise height, the mesh samples this at its grid points
+    float sample(float x, float z) const;
+
+private:
+    std::unique_ptr<FastNoiseLite> m_noise;
+    float m_heightScale;
+};
+
+// One terrain vertex. x/z follow from the vertex index, so only the height and normal are stored.
+struct TerrainVertex
+{
+    float height;
+    int16_t normal[4]; // snorm16 xyz, w unused
+};
+
+// Chunked heightfield around a moving center. Chunks are built on the thread pool and drawn with
+// geomipmapping: every chunk shares one vertex layout, and the index buffer has one entry per LOD
+// and combination of coarser neighbours, whose edges are snapped onto the coarser grid so the
+// seams stay closed.
+class Terrain
+{
+public:
+    explicit Terrain(const TerrainSettings& settings = TerrainSettings());
+    ~Terrain();
+
+    Terrain(const Terrain&) = delete;
+    Terrain& operator=(const Terrain&) = delete;
+
+    void setThreadPool(ThreadPool* pool) { m_threadPool = pool; }
+    void initialize();
+
+    // Queues chunks entering the ring, drops the ones leaving it and uploads finished ones
+    void update(const glm::vec3& center);
+    void render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos,
+                const std::array<Camera::FrustumPlane, 6>& frustumPlanes);
+
+    // Heights, normals and rays against the surface, see TerrainQuery for threading
+    const TerrainQuery& getQuery() const { return m_query; }
+
+    const TerrainSettings& getSettings() const { return m_settings; }
+    int getResidentChunkCount() const { return m_residentChunks; }
+    int getPendingChunkCount() const { return m_pendingChunks; }
+    int getDrawnChunkCount() const { return m_drawnChunks; }
+    size_t getDrawnTriangleCount() const { return m_drawnTriangles; }
+
+private:
+    struct ChunkBuild
+    {
+        std::vector<TerrainVertex> vertices;
+        std::shared_ptr<std::vector<float>> heights; // Kept for queries once resident
+        float minHeight = 0.0f;
+        float maxHeight = 0.0f;
+        std::atomic<bool> ready{ false };
+    };
+
+    struct Chunk
+    {
+        glm::ivec2 coord;
+        std::shared_ptr<ChunkBuild> build; // Until uploaded
+        float minHeight = 0.0f;
+        float maxHeight = 0.0f;
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        int lod = 0;
+        bool resident = false;
+    };
+
+    struct IndexRange
+    {
+        GLsizei count;
+        size_t offset; // Bytes into m_indexBuffer
+    };
+
+    static uint64_t chunkKey(glm::ivec2 coord);
+    static void buildChunk(const TerrainGenerator& generator, const TerrainSettings& settings,
+                           glm::ivec2 coord, ChunkBuild& build);
+    void buildIndices();
+    void uploadChunk(Chunk& chunk);
+    void releaseChunk(Chunk& chunk);
+    void selectLods(const glm::vec3& viewPos);
+
+    TerrainSettings m_settings;
+    std::shared_ptr<const TerrainGenerator> m_generator;
+    TerrainQuery m_query;
+    ThreadPool* m_threadPool;
+    int m_gridSize; // Vertices per chunk side
+    int m_lodCount;
+
+    std::unordered_map<uint64_t, Chunk> m_chunks;
+    std::vector<std::pair<GLuint, GLuint>> m_freeBuffers; // VAO/VBO pairs of evicted chunks
+    std::vector<glm::ivec2> m_missing;
+    std::vector<Chunk*> m_readyChunks;
+    // Builds of dropped chunks, still counted in flight until their workers finish
+    std::vector<std::shared_ptr<ChunkBuild>> m_orphanedBuilds;
+    int m_jobsInFlight;
+
+    GLuint m_indexBuffer;
+    std::vector<IndexRange> m_indexRanges; // [lod * 16 + coarser neighbour mask]
+    ShaderProgram m_shader;
+
+    int m_residentChunks;
+    int m_pendingChunks;
+    int m_drawnChunks;
+    size_t m_drawnTriangles;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+class TerrainGenerator;
+struct TerrainSettings;
+
+struct TerrainSample
+{
+    float height;
+    glm::vec3 normal;
+};
+
+struct TerrainHit
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    float fraction; // Along the segment, 0 at the start and 1 at the end
+};
+
+// Height, normal and ray queries against the full detail terrain surface: the bilinear patches
+// between the grid samples the chunks are built from. Resident chunks keep their heights in a
+// direct-mapped table so a lookup is a couple of loads, anything else falls back to the noise
+// and gives the same answer. Queries are safe from any thread while Terrain::update isn't running.
+class TerrainQuery
+{
+public:
+    TerrainQuery(const TerrainSettings& settings,
+                 std::shared_ptr<const TerrainGenerator> generator);
+
+    float height(float x, float z) const;
+    TerrainSample sample(float x, float z) const;
+
+    // Batched versions, cheaper per point when neighbouring points land in the same chunk
+    void heights(const glm::vec2* positions, size_t count, float* out) const;
+    void samples(const glm::vec2* positions, size_t count, TerrainSample* out) const;
+
+    // First point where the segment from start to end goes below the surface. Walks the grid
+    // cells under the segment once and solves each cell's patch exactly, no fixed stepping.
+    bool raycast(const glm::vec3& start, const glm::vec3& end, TerrainHit& hit) const;
+
+    // Called by Terrain as chunks become resident and leave again
+    void insertChunk(glm::ivec2 coord, std::shared_ptr<const std::vector<float>> heights);
+    void removeChunk(glm::ivec2 coord);
+
+private:
+    struct Slot
+    {
+        glm::ivec2 coord;
+        std::shared_ptr<const std::vector<float>> heights; // gridSize^2, row-major by z
+    };
+
+    // The four corner heights of grid cell (cx, cz), in world grid units
+    void cellCorners(int cx, int cz, const Slot*& cached, float corners[4]) const;
+    size_t slotIndex(glm::ivec2 chunk) const;
+    const Slot* findSlot(glm::ivec2 chunk) const;
+
+    std::shared_ptr<const TerrainGenerator> m_generator;
+    float m_chunkSize;
+    float m_spacing;
+    int m_resolution; // Grid cells per chunk side
+    int m_gridSize;   // Samples per chunk side
+    int m_tableSize;
+    std::vector<Slot> m_table;
+};
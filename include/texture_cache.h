@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <glad/glad.h>
+
+struct CookedMip;
+
+// Identifies a texture by what it holds rather than where it came from, so the same atlas
+// exported next to several models (or packed into a .glb) is one texture on the GPU
+using TextureHash = uint64_t;
+
+// Hash of RGBA8 pixels and their size
+TextureHash hashTexture(uint32_t width, uint32_t height, const uint8_t* pixels);
+
+// RGBA8 textures shared by content hash and reference counted. Every acquire(), create() or
+// upload() that returns a texture needs a release() of it, the last one deletes it.
+class TextureCache
+{
+public:
+    TextureCache() = default;
+    ~TextureCache();
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // The texture already holding this content, with another reference, or 0
+    GLuint acquire(TextureHash hash);
+    // A new texture with storage for every level but no contents, for filling by the caller
+    // (from a pixel buffer, say) before it calls markComplete()
+    GLuint create(TextureHash hash, const CookedMip* mips, size_t mipCount);
+    // acquire(), or a new texture with every level uploaded from pixels
+    GLuint upload(TextureHash hash, const CookedMip* mips, size_t mipCount, const uint8_t* pixels);
+    void release(GLuint texture);
+
+    void markComplete(TextureHash hash);
+    // False while a created texture is still being filled, so users can wait to draw with it
+    bool isComplete(TextureHash hash) const;
+
+    size_t getTextureCount() const { return m_entries.size(); }
+    int getReferenceCount() const { return m_references; }
+    size_t getBytes() const { return m_bytes; }
+
+private:
+    struct Entry
+    {
+        GLuint texture = 0;
+        int references = 0;
+        size_t bytes = 0;
+        bool complete = false;
+    };
+
+    std::unordered_map<TextureHash, Entry> m_entries;
+    std::unordered_map<GLuint, TextureHash> m_hashes; // Of every texture in m_entries
+    int m_references = 0;
+    size_t m_bytes = 0;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling tasks from one queue
+class ThreadPool
+{
+public:
+    // 0 picks one worker per core, leaving a core for the calling thread
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Runs body(i) for every i in [0, count) on the workers and the calling thread, and returns
+    // once all of them have finished. Which thread gets which index is unspecified.
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    size_t getThreadCount() const { return m_workers.size(); }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping;
+};
+
+// pool->parallelFor, or a plain loop when there is no pool
+inline void parallelFor(ThreadPool* pool, size_t count, const std::function<void(size_t)>& body)
+{
+    if (pool)
+    {
+        pool->parallelFor(count, body);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i)
+        body(i);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace tinygltf
+{
+class Model;
+}
+
+// A node's rest transform and parent, in glTF node order. Also how cooked models store nodes.
+struct NodeTransform
+{
+    int32_t parent;    // -1 for roots
+    int32_t hasMatrix; // The local matrix is fixed and the TRS unused, glTF doesn't animate those
+    float translation[3];
+    float rotation[4]; // x, y, z, w
+    float scale[3];
+    float matrix[16]; // Column major
+};
+
+std::vector<NodeTransform> loadNodeTransforms(const tinygltf::Model& model);
+
+// Runtime node transforms of a glTF model, independent of tinygltf once built. Nodes are stored
+// parent before child in flat translation/rotation/scale arrays, so update() is one linear pass
+// that only recomposes what changed and never allocates. The public interface takes glTF node
+// indices.
+class TransformHierarchy
+{
+public:
+    void build(const tinygltf::Model& model);
+    void build(const NodeTransform* nodes, size_t count);
+
+    size_t getNodeCount() const { return m_parent.size(); }
+
+    void setTranslation(int node, const glm::vec3& translation);
+    void setRotation(int node, const glm::quat& rotation);
+    void setScale(int node, const glm::vec3& scale);
+
+    // Brings the world matrices up to date with the transforms set since the last call
+    void update();
+
+    const glm::mat4& getWorldMatrix(int node) const { return m_world[m_flatIndex[node]]; }
+
+private:
+    // Flat arrays, indexed in parent-before-child order
+    std::vector<int> m_parent; // -1 for roots
+    std::vector<glm::vec3> m_translation;
+    std::vector<glm::quat> m_rotation;
+    std::vector<glm::vec3> m_scale;
+    std::vector<glm::mat4> m_local;
+    std::vector<glm::mat4> m_world;
+    std::vector<uint8_t> m_localDirty;
+    std::vector<uint8_t> m_worldChanged; // Set during update() so children follow
+    std::vector<uint8_t> m_fixedLocal;   // Nodes given as a matrix, glTF doesn't animate those
+
+    std::vector<int> m_flatIndex; // glTF node index to flat index
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Full precision vertex the cooking works on: loading, simplification, reordering. Rigid meshes
+// are weighted fully to a single palette entry, so the same shader draws them and skinned ones.
+// Only the packed formats below go to the GPU.
+struct MeshVertex
+{
+    float position[3];
+    float texcoord[2];
+    float normal[3];
+    float tangent[4]; // w is the bitangent's sign
+    uint16_t joints[4];
+    float weights[4];
+};
+
+// The layouts of pooled and cooked meshes. Positions are unorm16 across the mesh's bounds, with
+// the bitangent sign in w (0 for -1), normals and tangents octahedral snorm16, texcoords half
+// floats. Static meshes have nothing else, skinned ones add four uint8 joints and unorm8 weights
+// summing to exactly 255.
+enum class VertexFormat : uint8_t
+{
+    Static,
+    Skinned
+};
+
+struct StaticVertex
+{
+    uint16_t position[4];
+    int16_t normal[2];
+    int16_t tangent[2];
+    uint16_t texcoord[2];
+};
+
+struct SkinnedVertex
+{
+    uint16_t position[4];
+    int16_t normal[2];
+    int16_t tangent[2];
+    uint16_t texcoord[2];
+    uint8_t joints[4];
+    uint8_t weights[4];
+};
+
+static_assert(sizeof(StaticVertex) == 20 && sizeof(SkinnedVertex) == 28,
+              "The attribute offsets in setVertexAttributes assume these sizes");
+
+// Model space position = offset + unorm position * scale, set per mesh as the shader uniforms
+// positionOffset and positionScale
+struct VertexQuantization
+{
+    glm::vec3 offset{ 0.0f };
+    glm::vec3 scale{ 1.0f };
+};
+
+size_t getVertexSize(VertexFormat format);
+
+// Spans the bounds of the vertices' positions
+VertexQuantization computeQuantization(const MeshVertex* vertices, size_t vertexCount);
+
+void packVertices(const MeshVertex* vertices, size_t vertexCount,
+                  const VertexQuantization& quantization, StaticVertex* out);
+void packVertices(const MeshVertex* vertices, size_t vertexCount,
+                  const VertexQuantization& quantization, SkinnedVertex* out);
+
+glm::vec3 unpackPosition(const uint16_t* position, const VertexQuantization& quantization);
+
+// Points the bound VAO's attributes at the bound GL_ARRAY_BUFFER, where
+// shaders/vertex_decode.glsl reads them. Static meshes have no joints and weights to point at.
+void setVertexAttributes(VertexFormat format);
+
+// On a Shader or ShaderProgram in use
+template <typename Program>
+void setVertexQuantization(const Program& shader, const VertexQuantization& quantization)
+{
+    shader.setVec3("positionOffset", quantization.offset);
+    shader.setVec3("positionScale", quantization.scale);
+}
@@ -0,0 +1,52 @@
+#version 330 core
+#include "vertex_decode.glsl"
+layout (location = 2) in uvec4 aJoints;
+layout (location = 3) in vec4 aWeights;
+// Per instance
+layout (location = 4) in vec4 aModelRow0;
+layout (location = 5) in vec4 aModelRow1;
+layout (location = 6) in vec4 aModelRow2;
+layout (location = 7) in vec4 aAnimation; // Frame a, frame b, blend from a to b
+
+out vec2 TexCoord;
+out vec3 Normal;
+out vec4 Tangent;
+
+uniform mat4 view;
+uniform mat4 projection;
+// Baked palettes, three texels per joint holding the top rows of its matrix
+uniform sampler2D palettes;
+uniform int slotsPerFrame;
+
+mat4 fetchJoint(int frame, uint joint)
+{
+    int texel = (frame * slotsPerFrame + int(joint)) * 3;
+    int width = textureSize(palettes, 0).x;
+    ivec2 at = ivec2(texel % width, texel / width);
+    vec4 row0 = texelFetch(palettes, at, 0);
+    vec4 row1 = texelFetch(palettes, at + ivec2(1, 0), 0);
+    vec4 row2 = texelFetch(palettes, at + ivec2(2, 0), 0);
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+mat4 skinAt(int frame)
+{
+    return aWeights.x * fetchJoint(frame, aJoints.x) + aWeights.y * fetchJoint(frame, aJoints.y) +
+           aWeights.z * fetchJoint(frame, aJoints.z) + aWeights.w * fetchJoint(frame, aJoints.w);
+}
+
+void main()
+{
+    mat4 skin = skinAt(int(aAnimation.x));
+    // Far instances snap to one frame and skip the second set of fetches
+    if (aAnimation.z > 0.0)
+        skin = skin * (1.0 - aAnimation.z) + skinAt(int(aAnimation.y)) * aAnimation.z;
+
+    mat4 model = transpose(mat4(aModelRow0, aModelRow1, aModelRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+    mat4 world = model * skin;
+    gl_Position = projection * view * world * vec4(decodePosition(), 1.0);
+    TexCoord = aTexCoord;
+    Normal = mat3(world) * decodeNormal();
+    vec4 tangent = decodeTangent();
+    Tangent = vec4(mat3(world) * tangent.xyz, tangent.w);
+}
@@ -0,0 +1,8 @@
+// Ordered dither threshold of the pixel in [0, 1), a 4x4 Bayer matrix. Keeping the pixels under
+// some fraction and, on another draw, the ones at or over it covers each pixel exactly once.
+float ditherThreshold()
+{
+    const int bayer[16] = int[16](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    return (float(bayer[pixel.y * 4 + pixel.x]) + 0.5) / 16.0;
+}
@@ -0,0 +1,80 @@
+#version 330 core
+// Expands one culled blade point into the blade, for drawing straight from transform feedback
+// output. Mirrors grass.vert.glsl and the meshes built by GrassManager::buildBladeMeshes.
+layout (points) in;
+layout (triangle_strip, max_vertices = 9) out;
+
+in vec3 bladePos[];
+in float bladeWidth[];
+in float bladeHeight[];
+in vec3 bladeColor[];
+in float bladeRotation[];
+flat in int bladeTier[];
+
+out vec3 Normal;
+out vec3 FragPos;
+out vec2 TexCoord;
+out vec3 Color;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float time;
+uniform vec3 windDirection;
+uniform float windStrength;
+
+// Rows per LOD tier, matches GrassManager::LOD_SEGMENTS
+const int lodSegments[3] = int[3](4, 2, 1);
+const float bladeCurve = 0.3;
+
+mat4 modelMatrix;
+mat3 normalMatrix;
+
+mat4 rotationMatrix(vec3 axis, float angle) {
+    axis = normalize(axis);
+    float s = sin(angle);
+    float c = cos(angle);
+    float oc = 1.0 - c;
+    
+    return mat4(oc * axis.x * axis.x + c,           oc * axis.x * axis.y - axis.z * s,  oc * axis.z * axis.x + axis.y * s,  0.0,
+                oc * axis.x * axis.y + axis.z * s,  oc * axis.y * axis.y + c,           oc * axis.y * axis.z - axis.x * s,  0.0,
+                oc * axis.z * axis.x - axis.y * s,  oc * axis.y * axis.z + axis.x * s,  oc * axis.z * axis.z + c,           0.0,
+                0.0,                                0.0,                                0.0,                                1.0);
+}
+
+void emitBladeVertex(vec3 localPos, vec2 texCoord) {
+    localPos.z += bladeCurve * localPos.y * localPos.y * bladeHeight[0] / bladeWidth[0];
+    vec4 worldPos = modelMatrix * vec4(localPos, 1.0);
+    gl_Position = projection * view * worldPos;
+    FragPos = worldPos.xyz;
+    Normal = normalMatrix * vec3(0.0, 1.0, 0.0);
+    TexCoord = texCoord;
+    Color = bladeColor[0];
+    EmitVertex();
+}
+
+void main() {
+    vec3 instancePos = bladePos[0];
+
+    float windEffect = sin(time * 2.0 + instancePos.x * 10.0) * 0.2 * windStrength;
+    mat4 windRotation = rotationMatrix(vec3(0.0, 0.0, 1.0), windEffect * dot(windDirection, vec3(1.0, 0.0, 0.0)));
+    mat4 rotate = rotationMatrix(vec3(0.0, 1.0, 0.0), radians(bladeRotation[0]));
+    mat4 scale = mat4(1.0);
+    scale[0][0] = bladeWidth[0];
+    scale[1][1] = bladeHeight[0];
+    scale[2][2] = bladeWidth[0];
+    mat4 translate = mat4(1.0);
+    translate[3] = vec4(instancePos, 1.0);
+
+    modelMatrix = translate * rotate * windRotation * scale;
+    normalMatrix = mat3(transpose(inverse(modelMatrix)));
+
+    // Strip of left/right pairs per row, closed off by the tip
+    int segments = lodSegments[bladeTier[0]];
+    for (int row = 0; row < segments; ++row) {
+        float y = float(row) / float(segments);
+        emitBladeVertex(vec3(-0.5 * (1.0 - y), y, 0.0), vec2(0.0, y));
+        emitBladeVertex(vec3(0.5 * (1.0 - y), y, 0.0), vec2(1.0, y));
+    }
+    emitBladeVertex(vec3(0.0, 1.0, 0.0), vec2(0.5, 1.0));
+    EndPrimitive();
+}
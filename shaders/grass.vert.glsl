@@ -2,11 +2,7 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
-layout (location = 3) in vec3 instancePos;
-layout (location = 4) in float instanceWidth;
-layout (location = 5) in float instanceHeight;
-layout (location = 6) in vec3 instanceColor;
-layout (location = 7) in float instanceRotation;
+layout (location = 3) in uint bladeIndex;
 
 out vec3 Normal;
 out vec3 FragPos;
@@ -19,6 +15,11 @@ uniform float time;
 uniform vec3 windDirection;
 uniform float windStrength;
 
+#include "grass_blade.glsl"
+
+// How far the tip leans back, in blade heights
+const float bladeCurve = 0.3;
+
 mat4 rotationMatrix(vec3 axis, float angle) {
     axis = normalize(axis);
     float s = sin(angle);
@@ -50,6 +51,14 @@ mat4 scaleMatrix(vec3 scale) {
 }
 
 void main() {
+    BladeInstance blade = fetchBlade(bladeIndex);
+    vec3 instancePos = blade.position;
+    // Thinned out blades are made up for by widening the survivors
+    float instanceWidth = blade.width / lodDensity(distance(viewPos, instancePos));
+    float instanceHeight = blade.height;
+    vec3 instanceColor = blade.color;
+    float instanceRotation = blade.rotation;
+
     // Apply wind animation
     float windEffect = sin(time * 2.0 + instancePos.x * 10.0) * 0.2 * windStrength;
     mat4 windRotation = rotationMatrix(vec3(0.0, 0.0, 1.0), windEffect * dot(windDirection, vec3(1.0, 0.0, 0.0)));
@@ -66,9 +75,13 @@ void main() {
     modelMatrix = modelMatrix * windRotation;
     modelMatrix = modelMatrix * scale;
     
-    gl_Position = projection * view * modelMatrix * vec4(aPos, 1.0);
+    // Curve along z, scaled so the lean doesn't depend on the width
+    vec3 localPos = aPos;
+    localPos.z += bladeCurve * aPos.y * aPos.y * instanceHeight / instanceWidth;
+
+    gl_Position = projection * view * modelMatrix * vec4(localPos, 1.0);
     
-    FragPos = vec3(modelMatrix * vec4(aPos, 1.0));
+    FragPos = vec3(modelMatrix * vec4(localPos, 1.0));
     Normal = mat3(transpose(inverse(modelMatrix))) * aNormal;
     TexCoord = aTexCoord;
     Color = instanceColor;
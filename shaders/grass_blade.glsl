@@ -0,0 +1,78 @@
+// Blade fetch shared by every grass shader. All blades live in one static buffer, either as
+// GrassBlade floats or as 16-byte PackedGrassBlade records positioned relative to their cell.
+uniform bool packedBlades;
+uniform samplerBuffer bladeData;        // GrassBlade, 9 floats per blade (R32F)
+uniform usamplerBuffer packedBladeData; // PackedGrassBlade, one RGBA32UI texel per blade
+uniform samplerBuffer cellData;         // Per cell: root min x/y/z and root height span
+uniform float cellSize;
+
+// Distance LOD, mirrors GrassLodSettings
+uniform vec3 viewPos;
+uniform float lodDistances[2];
+uniform float thinningStart;
+uniform float thinningEnd;
+uniform float minDensity;
+
+struct BladeInstance {
+    vec3 position;
+    float width;
+    float height;
+    vec3 color;
+    float rotation;
+};
+
+// GLSL 3.30 has no unpackHalf2x16
+float halfToFloat(uint h) {
+    uint exponent = (h >> 10) & 0x1Fu;
+    float mantissa = float(h & 0x3FFu);
+    float value = exponent == 0u ? mantissa * exp2(-24.0)
+                                 : (1.0 + mantissa / 1024.0) * exp2(float(exponent) - 15.0);
+    return (h & 0x8000u) != 0u ? -value : value;
+}
+
+float bladeField(int base, int offset) {
+    return texelFetch(bladeData, base + offset).r;
+}
+
+int lodTier(float distance) {
+    return distance < lodDistances[0] ? 0 : (distance < lodDistances[1] ? 1 : 2);
+}
+
+float lodDensity(float distance) {
+    float t = clamp((distance - thinningStart) / max(thinningEnd - thinningStart, 1e-3), 0.0, 1.0);
+    return mix(1.0, minDensity, t);
+}
+
+// Stable value in [0, 1) per blade. The GPU paths thin blade by blade with it, the CPU path keeps
+// a prefix of each cell instead.
+float bladeRank(uint index) {
+    uint h = index;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return float(h >> 8) / 16777216.0;
+}
+
+BladeInstance fetchBlade(uint index) {
+    BladeInstance blade;
+    if (packedBlades) {
+        uvec4 bits = texelFetch(packedBladeData, int(index));
+        vec4 cell = texelFetch(cellData, int(bits.y >> 16));
+        vec3 local = vec3(float(bits.x & 0xFFFFu), float(bits.y & 0xFFFFu), float(bits.x >> 16)) / 65535.0;
+        blade.position = cell.xyz + local * vec3(cellSize, cell.w, cellSize);
+        blade.width = halfToFloat(bits.z & 0xFFFFu);
+        blade.height = halfToFloat(bits.z >> 16);
+        blade.color = vec3(float(bits.w & 0xFFu), float((bits.w >> 8) & 0xFFu), float((bits.w >> 16) & 0xFFu)) / 255.0;
+        blade.rotation = float(bits.w >> 24) * (360.0 / 256.0);
+    } else {
+        int base = int(index) * 9;
+        blade.position = vec3(bladeField(base, 0), bladeField(base, 1), bladeField(base, 2));
+        blade.width = bladeField(base, 3);
+        blade.height = bladeField(base, 4);
+        blade.color = vec3(bladeField(base, 5), bladeField(base, 6), bladeField(base, 7));
+        blade.rotation = bladeField(base, 8);
+    }
+    return blade;
+}
@@ -0,0 +1,47 @@
+#version 430 core
+layout (local_size_x = 256) in;
+
+layout (std430, binding = 0) writeonly buffer VisibleIndices {
+    uint visibleIndices[];
+};
+
+// DrawArraysIndirectCommand consumed by glDrawArraysIndirect
+struct DrawCommand {
+    uint vertexCount;
+    uint instanceCount;
+    uint firstVertex;
+    uint baseInstance;
+};
+
+// One command per LOD tier, tier t owns visibleIndices[t * bladeCount, (t + 1) * bladeCount)
+layout (std430, binding = 1) buffer DrawCommands {
+    DrawCommand commands[3];
+};
+
+uniform uint bladeCount;
+uniform vec4 frustumPlanes[6];
+
+#include "grass_blade.glsl"
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= bladeCount)
+        return;
+
+    BladeInstance blade = fetchBlade(index);
+    vec3 position = blade.position;
+    float height = blade.height;
+    if (height <= 0.0) // Padding in a streaming cell slot
+        return;
+    float viewDistance = distance(viewPos, position);
+    if (bladeRank(index) >= lodDensity(viewDistance))
+        return;
+
+    for (int i = 0; i < 6; ++i) {
+        if (dot(frustumPlanes[i].xyz, position) + frustumPlanes[i].w < -height)
+            return;
+    }
+
+    int tier = lodTier(viewDistance);
+    visibleIndices[uint(tier) * bladeCount + atomicAdd(commands[tier].instanceCount, 1u)] = index;
+}
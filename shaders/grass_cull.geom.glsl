@@ -0,0 +1,29 @@
+#version 330 core
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in vec3 bladePos[];
+in float bladeHeight[];
+flat in uint bladeIndex[];
+flat in int bladeThinned[];
+
+// Captured by transform feedback
+flat out uint outIndex;
+
+uniform vec4 frustumPlanes[6];
+
+void main() {
+    // Thinned out, or padding in a streaming cell slot
+    if (bladeThinned[0] != 0 || bladeHeight[0] <= 0.0)
+        return;
+
+    // Same test as the CPU path: the blade root may sit up to its height outside a plane
+    for (int i = 0; i < 6; ++i) {
+        if (dot(frustumPlanes[i].xyz, bladePos[0]) + frustumPlanes[i].w < -bladeHeight[0])
+            return;
+    }
+
+    outIndex = bladeIndex[0];
+    EmitVertex();
+    EndPrimitive();
+}
@@ -0,0 +1,16 @@
+#version 330 core
+// One point per blade, no attributes: the blade is fetched by gl_VertexID
+out vec3 bladePos;
+out float bladeHeight;
+flat out uint bladeIndex;
+flat out int bladeThinned;
+
+#include "grass_blade.glsl"
+
+void main() {
+    BladeInstance blade = fetchBlade(uint(gl_VertexID));
+    bladePos = blade.position;
+    bladeHeight = blade.height;
+    bladeIndex = uint(gl_VertexID);
+    bladeThinned = bladeRank(bladeIndex) < lodDensity(distance(viewPos, blade.position)) ? 0 : 1;
+}
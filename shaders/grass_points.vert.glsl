@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 3) in uint bladeIndex;
+
+out vec3 bladePos;
+out float bladeWidth;
+out float bladeHeight;
+out vec3 bladeColor;
+out float bladeRotation;
+flat out int bladeTier;
+
+#include "grass_blade.glsl"
+
+void main() {
+    BladeInstance blade = fetchBlade(bladeIndex);
+    float viewDistance = distance(viewPos, blade.position);
+    bladePos = blade.position;
+    bladeWidth = blade.width / lodDensity(viewDistance);
+    bladeHeight = blade.height;
+    bladeColor = blade.color;
+    bladeRotation = blade.rotation;
+    bladeTier = lodTier(viewDistance);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+in vec2 TexCoord;
+in float Fade;
+out vec4 FragColor;
+
+uniform sampler2D atlas;
+
+#include "dither.glsl"
+
+void main()
+{
+    // The pixels the fading mesh leaves out
+    if (ditherThreshold() < 1.0 - Fade)
+        discard;
+    // Cleared to zero around the model, so the mips hold colour premultiplied by coverage
+    vec4 color = texture(atlas, TexCoord);
+    if (color.a < 0.5)
+        discard;
+    FragColor = vec4(color.rgb / color.a, 1.0);
+}
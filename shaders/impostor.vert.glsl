@@ -0,0 +1,55 @@
+#version 330 core
+// Per instance, the same rows as props plus how far the impostor has faded in
+layout (location = 4) in vec4 aModelRow0;
+layout (location = 5) in vec4 aModelRow1;
+layout (location = 6) in vec4 aModelRow2;
+layout (location = 7) in float aFade;
+
+out vec2 TexCoord;
+out float Fade;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+uniform vec3 boundsCenter; // Model space, the frames are views of this sphere
+uniform float boundsRadius;
+uniform int gridSize;      // Frames per side of the atlas
+
+// The upper hemisphere (+Y) folded onto the square [-1, 1]^2, as PropRenderer bakes it
+vec2 encodeHemiOctahedral(vec3 v)
+{
+    vec2 p = v.xz / (abs(v.x) + abs(v.y) + abs(v.z));
+    return vec2(p.x + p.y, p.x - p.y);
+}
+
+vec3 decodeHemiOctahedral(vec2 e)
+{
+    vec2 p = vec2(e.x + e.y, e.x - e.y) * 0.5;
+    return normalize(vec3(p.x, 1.0 - abs(p.x) - abs(p.y), p.y));
+}
+
+void main()
+{
+    mat3 model = transpose(mat3(aModelRow0.xyz, aModelRow1.xyz, aModelRow2.xyz));
+    vec3 center = model * boundsCenter + vec3(aModelRow0.w, aModelRow1.w, aModelRow2.w);
+
+    // The view direction in the model's own frame picks the nearest baked frame. From below the
+    // horizon it's the side views.
+    vec3 toView = transpose(model) * (viewPos - center);
+    toView.y = max(toView.y, 0.0);
+    vec2 octahedral = encodeHemiOctahedral(normalize(toView + vec3(0.0, 1e-6, 0.0)));
+    float frames = float(gridSize);
+    vec2 cell = clamp(floor((octahedral * 0.5 + 0.5) * frames), 0.0, frames - 1.0);
+    vec3 direction = decodeHemiOctahedral((cell + 0.5) / frames * 2.0 - 1.0);
+
+    // The quad lies across that frame's view, like the orthographic camera that baked it
+    vec3 reference = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, -1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(reference, direction));
+    vec3 up = cross(direction, right);
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 position = center + model * ((right * corner.x + up * corner.y) * boundsRadius);
+
+    gl_Position = projection * view * vec4(position, 1.0);
+    TexCoord = (cell + corner * 0.5 + 0.5) / frames;
+    Fade = aFade;
+}
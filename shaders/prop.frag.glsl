@@ -0,0 +1,16 @@
+#version 330 core
+in vec2 TexCoord;
+in float Fade;
+out vec4 FragColor;
+
+uniform sampler2D texture1;
+
+#include "dither.glsl"
+
+void main()
+{
+    // Fading out towards the impostor, which draws the rest of the pattern
+    if (ditherThreshold() >= Fade)
+        discard;
+    FragColor = texture(texture1, TexCoord);
+}
@@ -0,0 +1,28 @@
+#version 330 core
+#include "vertex_decode.glsl"
+// Per instance
+layout (location = 4) in vec4 aModelRow0;
+layout (location = 5) in vec4 aModelRow1;
+layout (location = 6) in vec4 aModelRow2;
+layout (location = 7) in float aFade; // Below 1 while the impostor takes over
+
+out vec2 TexCoord;
+out vec3 Normal;
+out vec4 Tangent;
+out float Fade;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    // Props are static, their node transforms are already in the vertices
+    mat4 model = transpose(mat4(aModelRow0, aModelRow1, aModelRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+    gl_Position = projection * view * model * vec4(decodePosition(), 1.0);
+    TexCoord = aTexCoord;
+    // Instances only scale uniformly
+    Normal = mat3(model) * decodeNormal();
+    vec4 tangent = decodeTangent();
+    Tangent = vec4(mat3(model) * tangent.xyz, tangent.w);
+    Fade = aFade;
+}
@@ -0,0 +1,30 @@
+#version 330 core
+
+in vec3 Normal;
+in vec3 FragPos;
+
+out vec4 FragColor;
+
+uniform vec3 viewPos;
+
+void main()
+{
+    vec3 lightDir = normalize(vec3(0.4, 1.0, 0.3));
+    vec3 norm = normalize(Normal);
+
+    // Grass on the flats, dirt on slopes, rock on the steep parts
+    vec3 grass = vec3(0.18, 0.35, 0.12);
+    vec3 dirt = vec3(0.35, 0.28, 0.18);
+    vec3 rock = vec3(0.4, 0.4, 0.42);
+    float slope = 1.0 - norm.y;
+    vec3 albedo = mix(grass, dirt, smoothstep(0.1, 0.25, slope));
+    albedo = mix(albedo, rock, smoothstep(0.3, 0.5, slope));
+
+    float ambient = 0.3;
+    float diffuse = max(dot(norm, lightDir), 0.0);
+    vec3 result = (ambient + diffuse) * albedo;
+
+    // Fade into the clear color so chunks streaming in at the edge don't pop
+    float fog = smoothstep(60.0, 100.0, length(viewPos - FragPos));
+    FragColor = vec4(mix(result, vec3(0.1), fog), 1.0);
+}
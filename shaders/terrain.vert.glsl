@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in float aHeight;
+layout (location = 1) in vec4 aNormal;
+
+out vec3 Normal;
+out vec3 FragPos;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec2 chunkOrigin;
+uniform float gridSpacing;
+uniform int gridSize;
+
+void main()
+{
+    // x/z come from the vertex's place in the chunk grid
+    vec2 grid = vec2(gl_VertexID % gridSize, gl_VertexID / gridSize);
+    vec2 xz = chunkOrigin + grid * gridSpacing;
+
+    FragPos = vec3(xz.x, aHeight, xz.y);
+    Normal = aNormal.xyz;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -1,8 +1,18 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec2 aTexCoord;
+#include "vertex_decode.glsl"
+layout (location = 2) in uvec4 aJoints;
+layout (location = 3) in vec4 aWeights;
 
 out vec2 TexCoord;
+out vec3 Normal;
+out vec4 Tangent;
+
+const int MAX_JOINTS = 128; // See skinning.h
+
+layout (std140) uniform JointPalette
+{
+    mat4 joints[MAX_JOINTS];
+};
 
 uniform mat4 model;
 uniform mat4 view;
@@ -10,6 +20,14 @@ uniform mat4 projection;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    // Rigid meshes are weighted fully to their node's entry in the palette
+    mat4 skin = aWeights.x * joints[aJoints.x] + aWeights.y * joints[aJoints.y] +
+                aWeights.z * joints[aJoints.z] + aWeights.w * joints[aJoints.w];
+    mat4 world = model * skin;
+    gl_Position = projection * view * world * vec4(decodePosition(), 1.0);
     TexCoord = aTexCoord;
-}
\ No newline at end of file
+    // The skins don't scale unevenly, so the upper 3x3 turns normals and tangents too
+    Normal = mat3(world) * decodeNormal();
+    vec4 tangent = decodeTangent();
+    Tangent = vec4(mat3(world) * tangent.xyz, tangent.w);
+}
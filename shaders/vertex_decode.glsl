@@ -0,0 +1,35 @@
+// Attributes of the packed vertex formats and their decoding, see vertex_format.h. Skinned
+// meshes add joints and weights at locations 2 and 3.
+layout (location = 0) in vec4 aPos;      // Unorm16 across the mesh's bounds, w the bitangent sign
+layout (location = 1) in vec2 aTexCoord; // Half floats, read as they are
+layout (location = 8) in vec2 aNormal;   // Octahedral snorm16
+layout (location = 9) in vec2 aTangent;
+
+uniform vec3 positionOffset; // Model space bounds the positions were quantized across
+uniform vec3 positionScale;
+
+vec3 decodePosition()
+{
+    return positionOffset + aPos.xyz * positionScale;
+}
+
+// Unfolds the lower half of the octahedron back over the diagonals
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float fold = max(-v.z, 0.0);
+    v.x += v.x >= 0.0 ? -fold : fold;
+    v.y += v.y >= 0.0 ? -fold : fold;
+    return normalize(v);
+}
+
+vec3 decodeNormal()
+{
+    return decodeOctahedral(aNormal);
+}
+
+// w is the bitangent's sign, bitangent = cross(normal, tangent.xyz) * w
+vec4 decodeTangent()
+{
+    return vec4(decodeOctahedral(aTangent), aPos.w > 0.5 ? 1.0 : -1.0);
+}
@@ -0,0 +1,169 @@
+#include "animation.h"
+#include "gltf_accessor.h"
+#include "tiny_gltf.h"
+#include "transform_hierarchy.h"
+#include <algorithm>
+#include <glm/gtc/quaternion.hpp>
+#include <iostream>
+
+std::vector<AnimationClip> compileAnimationClips(const tinygltf::Model& model)
+{
+    std::vector<AnimationClip> clips;
+    for (const auto& animation : model.animations)
+    {
+        AnimationClip clip;
+        clip.name = animation.name;
+
+        for (const auto& channel : animation.channels)
+        {
+            AnimChannel compiled;
+            if (channel.target_path == "translation")
+                compiled.target = AnimTarget::Translation;
+            else if (channel.target_path == "rotation")
+                compiled.target = AnimTarget::Rotation;
+            else if (channel.target_path == "scale")
+                compiled.target = AnimTarget::Scale;
+            else
+                continue;
+            if (channel.target_node < 0 || channel.sampler < 0 ||
+                channel.sampler >= static_cast<int>(animation.samplers.size()))
+                continue;
+
+            const tinygltf::AnimationSampler& sampler = animation.samplers[channel.sampler];
+            if (sampler.interpolation == "STEP")
+                compiled.interpolation = AnimInterpolation::Step;
+            else if (sampler.interpolation == "CUBICSPLINE")
+                compiled.interpolation = AnimInterpolation::CubicSpline;
+            else
+                compiled.interpolation = AnimInterpolation::Linear;
+
+            int components = compiled.target == AnimTarget::Rotation ? 4 : 3;
+            std::vector<float> times = readAccessorFloats(model, sampler.input, 1);
+            std::vector<float> values = readAccessorFloats(model, sampler.output, components);
+            size_t valuesPerKey = compiled.interpolation == AnimInterpolation::CubicSpline ? 3 : 1;
+            if (times.empty() || values.size() < times.size() * valuesPerKey * components)
+            {
+                std::cerr << "Skipping malformed channel in animation " << animation.name
+                          << std::endl;
+                continue;
+            }
+
+            compiled.node = channel.target_node;
+            compiled.firstKey = static_cast<uint32_t>(clip.times.size());
+            compiled.keyCount = static_cast<uint32_t>(times.size());
+            compiled.firstValue = static_cast<uint32_t>(clip.values.size());
+            clip.times.insert(clip.times.end(), times.begin(), times.end());
+            for (size_t i = 0; i < times.size() * valuesPerKey; ++i)
+            {
+                const float* v = &values[i * components];
+                clip.values.push_back(glm::vec4(v[0], v[1], v[2], components == 4 ? v[3] : 0.0f));
+            }
+            clip.duration = std::max(clip.duration, times.back());
+            clip.channels.push_back(compiled);
+        }
+        clips.push_back(std::move(clip));
+    }
+    return clips;
+}
+
+// Key k with times[k] <= time < times[k + 1], for times[0] <= time < times[count - 1]. Tries
+// the hint and the key after it before falling back to a binary search.
+static uint32_t findKey(const float* times, uint32_t count, float time, uint32_t hint)
+{
+    if (hint + 1 < count && times[hint] <= time)
+    {
+        if (time < times[hint + 1])
+            return hint;
+        if (hint + 2 < count && time < times[hint + 2])
+            return hint + 1;
+    }
+    const float* upper = std::upper_bound(times + 1, times + count - 1, time);
+    return static_cast<uint32_t>(upper - times) - 1;
+}
+
+static glm::vec4 slerp(const glm::vec4& a, const glm::vec4& b, float t)
+{
+    // glTF stores x, y, z, w, glm::quat takes w first
+    glm::quat qa(a.w, a.x, a.y, a.z);
+    glm::quat qb(b.w, b.x, b.y, b.z);
+    glm::quat q = glm::slerp(qa, qb, t); // Takes the short way around
+    return glm::vec4(q.x, q.y, q.z, q.w);
+}
+
+static glm::vec4 sampleChannel(const AnimationClip& clip, const AnimChannel& channel, float time,
+                               uint32_t& cursor)
+{
+    const float* times = clip.times.data() + channel.firstKey;
+    const glm::vec4* values = clip.values.data() + channel.firstValue;
+    bool cubic = channel.interpolation == AnimInterpolation::CubicSpline;
+    // Index of key k's value, skipping the tangents around it
+    auto value = [&](uint32_t k) { return cubic ? values[k * 3 + 1] : values[k]; };
+
+    uint32_t last = channel.keyCount - 1;
+    if (time <= times[0] || last == 0)
+        return value(0);
+    if (time >= times[last])
+        return value(last);
+
+    uint32_t k = findKey(times, channel.keyCount, time, cursor);
+    cursor = k;
+    float dt = times[k + 1] - times[k];
+    float u = (time - times[k]) / dt;
+    bool rotation = channel.target == AnimTarget::Rotation;
+
+    switch (channel.interpolation)
+    {
+    case AnimInterpolation::Step:
+        return value(k);
+    case AnimInterpolation::Linear:
+        return rotation ? slerp(values[k], values[k + 1], u)
+                        : glm::mix(values[k], values[k + 1], u);
+    case AnimInterpolation::CubicSpline:
+    {
+        // Hermite spline, the tangents are per second so they scale with the key spacing
+        float u2 = u * u;
+        float u3 = u2 * u;
+        glm::vec4 result = (2.0f * u3 - 3.0f * u2 + 1.0f) * values[k * 3 + 1] +
+                           (u3 - 2.0f * u2 + u) * dt * values[k * 3 + 2] +
+                           (-2.0f * u3 + 3.0f * u2) * values[(k + 1) * 3 + 1] +
+                           (u3 - u2) * dt * values[(k + 1) * 3];
+        return rotation ? glm::normalize(result) : result;
+    }
+    }
+    return value(k);
+}
+
+void sampleClip(const AnimationClip& clip, float time, AnimationCursor* cursor, glm::vec4* out)
+{
+    if (cursor && cursor->keys.size() != clip.channels.size())
+        cursor->keys.assign(clip.channels.size(), 0);
+
+    for (size_t i = 0; i < clip.channels.size(); ++i)
+    {
+        uint32_t scratch = 0;
+        uint32_t& key = cursor ? cursor->keys[i] : scratch;
+        out[i] = sampleChannel(clip, clip.channels[i], time, key);
+    }
+}
+
+void applyChannels(const std::vector<AnimChannel>& channels, const glm::vec4* values,
+                   TransformHierarchy& hierarchy)
+{
+    for (size_t i = 0; i < channels.size(); ++i)
+    {
+        const glm::vec4& value = values[i];
+        int node = channels[i].node;
+        switch (channels[i].target)
+        {
+        case AnimTarget::Translation:
+            hierarchy.setTranslation(node, glm::vec3(value));
+            break;
+        case AnimTarget::Rotation:
+            hierarchy.setRotation(node, glm::quat(value.w, value.x, value.y, value.z));
+            break;
+        case AnimTarget::Scale:
+            hierarchy.setScale(node, glm::vec3(value));
+            break;
+        }
+    }
+}
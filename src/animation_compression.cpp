@@ -0,0 +1,424 @@
+#include "animation_compression.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <glm/gtc/quaternion.hpp>
+
+static const float SQRT2 = 1.41421356f;
+
+// Largest component dropped and rebuilt from the unit length, the other three in 15 bits each
+// over [-1/sqrt(2), 1/sqrt(2)], 2 + 45 bits across three words
+static void encodeRotation(glm::vec4 q, uint16_t* words)
+{
+    q = glm::normalize(q);
+    int largest = 0;
+    for (int i = 1; i < 4; ++i)
+    {
+        if (std::abs(q[i]) > std::abs(q[largest]))
+            largest = i;
+    }
+    if (q[largest] < 0.0f)
+        q = -q; // Same rotation, and the dropped component is known to be positive
+
+    uint64_t bits = static_cast<uint64_t>(largest);
+    for (int i = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        float v = std::clamp(q[i] * SQRT2, -1.0f, 1.0f);
+        bits = (bits << 15) | static_cast<uint64_t>(std::lround((v * 0.5f + 0.5f) * 32767.0f));
+    }
+    words[0] = static_cast<uint16_t>(bits >> 32);
+    words[1] = static_cast<uint16_t>(bits >> 16);
+    words[2] = static_cast<uint16_t>(bits);
+}
+
+static glm::vec4 decodeRotation(const uint16_t* words)
+{
+    const float scale = 2.0f / 32767.0f / SQRT2;
+    const float bias = -1.0f / SQRT2;
+
+    uint64_t bits = (static_cast<uint64_t>(words[0]) << 32) |
+                    (static_cast<uint64_t>(words[1]) << 16) | words[2];
+    float a = static_cast<float>((bits >> 30) & 0x7FFF) * scale + bias;
+    float b = static_cast<float>((bits >> 15) & 0x7FFF) * scale + bias;
+    float c = static_cast<float>(bits & 0x7FFF) * scale + bias;
+    float d = std::sqrt(std::max(1.0f - a * a - b * b - c * c, 0.0f));
+    // Built whole rather than written by index, which would go through memory
+    switch (bits >> 45)
+    {
+    case 0:
+        return glm::vec4(d, a, b, c);
+    case 1:
+        return glm::vec4(a, d, b, c);
+    case 2:
+        return glm::vec4(a, b, d, c);
+    default:
+        return glm::vec4(a, b, c, d);
+    }
+}
+
+static glm::vec4 slerp(const glm::vec4& a, const glm::vec4& b, float t)
+{
+    // glTF stores x, y, z, w, glm::quat takes w first
+    glm::quat q = glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), t);
+    return glm::vec4(q.x, q.y, q.z, q.w);
+}
+
+static glm::vec4 interpolate(AnimTarget target, const glm::vec4& a, const glm::vec4& b, float u)
+{
+    return target == AnimTarget::Rotation ? slerp(a, b, u) : glm::mix(a, b, u);
+}
+
+// Meters for translation, radians for rotation, the worst axis for scale
+static float valueError(AnimTarget target, const glm::vec4& a, const glm::vec4& b)
+{
+    switch (target)
+    {
+    case AnimTarget::Translation:
+        return glm::length(glm::vec3(a) - glm::vec3(b));
+    case AnimTarget::Rotation:
+    {
+        // atan2 of the chord lengths stays accurate for tiny angles where acos(dot) doesn't
+        glm::vec4 qa = glm::normalize(a);
+        glm::vec4 qb = glm::normalize(b);
+        if (glm::dot(qa, qb) < 0.0f)
+            qb = -qb;
+        return 4.0f * std::atan2(glm::length(qa - qb), glm::length(qa + qb));
+    }
+    case AnimTarget::Scale:
+    {
+        glm::vec3 diff = glm::abs(glm::vec3(a) - glm::vec3(b));
+        return std::max(diff.x, std::max(diff.y, diff.z));
+    }
+    }
+    return 0.0f;
+}
+
+static float toleranceFor(AnimTarget target, const AnimCompressionSettings& settings)
+{
+    switch (target)
+    {
+    case AnimTarget::Translation:
+        return settings.translationTolerance;
+    case AnimTarget::Rotation:
+        return settings.rotationTolerance;
+    case AnimTarget::Scale:
+        return settings.scaleTolerance;
+    }
+    return 0.0f;
+}
+
+static glm::vec4 decodeKey(const CompressedClip& clip, size_t channel, uint32_t key)
+{
+    const AnimChannel& c = clip.channels[channel];
+    const uint16_t* words = clip.words.data() + (c.firstKey + key) * 3;
+    if (c.target == AnimTarget::Rotation)
+        return decodeRotation(words);
+    const glm::vec3& min = clip.rangeMin[c.firstValue];
+    const glm::vec3& step = clip.rangeStep[c.firstValue];
+    return glm::vec4(min.x + words[0] * step.x, min.y + words[1] * step.y,
+                     min.z + words[2] * step.z, 0.0f);
+}
+
+// Marks the keys linear interpolation between kept neighbours can't rebuild within tolerance.
+// Splits at the worst key until every dropped one fits, so each segment is checked against
+// exactly the keys it replaces.
+static void reduceKeys(AnimTarget target, const std::vector<float>& times,
+                       const std::vector<glm::vec4>& exact, const std::vector<glm::vec4>& decoded,
+                       float tolerance, std::vector<uint8_t>& keep)
+{
+    std::vector<std::pair<size_t, size_t>> segments = { { 0, times.size() - 1 } };
+    while (!segments.empty())
+    {
+        auto [a, b] = segments.back();
+        segments.pop_back();
+        if (b - a < 2)
+            continue;
+
+        size_t worst = 0;
+        float worstError = tolerance;
+        for (size_t k = a + 1; k < b; ++k)
+        {
+            float u = (times[k] - times[a]) / std::max(times[b] - times[a], 1e-6f);
+            float error = valueError(target, interpolate(target, decoded[a], decoded[b], u),
+                                     exact[k]);
+            if (error > worstError)
+            {
+                worst = k;
+                worstError = error;
+            }
+        }
+        if (worst == 0)
+            continue;
+        keep[worst] = 1;
+        segments.emplace_back(a, worst);
+        segments.emplace_back(worst, b);
+    }
+}
+
+CompressedClip compressClip(const AnimationClip& clip, const AnimCompressionSettings& settings,
+                            AnimCompressionReport* report)
+{
+    CompressedClip result;
+    result.name = clip.name;
+    result.duration = clip.duration;
+    result.timeScale = clip.duration > 0.0f ? 65535.0f / clip.duration : 0.0f;
+    size_t channelCount = clip.channels.size();
+
+    // CubicSpline channels become Linear keys at a fixed rate, sampled for all of them at once
+    std::vector<float> resampleTimes;
+    std::vector<glm::vec4> resampled; // [sample * channelCount + channel]
+    bool anyCubic = std::any_of(clip.channels.begin(), clip.channels.end(), [](const auto& c)
+                                { return c.interpolation == AnimInterpolation::CubicSpline; });
+    if (anyCubic)
+    {
+        int count = static_cast<int>(std::ceil(clip.duration * settings.resampleRate)) + 1;
+        resampled.resize(count * channelCount);
+        AnimationCursor cursor;
+        for (int i = 0; i < count; ++i)
+        {
+            resampleTimes.push_back(std::min(i / settings.resampleRate, clip.duration));
+            sampleClip(clip, resampleTimes.back(), &cursor, &resampled[i * channelCount]);
+        }
+    }
+
+    std::vector<float> times;
+    std::vector<glm::vec4> exact;
+    std::vector<glm::vec4> decoded;
+    std::vector<uint16_t> words;
+    std::vector<uint8_t> keep;
+    for (size_t c = 0; c < channelCount; ++c)
+    {
+        AnimChannel channel = clip.channels[c];
+        times.clear();
+        exact.clear();
+        if (channel.interpolation == AnimInterpolation::CubicSpline)
+        {
+            times = resampleTimes;
+            for (size_t i = 0; i < resampleTimes.size(); ++i)
+                exact.push_back(resampled[i * channelCount + c]);
+            channel.interpolation = AnimInterpolation::Linear;
+        }
+        else
+        {
+            times.assign(clip.times.begin() + channel.firstKey,
+                         clip.times.begin() + channel.firstKey + channel.keyCount);
+            exact.assign(clip.values.begin() + channel.firstValue,
+                         clip.values.begin() + channel.firstValue + channel.keyCount);
+        }
+        size_t count = times.size();
+
+        // Snap the times to what will be stored so the reduction sees the same weights sampling
+        // will
+        for (float& time : times)
+            time = std::round(std::clamp(time * result.timeScale, 0.0f, 65535.0f));
+
+        // Quantize every key, the reduction works on what decoding gives back
+        glm::vec3 lo(FLT_MAX);
+        glm::vec3 hi(-FLT_MAX);
+        for (const glm::vec4& value : exact)
+        {
+            lo = glm::min(lo, glm::vec3(value));
+            hi = glm::max(hi, glm::vec3(value));
+        }
+        glm::vec3 step = (hi - lo) / 65535.0f;
+        words.resize(count * 3);
+        decoded.resize(count);
+        for (size_t k = 0; k < count; ++k)
+        {
+            if (channel.target == AnimTarget::Rotation)
+            {
+                encodeRotation(exact[k], &words[k * 3]);
+                decoded[k] = decodeRotation(&words[k * 3]);
+                continue;
+            }
+            for (int i = 0; i < 3; ++i)
+            {
+                float fraction = step[i] > 0.0f ? (exact[k][i] - lo[i]) / step[i] : 0.0f;
+                words[k * 3 + i] =
+                    static_cast<uint16_t>(std::lround(std::clamp(fraction, 0.0f, 65535.0f)));
+            }
+            decoded[k] = glm::vec4(lo + glm::vec3(words[k * 3], words[k * 3 + 1],
+                                                  words[k * 3 + 2]) * step, 0.0f);
+        }
+
+        float tolerance = toleranceFor(channel.target, settings);
+        keep.assign(count, 0);
+        keep[0] = 1;
+        bool constant = true;
+        for (size_t k = 1; k < count && constant; ++k)
+            constant = valueError(channel.target, decoded[0], exact[k]) <= tolerance;
+        if (!constant && channel.interpolation == AnimInterpolation::Step)
+        {
+            // A step key is only needed where the held value changes
+            size_t held = 0;
+            for (size_t k = 1; k < count; ++k)
+            {
+                if (valueError(channel.target, decoded[held], exact[k]) > tolerance)
+                {
+                    keep[k] = 1;
+                    held = k;
+                }
+            }
+        }
+        else if (!constant)
+        {
+            keep[count - 1] = 1;
+            reduceKeys(channel.target, times, exact, decoded, tolerance, keep);
+        }
+
+        channel.firstKey = static_cast<uint32_t>(result.times.size());
+        channel.firstValue = 0;
+        if (channel.target != AnimTarget::Rotation)
+        {
+            channel.firstValue = static_cast<uint32_t>(result.rangeMin.size());
+            result.rangeMin.push_back(lo);
+            result.rangeStep.push_back(step);
+        }
+        for (size_t k = 0; k < count; ++k)
+        {
+            // Keys closer than a time unit would make a zero length segment
+            if (!keep[k] || (k > 0 && result.times.size() > channel.firstKey &&
+                             result.times.back() == static_cast<uint16_t>(times[k])))
+                continue;
+            result.times.push_back(static_cast<uint16_t>(times[k]));
+            result.words.insert(result.words.end(), &words[k * 3], &words[k * 3] + 3);
+        }
+        channel.keyCount = static_cast<uint32_t>(result.times.size()) - channel.firstKey;
+        result.channels.push_back(channel);
+    }
+
+    if (report)
+    {
+        *report = AnimCompressionReport();
+        report->rawKeys = clip.times.size();
+        report->compressedKeys = result.times.size();
+        report->rawBytes = clipBytes(clip);
+        report->compressedBytes = clipBytes(result);
+
+        // Every source key time and the points halfway between them
+        std::vector<float> checkTimes(clip.times);
+        std::sort(checkTimes.begin(), checkTimes.end());
+        checkTimes.erase(std::unique(checkTimes.begin(), checkTimes.end()), checkTimes.end());
+        for (size_t i = 1, count = checkTimes.size(); i < count; ++i)
+            checkTimes.push_back((checkTimes[i - 1] + checkTimes[i]) * 0.5f);
+
+        std::vector<glm::vec4> source(channelCount);
+        std::vector<glm::vec4> compressed(channelCount);
+        for (float time : checkTimes)
+        {
+            sampleClip(clip, time, nullptr, source.data());
+            sampleCompressedClip(result, time, nullptr, compressed.data());
+            for (size_t c = 0; c < channelCount; ++c)
+            {
+                AnimTarget target = clip.channels[c].target;
+                float error = valueError(target, source[c], compressed[c]);
+                float& worst = target == AnimTarget::Translation ? report->maxTranslationError
+                               : target == AnimTarget::Rotation  ? report->maxRotationError
+                                                                 : report->maxScaleError;
+                worst = std::max(worst, error);
+            }
+        }
+    }
+    return result;
+}
+
+// Key k with times[k] <= time < times[k + 1], tries the hint and the key after it first
+static uint32_t findKey(const uint16_t* times, uint32_t count, float time, uint32_t hint)
+{
+    if (hint + 1 < count && times[hint] <= time)
+    {
+        if (time < times[hint + 1])
+            return hint;
+        if (hint + 2 < count && time < times[hint + 2])
+            return hint + 1;
+    }
+    const uint16_t* upper = std::upper_bound(times + 1, times + count - 1, time);
+    return static_cast<uint32_t>(upper - times) - 1;
+}
+
+// Keys k and k + 1 of a channel (only k at its last key). With a cursor each pair is decoded
+// once, and playing forward only decodes the new key of the next pair.
+static const glm::vec4* decodePair(const CompressedClip& clip, size_t channel, uint32_t k,
+                                   AnimationCursor* cursor, glm::vec4* scratch)
+{
+    uint32_t last = clip.channels[channel].keyCount - 1;
+    if (!cursor)
+    {
+        scratch[0] = decodeKey(clip, channel, k);
+        if (k < last)
+            scratch[1] = decodeKey(clip, channel, k + 1);
+        return scratch;
+    }
+
+    glm::vec4* pair = &cursor->decoded[channel * 2];
+    uint32_t& decodedKey = cursor->decodedKeys[channel];
+    if (decodedKey == k)
+        return pair;
+    if (decodedKey != UINT32_MAX && decodedKey + 1 == k)
+        pair[0] = pair[1];
+    else
+        pair[0] = decodeKey(clip, channel, k);
+    if (k < last)
+        pair[1] = decodeKey(clip, channel, k + 1);
+    decodedKey = k;
+    return pair;
+}
+
+void sampleCompressedClip(const CompressedClip& clip, float time, AnimationCursor* cursor,
+                          glm::vec4* out)
+{
+    if (cursor && (cursor->decodedClip != &clip || cursor->keys.size() != clip.channels.size()))
+    {
+        cursor->keys.assign(clip.channels.size(), 0);
+        cursor->decodedClip = &clip;
+        cursor->decodedKeys.assign(clip.channels.size(), UINT32_MAX);
+        cursor->decoded.resize(clip.channels.size() * 2);
+    }
+
+    float t = std::clamp(time * clip.timeScale, 0.0f, 65535.0f);
+    glm::vec4 scratch[2];
+    for (size_t i = 0; i < clip.channels.size(); ++i)
+    {
+        const AnimChannel& channel = clip.channels[i];
+        const uint16_t* times = clip.times.data() + channel.firstKey;
+        uint32_t last = channel.keyCount - 1;
+        if (last == 0 || t <= times[0])
+        {
+            out[i] = decodePair(clip, i, 0, cursor, scratch)[0];
+            continue;
+        }
+        if (t >= times[last])
+        {
+            out[i] = decodePair(clip, i, last, cursor, scratch)[0];
+            continue;
+        }
+
+        uint32_t scratchKey = 0;
+        uint32_t& key = cursor ? cursor->keys[i] : scratchKey;
+        uint32_t k = findKey(times, channel.keyCount, t, key);
+        key = k;
+        const glm::vec4* pair = decodePair(clip, i, k, cursor, scratch);
+        if (channel.interpolation == AnimInterpolation::Step)
+        {
+            out[i] = pair[0];
+            continue;
+        }
+        float u = (t - times[k]) / static_cast<float>(times[k + 1] - times[k]);
+        out[i] = interpolate(channel.target, pair[0], pair[1], u);
+    }
+}
+
+size_t clipBytes(const AnimationClip& clip)
+{
+    return clip.channels.size() * sizeof(AnimChannel) + clip.times.size() * sizeof(float) +
+           clip.values.size() * sizeof(glm::vec4);
+}
+
+size_t clipBytes(const CompressedClip& clip)
+{
+    return clip.channels.size() * sizeof(AnimChannel) +
+           (clip.rangeMin.size() + clip.rangeStep.size()) * sizeof(glm::vec3) +
+           (clip.times.size() + clip.words.size()) * sizeof(uint16_t);
+}
@@ -0,0 +1,497 @@
+#include "asset_streamer.h"
+#include "mesh_optimize.h"
+#include "tiny_gltf.h"
+#include "transform_hierarchy.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <glm/gtc/type_ptr.hpp>
+
+AssetStreamer::AssetStreamer(const AssetStreamSettings& settings)
+    : m_settings(settings)
+    , m_threadPool(nullptr)
+    , m_textureCache(nullptr)
+    , m_placeholderTexture(0)
+    , m_frame(0)
+    , m_rankedFrom(0.0f)
+    , m_rankingStale(true)
+    , m_jobsInFlight(0)
+    , m_residentCount(0)
+    , m_pendingCount(0)
+    , m_uploadedBytes(0)
+{
+}
+
+AssetStreamer::~AssetStreamer()
+{
+    // Jobs still in flight own their results and finish on their own
+    for (const Asset& asset : m_assets)
+    {
+        for (GLuint texture : asset.textures)
+            m_textureCache->release(texture);
+    }
+    for (StagingBuffer& staging : m_staging)
+    {
+        if (staging.fence)
+            glDeleteSync(staging.fence);
+        glDeleteBuffers(1, &staging.buffer);
+    }
+    glDeleteTextures(1, &m_placeholderTexture);
+}
+
+void AssetStreamer::initialize()
+{
+    m_meshPool.initialize(VertexFormat::Static);
+
+    // Mid grey, so a prop still loading reads as a shape and not as a hole
+    const uint8_t grey[4] = { 128, 128, 128, 255 };
+    glGenTextures(1, &m_placeholderTexture);
+    glBindTexture(GL_TEXTURE_2D, m_placeholderTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    for (StagingBuffer& staging : m_staging)
+    {
+        glGenBuffers(1, &staging.buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, staging.buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, m_settings.uploadBudget, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+AssetHandle AssetStreamer::request(const std::string& path)
+{
+    auto it = m_handles.find(path);
+    if (it != m_handles.end())
+        return it->second;
+    m_handles.emplace(path, static_cast<AssetHandle>(m_assets.size()));
+    Asset asset;
+    asset.path = path;
+    m_assets.push_back(std::move(asset));
+    m_rankingStale = true;
+    return static_cast<AssetHandle>(m_assets.size() - 1);
+}
+
+void AssetStreamer::addUse(AssetHandle asset, const glm::vec3& position)
+{
+    Asset& target = m_assets[asset];
+    glm::ivec2 cell(static_cast<int>(std::floor(position.x / m_settings.useCellSize)),
+                    static_cast<int>(std::floor(position.z / m_settings.useCellSize)));
+    if (!target.useCells.empty() && target.useCells.back() == cell)
+        return;
+    target.useCells.push_back(cell);
+    target.useCellsUnique = false;
+    m_rankingStale = true;
+}
+
+void AssetStreamer::decode(const std::string& path, Decoded& decoded)
+{
+    tinygltf::Model model;
+    tinygltf::TinyGLTF loader;
+    std::string err, warn;
+    bool binary = std::filesystem::path(path).extension() == ".glb";
+    bool loaded = binary ? loader.LoadBinaryFromFile(&model, &err, &warn, path)
+                         : loader.LoadASCIIFromFile(&model, &err, &warn, path);
+    if (!loaded)
+    {
+        std::cerr << "Failed to stream " << path << ": " << err << std::endl;
+        return;
+    }
+
+    // Without a skin every mesh is weighted to its node's slot. Props are drawn without a
+    // palette, so those nodes' rest poses go into the vertices instead.
+    std::vector<CookedPart> parts;
+    std::vector<int32_t> attachments;
+    cookGeometry(model, 0, decoded.vertices, decoded.indices, parts, attachments);
+    optimizeParts(decoded.vertices, decoded.indices, parts);
+    TransformHierarchy hierarchy;
+    hierarchy.build(model);
+    // Normals go through the inverse transpose so non-uniform scales keep them perpendicular
+    std::vector<glm::mat3> normalMatrices;
+    for (int32_t node : attachments)
+    {
+        glm::mat3 world(hierarchy.getWorldMatrix(node));
+        normalMatrices.push_back(glm::transpose(glm::inverse(world)));
+    }
+    for (MeshVertex& vertex : decoded.vertices)
+    {
+        uint16_t slot = vertex.joints[0];
+        vertex.joints[0] = 0;
+        if (slot >= attachments.size())
+            continue;
+        const glm::mat4& world = hierarchy.getWorldMatrix(attachments[slot]);
+        glm::vec3 position(world * glm::vec4(glm::make_vec3(vertex.position), 1.0f));
+        glm::vec3 normal = glm::normalize(normalMatrices[slot] * glm::make_vec3(vertex.normal));
+        glm::vec3 tangent = glm::normalize(glm::mat3(world) * glm::make_vec3(vertex.tangent));
+        std::copy_n(&position[0], 3, vertex.position);
+        std::copy_n(&normal[0], 3, vertex.normal);
+        std::copy_n(&tangent[0], 3, vertex.tangent);
+        // A mirroring transform turns the bitangent around with it
+        if (glm::determinant(glm::mat3(world)) < 0.0f)
+            vertex.tangent[3] = -vertex.tangent[3];
+    }
+    // Each texture's primitives go to the GPU together, as one instanced batch
+    cookPartTextures(model, path, parts, decoded.textures, decoded.mips, decoded.pixels);
+    std::vector<int> batchTextures;
+    for (const CookedPart& part : parts)
+    {
+        if (std::find(batchTextures.begin(), batchTextures.end(), part.texture) ==
+            batchTextures.end())
+            batchTextures.push_back(part.texture);
+    }
+
+    // Every batch gets its own LODs, one after the other in the index buffer. The coarser ones
+    // come out of the simplifier in collapse order, sort them like LOD 0.
+    std::vector<uint32_t> indices;
+    indices.swap(decoded.indices);
+    for (int texture : batchTextures)
+    {
+        std::vector<uint32_t> batchIndices;
+        for (size_t p = 0; p < parts.size(); ++p)
+        {
+            if (parts[p].texture != texture)
+                continue;
+            auto first = indices.begin() + parts[p].firstIndex;
+            batchIndices.insert(batchIndices.end(), first, first + parts[p].indexCount);
+        }
+        if (batchIndices.empty())
+            continue;
+        std::vector<MeshLod> lods = buildMeshLods(decoded.vertices, batchIndices);
+        for (size_t i = 1; i < lods.size(); ++i)
+        {
+            uint32_t* lod = batchIndices.data() + lods[i].firstIndex;
+            optimizeVertexCache(lod, lods[i].indexCount, decoded.vertices.size());
+            optimizeOverdraw(lod, lods[i].indexCount, decoded.vertices.data(),
+                             decoded.vertices.size());
+        }
+
+        DecodedBatch batch;
+        batch.texture = texture;
+        for (size_t i = 0; i < MAX_MESH_LODS; ++i)
+        {
+            batch.lods[i] = lods[std::min(i, lods.size() - 1)];
+            batch.lods[i].firstIndex += static_cast<uint32_t>(decoded.indices.size());
+        }
+        decoded.batches.push_back(batch);
+        decoded.lodCount = std::max(decoded.lodCount, static_cast<int>(lods.size()));
+        decoded.indices.insert(decoded.indices.end(), batchIndices.begin(), batchIndices.end());
+    }
+
+    // Only the packed vertices are kept for the upload, their bounds are the asset's
+    decoded.quantization = computeQuantization(decoded.vertices.data(), decoded.vertices.size());
+    decoded.packed.resize(decoded.vertices.size());
+    packVertices(decoded.vertices.data(), decoded.vertices.size(), decoded.quantization,
+                 decoded.packed.data());
+    decoded.vertices = std::vector<MeshVertex>();
+    decoded.ok = !decoded.indices.empty();
+}
+
+size_t AssetStreamer::itemSize(const Decoded& decoded, size_t item)
+{
+    if (item == 0)
+        return decoded.packed.size() * sizeof(StaticVertex);
+    if (item == 1)
+        return decoded.indices.size() * sizeof(uint32_t);
+    return decoded.mips[item - 2].size;
+}
+
+const uint8_t* AssetStreamer::itemData(const Decoded& decoded, size_t item)
+{
+    if (item == 0)
+        return reinterpret_cast<const uint8_t*>(decoded.packed.data());
+    if (item == 1)
+        return reinterpret_cast<const uint8_t*>(decoded.indices.data());
+    return decoded.pixels.data() + decoded.mips[item - 2].offset;
+}
+
+void AssetStreamer::update(const glm::vec3& viewPos)
+{
+    // Collect what the workers finished
+    for (Asset& asset : m_assets)
+    {
+        if (asset.state != AssetState::Loading ||
+            !asset.decoded->ready.load(std::memory_order_acquire))
+            continue;
+        m_jobsInFlight--;
+        if (!asset.decoded->ok)
+        {
+            asset.state = AssetState::Failed;
+            asset.decoded.reset();
+            continue;
+        }
+        asset.state = AssetState::Uploading;
+        asset.data.quantization = asset.decoded->quantization;
+        asset.data.boundsMin = asset.decoded->quantization.offset;
+        asset.data.boundsMax = asset.decoded->quantization.offset +
+                               asset.decoded->quantization.scale;
+        acquireTextures(asset);
+    }
+
+    // Distances only change as much as the view moves, so they're taken again after it has
+    // moved a little or uses were added, not every frame
+    bool rank = m_rankingStale ||
+                glm::distance(viewPos, m_rankedFrom) > m_settings.reprioritizeDistance;
+    glm::vec2 viewXZ(viewPos.x, viewPos.z);
+    float cellSize = m_settings.useCellSize;
+    m_pendingCount = 0;
+    for (Asset& asset : m_assets)
+    {
+        if (asset.state == AssetState::Resident || asset.state == AssetState::Failed)
+            continue;
+        m_pendingCount++;
+        if (!rank)
+            continue;
+        if (!asset.useCellsUnique)
+        {
+            auto less = [](glm::ivec2 a, glm::ivec2 b)
+            { return a.x < b.x || (a.x == b.x && a.y < b.y); };
+            std::sort(asset.useCells.begin(), asset.useCells.end(), less);
+            asset.useCells.erase(std::unique(asset.useCells.begin(), asset.useCells.end()),
+                                 asset.useCells.end());
+            asset.useCellsUnique = true;
+        }
+        // Unused assets still load, after everything else
+        asset.distance = 1e30f;
+        for (glm::ivec2 cell : asset.useCells)
+        {
+            glm::vec2 min = glm::vec2(cell) * cellSize;
+            glm::vec2 closest = glm::clamp(viewXZ, min, min + glm::vec2(cellSize));
+            asset.distance = std::min(asset.distance, glm::distance(viewXZ, closest));
+        }
+    }
+    if (rank)
+    {
+        m_rankedFrom = viewPos;
+        m_rankingStale = false;
+    }
+
+    startJobs();
+    upload();
+
+    // Whatever has every item queued is drawn from now on, once the textures it shares are filled
+    m_residentCount = 0;
+    for (Asset& asset : m_assets)
+    {
+        if (asset.state != AssetState::Uploading || asset.nextItem != itemCount(*asset.decoded))
+            continue;
+        const Decoded& decoded = *asset.decoded;
+        if (std::all_of(decoded.textures.begin(), decoded.textures.end(),
+                        [&](const CookedTexture& texture)
+                        { return m_textureCache->isComplete(texture.hash); }))
+        {
+            asset.state = AssetState::Resident;
+            for (const DecodedBatch& source : decoded.batches)
+            {
+                StreamedBatch batch;
+                for (size_t i = 0; i < MAX_MESH_LODS; ++i)
+                {
+                    batch.lods[i] = asset.mesh;
+                    batch.lods[i].firstIndex += source.lods[i].firstIndex;
+                    batch.lods[i].indexCount = source.lods[i].indexCount;
+                }
+                batch.texture =
+                    source.texture >= 0 ? asset.textures[source.texture] : m_placeholderTexture;
+                asset.data.batches.push_back(batch);
+            }
+            asset.data.lodCount = decoded.lodCount;
+            asset.decoded.reset();
+        }
+        m_residentCount += asset.state == AssetState::Resident ? 1 : 0;
+    }
+}
+
+void AssetStreamer::acquireTextures(Asset& asset)
+{
+    Decoded& decoded = *asset.decoded;
+    std::vector<CookedMip> mips;
+    for (CookedTexture& texture : decoded.textures)
+    {
+        GLuint shared = m_textureCache->acquire(texture.hash);
+        if (shared == 0)
+        {
+            asset.textures.push_back(m_textureCache->create(
+                texture.hash, decoded.mips.data() + texture.firstMip, texture.mipCount));
+            mips.insert(mips.end(), decoded.mips.begin() + texture.firstMip,
+                        decoded.mips.begin() + texture.firstMip + texture.mipCount);
+            texture.firstMip = static_cast<uint32_t>(mips.size() - texture.mipCount);
+            continue;
+        }
+        // Nothing of it to upload
+        asset.textures.push_back(shared);
+        texture.firstMip = static_cast<uint32_t>(mips.size());
+        texture.mipCount = 0;
+    }
+    decoded.mips.swap(mips);
+    if (decoded.mips.empty())
+        std::vector<uint8_t>().swap(decoded.pixels);
+}
+
+void AssetStreamer::startJobs()
+{
+    m_order.clear();
+    for (size_t i = 0; i < m_assets.size(); ++i)
+    {
+        if (m_assets[i].state == AssetState::Queued)
+            m_order.push_back(static_cast<AssetHandle>(i));
+    }
+    std::sort(m_order.begin(), m_order.end(), [&](AssetHandle a, AssetHandle b)
+              { return m_assets[a].distance < m_assets[b].distance; });
+
+    // Without workers one asset is decoded right here each frame
+    bool async = m_threadPool && m_threadPool->getThreadCount() > 0;
+    int capacity = async ? m_settings.maxJobsInFlight - m_jobsInFlight : 1;
+    size_t start = std::min(m_order.size(), static_cast<size_t>(std::max(capacity, 0)));
+    for (size_t i = 0; i < start; ++i)
+    {
+        Asset& asset = m_assets[m_order[i]];
+        asset.state = AssetState::Loading;
+        asset.decoded = std::make_shared<Decoded>();
+        m_jobsInFlight++;
+        if (async)
+        {
+            m_threadPool->submit(
+                [path = asset.path, decoded = asset.decoded]
+                {
+                    decode(path, *decoded);
+                    decoded->ready.store(true, std::memory_order_release);
+                });
+        }
+        else
+        {
+            decode(asset.path, *asset.decoded);
+            asset.decoded->ready.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+void AssetStreamer::upload()
+{
+    m_uploadedBytes = 0;
+    m_order.clear();
+    for (size_t i = 0; i < m_assets.size(); ++i)
+    {
+        const Asset& asset = m_assets[i];
+        if (asset.state == AssetState::Uploading && asset.nextItem < itemCount(*asset.decoded))
+            m_order.push_back(static_cast<AssetHandle>(i));
+    }
+    if (m_order.empty())
+        return;
+    std::sort(m_order.begin(), m_order.end(), [&](AssetHandle a, AssetHandle b)
+              { return m_assets[a].distance < m_assets[b].distance; });
+
+    // The buffer filled three frames ago. If the GPU still hasn't copied out of it, skip a
+    // frame rather than stall on it.
+    StagingBuffer& staging = m_staging[m_frame++ % 3];
+    if (staging.fence)
+    {
+        if (glClientWaitSync(staging.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return;
+        glDeleteSync(staging.fence);
+        staging.fence = nullptr;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, staging.buffer);
+    uint8_t* mapped = static_cast<uint8_t*>(
+        glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_settings.uploadBudget,
+                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+                             GL_MAP_UNSYNCHRONIZED_BIT));
+    if (!mapped)
+        return;
+
+    struct Staged
+    {
+        AssetHandle asset;
+        size_t item;
+        size_t offset;
+    };
+    std::vector<Staged> staged;
+    size_t used = 0;
+    AssetHandle oversizedAsset = 0;
+    size_t oversizedItem = SIZE_MAX;
+    for (AssetHandle handle : m_order)
+    {
+        Asset& asset = m_assets[handle];
+        const Decoded& decoded = *asset.decoded;
+        for (; asset.nextItem < itemCount(decoded); ++asset.nextItem)
+        {
+            size_t size = itemSize(decoded, asset.nextItem);
+            // Items bigger than a staging buffer take a frame's budget and a buffer of their own
+            if (size > m_settings.uploadBudget)
+            {
+                if (used == 0)
+                {
+                    oversizedAsset = handle;
+                    oversizedItem = asset.nextItem++;
+                    used = m_settings.uploadBudget;
+                }
+                break;
+            }
+            if (used + size > m_settings.uploadBudget)
+                break;
+            std::memcpy(mapped + used, itemData(decoded, asset.nextItem), size);
+            staged.push_back({ handle, asset.nextItem, used });
+            used += (size + 15) & ~size_t(15);
+        }
+        if (asset.nextItem < itemCount(decoded))
+            break;
+    }
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+
+    for (const Staged& item : staged)
+    {
+        finishItem(m_assets[item.asset], item.item, staging.buffer, item.offset);
+        m_uploadedBytes += itemSize(*m_assets[item.asset].decoded, item.item);
+    }
+    if (oversizedItem != SIZE_MAX)
+    {
+        const Decoded& decoded = *m_assets[oversizedAsset].decoded;
+        size_t size = itemSize(decoded, oversizedItem);
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, itemData(decoded, oversizedItem),
+                     GL_STREAM_DRAW);
+        finishItem(m_assets[oversizedAsset], oversizedItem, buffer, 0);
+        glDeleteBuffers(1, &buffer); // Freed once the copy is done
+        m_uploadedBytes += size;
+    }
+    staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void AssetStreamer::finishItem(Asset& asset, size_t item, GLuint source, size_t offset)
+{
+    const Decoded& decoded = *asset.decoded;
+    if (item == 0)
+    {
+        asset.mesh = m_meshPool.reserve(decoded.packed.size(), decoded.indices.size());
+        m_meshPool.copyVertices(asset.mesh, source, offset);
+        return;
+    }
+    if (item == 1)
+    {
+        m_meshPool.copyIndices(asset.mesh, source, offset);
+        return;
+    }
+
+    // The cache made the storage, the levels fill it
+    size_t mipIndex = item - 2;
+    size_t texture = 0;
+    while (mipIndex >= decoded.textures[texture].firstMip + decoded.textures[texture].mipCount)
+        texture++;
+    size_t level = mipIndex - decoded.textures[texture].firstMip;
+    const CookedMip& mip = decoded.mips[mipIndex];
+    glBindTexture(GL_TEXTURE_2D, asset.textures[texture]);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, source);
+    glTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), 0, 0, mip.width, mip.height,
+                    GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(offset));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (level + 1 == decoded.textures[texture].mipCount)
+        m_textureCache->markComplete(decoded.textures[texture].hash);
+}
@@ -0,0 +1,755 @@
+#include "bench.h"
+#include "animation.h"
+#include "animation_compression.h"
+#include "cooked_model.h"
+#include "grass.h"
+#include "grass_cull.h"
+#include "mesh_optimize.h"
+#include "mesh_simplify.h"
+#include "packing.h"
+#include "scatter.h"
+#include "terrain.h"
+#include "thread_pool.h"
+#include "transform_hierarchy.h"
+#include "vertex_format.h"
+#include "tiny_gltf.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <random>
+
+#include <fmt/format.h>
+
+// Average milliseconds per call over enough iterations to fill roughly half a second
+static double timeMs(const std::function<void()>& fn)
+{
+    using Clock = std::chrono::steady_clock;
+    fn(); // warm caches
+    int iterations = 0;
+    auto start = Clock::now();
+    auto now = start;
+    do
+    {
+        fn();
+        iterations++;
+        now = Clock::now();
+    } while (now - start < std::chrono::milliseconds(500));
+    return std::chrono::duration<double, std::milli>(now - start).count() / iterations;
+}
+
+// The array-of-structs loop GrassManager used before the SoA kernels
+static size_t cullBladesAoS(const std::vector<GrassBlade>& blades,
+                            const std::array<Camera::FrustumPlane, 6>& planes,
+                            std::vector<GrassBlade>& visible)
+{
+    visible.clear();
+    for (const auto& blade : blades)
+    {
+        bool isVisible = true;
+        for (int i = 0; i < 6; i++)
+        {
+            if (glm::dot(planes[i].normal, blade.position) + planes[i].distance < -blade.height)
+            {
+                isVisible = false;
+                break;
+            }
+        }
+        if (isVisible)
+            visible.push_back(blade);
+    }
+    return visible.size();
+}
+
+static void benchGrassCull(size_t bladeCount)
+{
+    // Keep the density of the default 160k blades on 60x60 field
+    float side = 60.0f * std::sqrt(bladeCount / 160000.0f);
+
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> posDist(-side / 2, side / 2);
+    std::uniform_real_distribution<float> heightDist(0.3f, 0.7f);
+
+    std::vector<GrassBlade> blades(bladeCount);
+    GrassCullData data;
+    data.resize(bladeCount);
+    for (size_t i = 0; i < bladeCount; ++i)
+    {
+        blades[i] = GrassBlade{ glm::vec3(posDist(gen), 0.0f, posDist(gen)), 0.03f,
+                                heightDist(gen), glm::vec3(0.1f, 0.6f, 0.1f), 0.0f };
+        data.x[i] = blades[i].position.x;
+        data.y[i] = blades[i].position.y;
+        data.z[i] = blades[i].position.z;
+        data.height[i] = blades[i].height;
+    }
+
+    Camera camera(glm::vec3(0.0f));
+    camera.processMouseMovement(300.0f, -150.0f);
+    auto planes = camera.getFrustumPlanes(16.0f / 9.0f);
+
+    std::vector<GrassBlade> visible;
+    visible.reserve(bladeCount);
+    std::vector<uint32_t> indices(bladeCount + GRASS_CULL_PADDING);
+
+    size_t expected = 0;
+    double baseline = timeMs([&] { expected = cullBladesAoS(blades, planes, visible); });
+    std::cout << fmt::format("grass_cull {:>8} blades  {:<8} {:8.3f} ms  {:>8} visible\n",
+                             bladeCount, "AoS", baseline, expected);
+
+    std::vector<GrassCullKernel> kernels = { cullBladesScalar };
+#if defined(__x86_64__) || defined(__i386__)
+    bool popcnt = __builtin_cpu_supports("popcnt");
+    if (popcnt && __builtin_cpu_supports("sse4.1"))
+        kernels.push_back(cullBladesSSE);
+    if (popcnt && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        kernels.push_back(cullBladesAVX2);
+#endif
+
+    for (GrassCullKernel kernel : kernels)
+    {
+        size_t survivors = 0;
+        double ms =
+            timeMs([&] { survivors = kernel(data, 0, bladeCount, planes, indices.data()); });
+        std::cout << fmt::format(
+            "grass_cull {:>8} blades  {:<8} {:8.3f} ms  {:>8} visible  {:5.2f}x{}\n", bladeCount,
+            grassCullKernelName(kernel), ms, survivors, baseline / ms,
+            survivors == expected ? "" : "  MISMATCH");
+    }
+}
+
+// Grass-density jittered scatter over a square of cells, serial against the pool. The output has to
+// be bit-identical no matter how the cells get spread over threads.
+static void benchScatter(int cellsPerSide)
+{
+    ScatterLayer layer;
+    layer.density = 45.0f;
+    const float cellSize = 4.0f;
+    const size_t cells = static_cast<size_t>(cellsPerSide) * cellsPerSide;
+    const size_t capacity = scatterCapacity(layer, cellSize);
+
+    std::vector<ScatterPoint> serial(cells * capacity), parallel(cells * capacity);
+    std::vector<size_t> serialCounts(cells), parallelCounts(cells);
+    auto scatterAll = [&](ThreadPool* pool, std::vector<ScatterPoint>& points,
+                          std::vector<size_t>& counts)
+    {
+        parallelFor(pool, cells,
+                    [&](size_t i)
+                    {
+                        glm::ivec2 cell(static_cast<int>(i % cellsPerSide),
+                                        static_cast<int>(i / cellsPerSide));
+                        counts[i] = scatterCell(1234, layer, cell, cellSize, &points[i * capacity]);
+                    });
+    };
+
+    ThreadPool pool;
+    double serialMs = timeMs([&] { scatterAll(nullptr, serial, serialCounts); });
+    double parallelMs = timeMs([&] { scatterAll(&pool, parallel, parallelCounts); });
+    bool identical = serialCounts == parallelCounts &&
+                     std::memcmp(serial.data(), parallel.data(),
+                                 serial.size() * sizeof(ScatterPoint)) == 0;
+
+    std::cout << fmt::format("scatter {:>6} cells  {:>9} points  serial {:8.3f} ms  "
+                             "{} threads {:8.3f} ms  {:5.2f}x  {}\n",
+                             cells, cells * capacity, serialMs, pool.getThreadCount() + 1,
+                             parallelMs, serialMs / parallelMs,
+                             identical ? "identical" : "MISMATCH");
+}
+
+// Many entities sampling the ground each frame, from the noise and from resident chunk heights,
+// plus camera style raycasts
+static void benchTerrainQuery(size_t pointCount)
+{
+    TerrainSettings settings;
+    auto generator = std::make_shared<TerrainGenerator>(settings);
+    TerrainQuery noise(settings, generator);
+    TerrainQuery cached(settings, generator);
+
+    // Cache the chunks the points land in, sampled where the chunk builder samples
+    const int grid = settings.chunkResolution + 1;
+    const float spacing = settings.chunkSize / settings.chunkResolution;
+    for (int cz = -2; cz < 2; ++cz)
+    {
+        for (int cx = -2; cx < 2; ++cx)
+        {
+            glm::vec2 origin = glm::vec2(cx, cz) * settings.chunkSize;
+            auto heights = std::make_shared<std::vector<float>>(grid * grid);
+            for (int z = 0; z < grid; ++z)
+            {
+                for (int x = 0; x < grid; ++x)
+                {
+                    (*heights)[z * grid + x] =
+                        generator->sample(origin.x + x * spacing, origin.y + z * spacing);
+                }
+            }
+            cached.insertChunk(glm::ivec2(cx, cz), heights);
+        }
+    }
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> coord(-2.0f * settings.chunkSize,
+                                                2.0f * settings.chunkSize - 0.01f);
+    std::vector<glm::vec2> points(pointCount);
+    for (auto& point : points)
+        point = glm::vec2(coord(rng), coord(rng));
+    // Entities cluster, sorting roughly by chunk is what a batch from one system looks like
+    std::sort(points.begin(), points.end(),
+              [&](const glm::vec2& a, const glm::vec2& b)
+              {
+                  int chunkA = static_cast<int>(std::floor(a.y / settings.chunkSize)) * 8 +
+                               static_cast<int>(std::floor(a.x / settings.chunkSize));
+                  int chunkB = static_cast<int>(std::floor(b.y / settings.chunkSize)) * 8 +
+                               static_cast<int>(std::floor(b.x / settings.chunkSize));
+                  return chunkA < chunkB;
+              });
+
+    std::vector<float> fromNoise(pointCount), fromCache(pointCount);
+    double noiseMs = timeMs([&] { noise.heights(points.data(), pointCount, fromNoise.data()); });
+    double cachedMs =
+        timeMs([&] { cached.heights(points.data(), pointCount, fromCache.data()); });
+    bool identical = fromNoise == fromCache;
+
+    const size_t rayCount = 1000;
+    std::vector<glm::vec3> starts(rayCount), ends(rayCount);
+    for (size_t i = 0; i < rayCount; ++i)
+    {
+        // Player to camera distances, from just above the ground
+        glm::vec2 from(coord(rng) * 0.8f, coord(rng) * 0.8f);
+        starts[i] = glm::vec3(from.x, cached.height(from.x, from.y) + 1.0f, from.y);
+        ends[i] = starts[i] + glm::vec3(coord(rng), coord(rng), coord(rng)) * 0.15f;
+    }
+    size_t hits = 0;
+    double rayMs = timeMs(
+        [&]
+        {
+            hits = 0;
+            TerrainHit hit;
+            for (size_t i = 0; i < rayCount; ++i)
+                hits += cached.raycast(starts[i], ends[i], hit) ? 1 : 0;
+        });
+
+    std::cout << fmt::format("terrain {:>8} heights  noise {:8.3f} ms  cached {:8.3f} ms "
+                             "({:5.1f} ns each)  {}\n",
+                             pointCount, noiseMs, cachedMs, cachedMs * 1e6 / pointCount,
+                             identical ? "identical" : "MISMATCH");
+    std::cout << fmt::format("terrain {:>8} raycasts {:8.3f} ms ({:5.2f} us each)  {} hits\n",
+                             rayCount, rayMs, rayMs * 1e3 / rayCount, hits);
+}
+
+// The lookup main.cpp used before clips were compiled: scan every channel's keys from the start
+static void sampleClipLinearScan(const AnimationClip& clip, float time, glm::vec4* out)
+{
+    for (size_t c = 0; c < clip.channels.size(); ++c)
+    {
+        const AnimChannel& channel = clip.channels[c];
+        const float* times = clip.times.data() + channel.firstKey;
+        const glm::vec4* values = clip.values.data() + channel.firstValue;
+        uint32_t k = 0;
+        for (uint32_t i = 0; i + 1 < channel.keyCount; ++i)
+        {
+            if (time >= times[i] && time <= times[i + 1])
+            {
+                k = i;
+                break;
+            }
+        }
+        float u = (time - times[k]) / (times[k + 1] - times[k]);
+        out[c] = glm::mix(values[k], values[k + 1], glm::clamp(u, 0.0f, 1.0f));
+    }
+}
+
+// A crowd's worth of clips sampled once per 60 Hz frame, each at its own phase
+static void benchAnimation(size_t clipCount)
+{
+    const int joints = 24;
+    const int keys = 61; // 2 s at 30 fps
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    std::vector<AnimationClip> clips(clipCount);
+    for (auto& clip : clips)
+    {
+        clip.duration = 2.0f;
+        for (int j = 0; j < joints; ++j)
+        {
+            for (AnimTarget target : { AnimTarget::Translation, AnimTarget::Rotation,
+                                       AnimTarget::Scale })
+            {
+                AnimChannel channel{ j, target, AnimInterpolation::Linear,
+                                     static_cast<uint32_t>(clip.times.size()), keys,
+                                     static_cast<uint32_t>(clip.values.size()) };
+                for (int k = 0; k < keys; ++k)
+                {
+                    clip.times.push_back(k / 30.0f);
+                    glm::vec4 value(unit(rng), unit(rng), unit(rng), unit(rng));
+                    clip.values.push_back(target == AnimTarget::Rotation ? glm::normalize(value)
+                                                                         : value);
+                }
+                clip.channels.push_back(channel);
+            }
+        }
+    }
+
+    const size_t channels = clips[0].channels.size();
+    std::vector<glm::vec4> out(clipCount * channels), check(clipCount * channels);
+    std::vector<AnimationCursor> cursors(clipCount);
+    auto phase = [&](size_t i, float time) { return std::fmod(time + i * 0.37f, 2.0f); };
+
+    float time = 0.0f;
+    double scanMs = timeMs(
+        [&]
+        {
+            time += 1.0f / 60.0f;
+            for (size_t i = 0; i < clipCount; ++i)
+                sampleClipLinearScan(clips[i], phase(i, time), &out[i * channels]);
+        });
+    double searchMs = timeMs(
+        [&]
+        {
+            time += 1.0f / 60.0f;
+            for (size_t i = 0; i < clipCount; ++i)
+                sampleClip(clips[i], phase(i, time), nullptr, &out[i * channels]);
+        });
+    double cursorMs = timeMs(
+        [&]
+        {
+            time += 1.0f / 60.0f;
+            for (size_t i = 0; i < clipCount; ++i)
+                sampleClip(clips[i], phase(i, time), &cursors[i], &out[i * channels]);
+        });
+
+    // Cursors only change how the key is found, never the value
+    for (size_t i = 0; i < clipCount; ++i)
+        sampleClip(clips[i], phase(i, time), nullptr, &check[i * channels]);
+    bool identical = std::memcmp(out.data(), check.data(), out.size() * sizeof(glm::vec4)) == 0;
+
+    std::cout << fmt::format("animation {:>5} clips x {} channels  linear scan {:7.3f} ms  "
+                             "binary search {:7.3f} ms  cursor {:7.3f} ms  {}\n",
+                             clipCount, channels, scanMs, searchMs, cursorMs,
+                             identical ? "identical" : "MISMATCH");
+}
+
+// Compresses a character's clips and compares memory, error and sampling time with the source
+static void benchAnimationCompression(const std::string& path)
+{
+    tinygltf::Model model;
+    tinygltf::TinyGLTF loader;
+    std::string err, warn;
+    if (!loader.LoadBinaryFromFile(&model, &err, &warn, path))
+    {
+        std::cout << "anim_compression skipped, can't load " << path << "\n";
+        return;
+    }
+
+    std::vector<AnimationClip> clips = compileAnimationClips(model);
+    std::vector<CompressedClip> compressed;
+    AnimCompressionReport total;
+    for (const AnimationClip& clip : clips)
+    {
+        AnimCompressionReport report;
+        compressed.push_back(compressClip(clip, AnimCompressionSettings(), &report));
+        std::cout << fmt::format("anim_compression {:<32} keys {:>5} -> {:>5}  {:>7} B -> {:>6} B "
+                                 " max error {:.3f} mm {:.4f} deg {:.5f} scale\n",
+                                 clip.name, report.rawKeys, report.compressedKeys,
+                                 report.rawBytes, report.compressedBytes,
+                                 report.maxTranslationError * 1000.0f,
+                                 glm::degrees(report.maxRotationError), report.maxScaleError);
+        total.rawKeys += report.rawKeys;
+        total.compressedKeys += report.compressedKeys;
+        total.rawBytes += report.rawBytes;
+        total.compressedBytes += report.compressedBytes;
+        total.maxTranslationError = std::max(total.maxTranslationError, report.maxTranslationError);
+        total.maxRotationError = std::max(total.maxRotationError, report.maxRotationError);
+        total.maxScaleError = std::max(total.maxScaleError, report.maxScaleError);
+    }
+
+    // Every clip once per call, as a crowd playing the whole library would
+    size_t channels = 0;
+    for (const AnimationClip& clip : clips)
+        channels = std::max(channels, clip.channels.size());
+    std::vector<glm::vec4> out(channels);
+    std::vector<AnimationCursor> rawCursors(clips.size()), compressedCursors(clips.size());
+    float time = 0.0f;
+    double rawMs = timeMs(
+        [&]
+        {
+            time += 1.0f / 60.0f;
+            for (size_t i = 0; i < clips.size(); ++i)
+                sampleClip(clips[i], std::fmod(time, clips[i].duration), &rawCursors[i],
+                           out.data());
+        });
+    double compressedMs = timeMs(
+        [&]
+        {
+            time += 1.0f / 60.0f;
+            for (size_t i = 0; i < compressed.size(); ++i)
+                sampleCompressedClip(compressed[i], std::fmod(time, compressed[i].duration),
+                                     &compressedCursors[i], out.data());
+        });
+
+    std::cout << fmt::format("anim_compression {} clips  keys {} -> {}  {:.1f} KB -> {:.1f} KB "
+                             "({:.1f}x)  max error {:.3f} mm {:.4f} deg {:.5f} scale\n",
+                             clips.size(), total.rawKeys, total.compressedKeys,
+                             total.rawBytes / 1024.0, total.compressedBytes / 1024.0,
+                             double(total.rawBytes) / std::max<size_t>(total.compressedBytes, 1),
+                             total.maxTranslationError * 1000.0f,
+                             glm::degrees(total.maxRotationError), total.maxScaleError);
+    std::cout << fmt::format("anim_compression sample all clips  source {:7.3f} ms  "
+                             "compressed {:7.3f} ms\n",
+                             rawMs, compressedMs);
+}
+
+// Loading a character from its source against mapping its cooked file, and whether the cooked
+// clips sample the same as ones compressed at load time
+static void benchCookedLoad(const std::string& path)
+{
+    CookedModel cooked;
+    if (!loadCookedModel(path, cooked))
+    {
+        std::cout << "cooked_load skipped, can't load " << path << "\n";
+        return;
+    }
+
+    std::vector<CompressedClip> reference;
+    double sourceMs = timeMs(
+        [&]
+        {
+            tinygltf::Model model;
+            tinygltf::TinyGLTF loader;
+            std::string err, warn;
+            loader.LoadBinaryFromFile(&model, &err, &warn, path);
+            TransformHierarchy hierarchy;
+            hierarchy.build(model);
+            reference.clear();
+            for (const AnimationClip& clip : compileAnimationClips(model))
+                reference.push_back(compressClip(clip, AnimCompressionSettings()));
+        });
+    // What main and the crowd do before uploading: map, copy out the skin and clips, build nodes
+    std::vector<CompressedClip> clips;
+    double cookedMs = timeMs(
+        [&]
+        {
+            CookedModel model;
+            model.open(std::filesystem::path(path).replace_extension(".cooked").string());
+            TransformHierarchy hierarchy;
+            hierarchy.build(model.getNodes(), model.getNodeCount());
+            Skin skin = model.getSkin();
+            clips = model.getClips();
+        });
+
+    bool identical = clips.size() == reference.size();
+    std::vector<glm::vec4> a, b;
+    for (size_t i = 0; identical && i < clips.size(); ++i)
+    {
+        a.resize(clips[i].channels.size());
+        b.resize(reference[i].channels.size());
+        identical = a.size() == b.size() && clips[i].name == reference[i].name;
+        for (float t = 0.0f; identical && t <= clips[i].duration; t += 0.05f)
+        {
+            sampleCompressedClip(clips[i], t, nullptr, a.data());
+            sampleCompressedClip(reference[i], t, nullptr, b.data());
+            identical = std::memcmp(a.data(), b.data(), a.size() * sizeof(glm::vec4)) == 0;
+        }
+    }
+
+    std::cout << fmt::format("cooked_load {}  {:.1f} KB, {} vertices, {} indices, {} clips  "
+                             "source {:8.3f} ms  cooked {:7.3f} ms  {}\n",
+                             path, cooked.getFileSize() / 1024.0, cooked.getVertexCount(),
+                             cooked.getIndexCount(), clips.size(), sourceMs, cookedMs,
+                             identical ? "identical" : "MISMATCH");
+}
+
+// Simplifying every environment model into its LODs, as the streamer's workers do
+static void benchMeshLod(const std::string& directory)
+{
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(directory))
+    {
+        if (entry.path().extension() == ".gltf")
+            paths.push_back(entry.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+
+    size_t triangles[MAX_MESH_LODS] = {};
+    size_t meshes[MAX_MESH_LODS] = {};
+    double totalMs = 0.0;
+    float worstError = 0.0f; // Relative to the mesh's bounding radius
+    for (const std::string& path : paths)
+    {
+        tinygltf::Model model;
+        tinygltf::TinyGLTF loader;
+        std::string err, warn;
+        if (!loader.LoadASCIIFromFile(&model, &err, &warn, path))
+            continue;
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> sourceIndices;
+        std::vector<CookedPart> parts;
+        std::vector<int32_t> attachments;
+        cookGeometry(model, 0, vertices, sourceIndices, parts, attachments);
+
+        std::vector<uint32_t> indices;
+        std::vector<MeshLod> lods;
+        totalMs += timeMs(
+            [&]
+            {
+                indices = sourceIndices;
+                lods = buildMeshLods(vertices, indices);
+            });
+        glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+        for (const MeshVertex& vertex : vertices)
+        {
+            glm::vec3 position(vertex.position[0], vertex.position[1], vertex.position[2]);
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+        }
+        float radius = std::max(glm::length(boundsMax - boundsMin) * 0.5f, 1e-6f);
+        for (size_t i = 0; i < lods.size(); ++i)
+        {
+            triangles[i] += lods[i].indexCount / 3;
+            meshes[i]++;
+            worstError = std::max(worstError, lods[i].error / radius);
+        }
+    }
+
+    std::cout << fmt::format("mesh_lod {} models  {:.2f} ms each  worst error {:.3f} of radius\n",
+                             paths.size(), totalMs / std::max<size_t>(paths.size(), 1),
+                             worstError);
+    for (int i = 0; i < MAX_MESH_LODS; ++i)
+    {
+        std::cout << fmt::format("  lod {}  {:3} models  {:6} triangles\n", i, meshes[i],
+                                 triangles[i]);
+    }
+}
+
+// Every .gltf and .glb under directory, sorted
+static std::vector<std::string> findModels(const std::string& directory)
+{
+    std::vector<std::string> paths;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(directory))
+    {
+        std::string extension = entry.path().extension().string();
+        if (extension == ".gltf" || extension == ".glb")
+            paths.push_back(entry.path().string());
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+static bool loadModel(const std::string& path, tinygltf::Model& model)
+{
+    tinygltf::TinyGLTF loader;
+    std::string err, warn;
+    if (std::filesystem::path(path).extension() == ".glb")
+        return loader.LoadBinaryFromFile(&model, &err, &warn, path);
+    return loader.LoadASCIIFromFile(&model, &err, &warn, path);
+}
+
+// Post-transform cache behaviour of every glTF model under directory as authored and after the
+// pipeline's optimization, on the same FIFO cache
+static void benchMeshOptimize(const std::string& directory)
+{
+    std::vector<std::string> paths = findModels(directory);
+    size_t triangles = 0;
+    size_t transformedBefore = 0, transformedAfter = 0;
+    size_t uniqueVertices = 0;
+    double totalMs = 0.0;
+    std::cout << fmt::format("mesh_opt {:<52} {:>6} {:>6}  {:>13}  {:>13}\n", "", "tris",
+                             "verts", "ACMR", "ATVR");
+    for (const std::string& path : paths)
+    {
+        tinygltf::Model model;
+        if (!loadModel(path, model))
+            continue;
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<CookedPart> parts;
+        std::vector<int32_t> attachments;
+        cookGeometry(model, 0, vertices, indices, parts, attachments);
+        if (indices.empty())
+            continue;
+        VertexCacheStats before =
+            analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+        std::vector<MeshVertex> optimizedVertices;
+        std::vector<uint32_t> optimizedIndices;
+        totalMs += timeMs(
+            [&]
+            {
+                optimizedVertices = vertices;
+                optimizedIndices = indices;
+                std::vector<CookedPart> optimizedParts = parts;
+                optimizeParts(optimizedVertices, optimizedIndices, optimizedParts);
+            });
+        VertexCacheStats after = analyzeVertexCache(
+            optimizedIndices.data(), optimizedIndices.size(), optimizedVertices.size());
+
+        std::string name = std::filesystem::relative(path, directory).string();
+        std::cout << fmt::format("mesh_opt {:<52} {:6} {:6}  {:5.3f} -> {:5.3f}  {:5.3f} -> "
+                                 "{:5.3f}\n",
+                                 name, indices.size() / 3, optimizedVertices.size(), before.acmr,
+                                 after.acmr, before.atvr, after.atvr);
+        triangles += indices.size() / 3;
+        transformedBefore += before.transformed;
+        transformedAfter += after.transformed;
+        uniqueVertices += optimizedVertices.size();
+    }
+    if (triangles == 0)
+        return;
+    std::cout << fmt::format("mesh_opt {} models, {} triangles  ACMR {:.3f} -> {:.3f}  ATVR "
+                             "{:.3f} -> {:.3f}  {:.2f} ms each\n",
+                             paths.size(), triangles, double(transformedBefore) / triangles,
+                             double(transformedAfter) / triangles,
+                             double(transformedBefore) / uniqueVertices,
+                             double(transformedAfter) / uniqueVertices,
+                             totalMs / paths.size());
+}
+
+// Vertex memory of every glTF model under directory as full floats and packed the way the pool
+// and cooked files hold it, skinned for models with a skin and static otherwise, with the worst
+// error the packing adds
+static void benchVertexFormat(const std::string& directory)
+{
+    std::vector<std::string> paths = findModels(directory);
+    size_t floatBytes[2] = {};
+    size_t packedBytes[2] = {};
+    float worstPosition = 0.0f; // Relative to the bounds' diagonal
+    float worstNormal = 0.0f;   // Degrees
+    float worstTangent = 0.0f;
+    float worstTexcoord = 0.0f;
+    float worstWeight = 0.0f;
+    double totalMs = 0.0;
+    std::cout << fmt::format("vertex_format {:<47} {:>6} {:>8} {:>8}\n", "", "verts", "float",
+                             "packed");
+    for (const std::string& path : paths)
+    {
+        tinygltf::Model model;
+        if (!loadModel(path, model))
+            continue;
+        std::vector<Skin> skins = loadSkins(model);
+        size_t jointCount = skins.empty() ? 0 : skins[0].joints.size();
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<CookedPart> parts;
+        std::vector<int32_t> attachments;
+        cookGeometry(model, jointCount, vertices, indices, parts, attachments);
+        if (vertices.empty())
+            continue;
+
+        // Both formats lead with the same fields, the skinned one's decode covers the static one
+        bool skinned = jointCount > 0;
+        VertexQuantization quantization;
+        std::vector<SkinnedVertex> packed(vertices.size());
+        std::vector<StaticVertex> packedStatic(vertices.size());
+        totalMs += timeMs(
+            [&]
+            {
+                quantization = computeQuantization(vertices.data(), vertices.size());
+                if (skinned)
+                    packVertices(vertices.data(), vertices.size(), quantization, packed.data());
+                else
+                {
+                    packVertices(vertices.data(), vertices.size(), quantization,
+                                 packedStatic.data());
+                }
+            });
+        if (!skinned)
+            packVertices(vertices.data(), vertices.size(), quantization, packed.data());
+
+        float diagonal = std::max(glm::length(quantization.scale), 1e-12f);
+        auto angle = [](const float* a, const float* b)
+        {
+            float cosine = glm::dot(glm::normalize(glm::vec3(a[0], a[1], a[2])),
+                                    glm::normalize(glm::vec3(b[0], b[1], b[2])));
+            return glm::degrees(std::acos(std::clamp(cosine, -1.0f, 1.0f)));
+        };
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            const MeshVertex& source = vertices[i];
+            const SkinnedVertex& vertex = packed[i];
+            glm::vec3 position = unpackPosition(vertex.position, quantization);
+            glm::vec3 original(source.position[0], source.position[1], source.position[2]);
+            worstPosition = std::max(worstPosition, glm::length(position - original) / diagonal);
+            float normal[3], tangent[3];
+            unpackOctahedral(vertex.normal, normal);
+            unpackOctahedral(vertex.tangent, tangent);
+            worstNormal = std::max(worstNormal, angle(normal, source.normal));
+            worstTangent = std::max(worstTangent, angle(tangent, source.tangent));
+            for (int c = 0; c < 2; ++c)
+            {
+                float error = std::fabs(halfToFloat(vertex.texcoord[c]) - source.texcoord[c]);
+                worstTexcoord = std::max(worstTexcoord, error);
+            }
+            for (int j = 0; skinned && j < 4; ++j)
+            {
+                float error = std::fabs(unpackUnorm8(vertex.weights[j]) - source.weights[j]);
+                worstWeight = std::max(worstWeight, error);
+            }
+        }
+
+        // Static meshes as floats wouldn't carry joints and weights either
+        size_t floatSize = skinned ? sizeof(MeshVertex) : offsetof(MeshVertex, joints);
+        size_t full = vertices.size() * floatSize;
+        size_t small = vertices.size() * getVertexSize(skinned ? VertexFormat::Skinned
+                                                               : VertexFormat::Static);
+        floatBytes[skinned] += full;
+        packedBytes[skinned] += small;
+        std::string name = std::filesystem::relative(path, directory).string();
+        std::cout << fmt::format("vertex_format {:<47} {:6} {:8} {:8}\n", name, vertices.size(),
+                                 full, small);
+    }
+    const char* kinds[2] = { "static", "skinned" };
+    for (int skinned = 0; skinned < 2; ++skinned)
+    {
+        if (floatBytes[skinned] == 0)
+            continue;
+        double saved = 1.0 - double(packedBytes[skinned]) / floatBytes[skinned];
+        std::cout << fmt::format("vertex_format {:<7} {:.1f} KB as floats -> {:.1f} KB packed, "
+                                 "{:.0f}% smaller\n",
+                                 kinds[skinned], floatBytes[skinned] / 1024.0,
+                                 packedBytes[skinned] / 1024.0, 100.0 * saved);
+    }
+    std::cout << fmt::format("vertex_format worst error: position {:.2e} of the diagonal, normal "
+                             "{:.4f} deg, tangent {:.4f} deg, texcoord {:.2e}, weight {:.4f}\n",
+                             worstPosition, worstNormal, worstTangent, worstTexcoord, worstWeight);
+    std::cout << fmt::format("vertex_format {:.3f} ms packing per model\n",
+                             totalMs / std::max<size_t>(paths.size(), 1));
+}
+
+int runBenchmarks(const std::vector<std::string>& names)
+{
+    auto wanted = [&](const std::string& name)
+    { return names.empty() || std::find(names.begin(), names.end(), name) != names.end(); };
+
+    if (wanted("grass_cull"))
+    {
+        benchGrassCull(160000);
+        benchGrassCull(2000000);
+    }
+    if (wanted("scatter"))
+    {
+        benchScatter(16);
+        benchScatter(64);
+    }
+    if (wanted("terrain"))
+        benchTerrainQuery(100000);
+    if (wanted("animation"))
+    {
+        benchAnimation(100);
+        benchAnimation(500);
+    }
+    if (wanted("anim_compression"))
+        benchAnimationCompression("Assets/Characters/gltf/Knight.glb");
+    if (wanted("cooked_load"))
+        benchCookedLoad("Assets/Characters/gltf/Knight.glb");
+    if (wanted("mesh_lod"))
+        benchMeshLod("Assets/Environment/gltf");
+    if (wanted("mesh_opt"))
+        benchMeshOptimize("Assets");
+    if (wanted("vertex_format"))
+        benchVertexFormat("Assets");
+    return 0;
+}
@@ -52,6 +52,14 @@ void Camera::updatePosition(glm::vec3 newTarget)
     updateCameraVectors();
 }
 
+void Camera::setPosition(glm::vec3 newPosition)
+{
+    position = newPosition;
+    front = glm::normalize(target - position);
+    right = glm::normalize(glm::cross(front, worldUp));
+    up = glm::normalize(glm::cross(right, front));
+}
+
 void Camera::updateCameraVectors()
 {
     float horizontalDistance = distance * cos(glm::radians(pitch));
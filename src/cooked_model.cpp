@@ -0,0 +1,784 @@
+#include "cooked_model.h"
+#include "gltf_accessor.h"
+#include "mesh_optimize.h"
+#include "tiny_gltf.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <glm/gtc/type_ptr.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Appends the elements 16 byte aligned and points range at them
+template <typename T>
+static void appendSection(std::vector<uint8_t>& blob, CookedRange& range, const T* data,
+                          size_t count)
+{
+    blob.resize((blob.size() + 15) & ~size_t(15), 0);
+    range.offset = blob.size();
+    range.count = count;
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    blob.insert(blob.end(), bytes, bytes + count * sizeof(T));
+}
+
+template <typename T>
+static void appendSection(std::vector<uint8_t>& blob, CookedRange& range,
+                          const std::vector<T>& data)
+{
+    appendSection(blob, range, data.data(), data.size());
+}
+
+// Area weighted face normals summed at each vertex, so vertices split along hard edges stay hard.
+// indices count from firstVertex, which vertices starts at.
+static void generateNormals(MeshVertex* vertices, size_t vertexCount, const uint32_t* indices,
+                            size_t indexCount, uint32_t firstVertex)
+{
+    std::vector<glm::vec3> normals(vertexCount, glm::vec3(0.0f));
+    auto position = [&](uint32_t v) { return glm::make_vec3(vertices[v].position); };
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        uint32_t a = indices[i] - firstVertex;
+        uint32_t b = indices[i + 1] - firstVertex;
+        uint32_t c = indices[i + 2] - firstVertex;
+        glm::vec3 normal = glm::cross(position(b) - position(a), position(c) - position(a));
+        normals[a] += normal;
+        normals[b] += normal;
+        normals[c] += normal;
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        float length = glm::length(normals[v]);
+        glm::vec3 normal = length > 0.0f ? normals[v] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        std::copy_n(&normal[0], 3, vertices[v].normal);
+    }
+}
+
+// Tangents along increasing u, summed over each vertex's triangles and made perpendicular to its
+// normal (Lengyel). w says whether increasing v runs along normal x tangent or against it, which
+// flips on mirrored UVs. Vertices without usable texcoords get any tangent.
+static void generateTangents(MeshVertex* vertices, size_t vertexCount, const uint32_t* indices,
+                             size_t indexCount, uint32_t firstVertex)
+{
+    std::vector<glm::vec3> tangents(vertexCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> bitangents(vertexCount, glm::vec3(0.0f));
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        const MeshVertex* corner[3];
+        for (int c = 0; c < 3; ++c)
+            corner[c] = &vertices[indices[i + c] - firstVertex];
+        glm::vec3 p0 = glm::make_vec3(corner[0]->position);
+        glm::vec3 edge1 = glm::make_vec3(corner[1]->position) - p0;
+        glm::vec3 edge2 = glm::make_vec3(corner[2]->position) - p0;
+        glm::vec2 uv0 = glm::make_vec2(corner[0]->texcoord);
+        glm::vec2 step1 = glm::make_vec2(corner[1]->texcoord) - uv0;
+        glm::vec2 step2 = glm::make_vec2(corner[2]->texcoord) - uv0;
+        float determinant = step1.x * step2.y - step2.x * step1.y;
+        if (std::fabs(determinant) < 1e-12f)
+            continue;
+        glm::vec3 tangent = (edge1 * step2.y - edge2 * step1.y) / determinant;
+        glm::vec3 bitangent = (edge2 * step1.x - edge1 * step2.x) / determinant;
+        for (int c = 0; c < 3; ++c)
+        {
+            tangents[indices[i + c] - firstVertex] += tangent;
+            bitangents[indices[i + c] - firstVertex] += bitangent;
+        }
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        glm::vec3 normal = glm::make_vec3(vertices[v].normal);
+        glm::vec3 tangent = tangents[v] - normal * glm::dot(normal, tangents[v]);
+        float length = glm::length(tangent);
+        if (length < 1e-12f)
+        {
+            // Anything perpendicular to the normal
+            glm::vec3 axis = std::fabs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f)
+                                                        : glm::vec3(0.0f, 1.0f, 0.0f);
+            tangent = glm::cross(axis, normal);
+            length = glm::length(tangent);
+        }
+        tangent /= length;
+        std::copy_n(&tangent[0], 3, vertices[v].tangent);
+        bool mirrored = glm::dot(glm::cross(normal, tangent), bitangents[v]) < 0.0f;
+        vertices[v].tangent[3] = mirrored ? -1.0f : 1.0f;
+    }
+}
+
+void cookGeometry(const tinygltf::Model& model, size_t skinJointCount,
+                  std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices,
+                  std::vector<CookedPart>& parts, std::vector<int32_t>& attachments)
+{
+    std::vector<uint32_t> jointData;
+    for (size_t nodeIndex = 0; nodeIndex < model.nodes.size(); ++nodeIndex)
+    {
+        const tinygltf::Node& node = model.nodes[nodeIndex];
+        if (node.mesh < 0)
+            continue;
+        int attachment = -1;
+
+        for (const auto& primitive : model.meshes[node.mesh].primitives)
+        {
+            auto posIt = primitive.attributes.find("POSITION");
+            auto texIt = primitive.attributes.find("TEXCOORD_0");
+            if (posIt == primitive.attributes.end() || texIt == primitive.attributes.end() ||
+                (primitive.mode != -1 && primitive.mode != TINYGLTF_MODE_TRIANGLES))
+            {
+                std::cerr << "Skipping primitive with missing attributes" << std::endl;
+                continue;
+            }
+
+            // Views onto the buffers, converted straight into the vertices below
+            AccessorView positions(model, posIt->second);
+            AccessorView texcoords(model, texIt->second);
+            AccessorView primitiveIndices(model, primitive.indices);
+            size_t count = positions.getCount();
+            if (!positions.isValid() || texcoords.getCount() != count ||
+                (primitive.indices >= 0 && !primitiveIndices.isValid()))
+            {
+                std::cerr << "Skipping primitive with unreadable attributes" << std::endl;
+                continue;
+            }
+            // Tangents are only meaningful against the normals they came with
+            auto normalIt = primitive.attributes.find("NORMAL");
+            auto tangentIt = primitive.attributes.find("TANGENT");
+            AccessorView normals;
+            AccessorView tangents;
+            if (normalIt != primitive.attributes.end())
+                normals = AccessorView(model, normalIt->second);
+            if (tangentIt != primitive.attributes.end())
+                tangents = AccessorView(model, tangentIt->second);
+            bool hasNormals = normals.getCount() == count;
+            bool hasTangents = hasNormals && tangents.getCount() == count;
+            auto jointIt = primitive.attributes.find("JOINTS_0");
+            auto weightIt = primitive.attributes.find("WEIGHTS_0");
+            AccessorView joints;
+            AccessorView weights;
+            if (node.skin >= 0 && skinJointCount > 0 && jointIt != primitive.attributes.end() &&
+                weightIt != primitive.attributes.end())
+            {
+                joints = AccessorView(model, jointIt->second);
+                weights = AccessorView(model, weightIt->second);
+            }
+            bool skinned = joints.getCount() == count && weights.getCount() == count;
+            if (!skinned && attachment < 0)
+            {
+                if (skinJointCount + attachments.size() >= MAX_JOINTS)
+                {
+                    std::cerr << "Skipping mesh, the palette is full" << std::endl;
+                    break;
+                }
+                attachment = static_cast<int>(skinJointCount + attachments.size());
+                attachments.push_back(static_cast<int32_t>(nodeIndex));
+            }
+
+            CookedPart part;
+            part.firstVertex = static_cast<uint32_t>(vertices.size());
+            part.vertexCount = static_cast<uint32_t>(count);
+            part.firstIndex = static_cast<uint32_t>(indices.size());
+            part.texture = findBaseColorImage(model, primitive.material);
+            vertices.resize(vertices.size() + count);
+            MeshVertex* out = vertices.data() + part.firstVertex;
+            positions.readFloats(out->position, 3, sizeof(MeshVertex));
+            texcoords.readFloats(out->texcoord, 2, sizeof(MeshVertex));
+            if (hasNormals)
+                normals.readFloats(out->normal, 3, sizeof(MeshVertex));
+            if (hasTangents)
+                tangents.readFloats(out->tangent, 4, sizeof(MeshVertex));
+            if (skinned)
+            {
+                weights.readFloats(out->weights, 4, sizeof(MeshVertex));
+                jointData.resize(count * 4);
+                joints.readUints(jointData.data(), 4, 4 * sizeof(uint32_t));
+            }
+            for (size_t i = 0; i < count; ++i)
+            {
+                MeshVertex& vertex = out[i];
+                std::fill_n(vertex.joints, 4, 0);
+                if (!skinned)
+                {
+                    vertex.joints[0] = static_cast<uint16_t>(attachment);
+                    vertex.weights[0] = 1.0f;
+                    std::fill_n(vertex.weights + 1, 3, 0.0f);
+                    continue;
+                }
+
+                // Weights should already sum to one, exporters don't always manage. Joints the
+                // skin was cut short of lose theirs, past them sit the attachments.
+                float sum = 0.0f;
+                for (int j = 0; j < 4; ++j)
+                {
+                    if (jointData[i * 4 + j] < skinJointCount)
+                        vertex.joints[j] = static_cast<uint16_t>(jointData[i * 4 + j]);
+                    else
+                        vertex.weights[j] = 0.0f;
+                    sum += vertex.weights[j];
+                }
+                for (int j = 0; j < 4; ++j)
+                    vertex.weights[j] = sum > 0.0f ? vertex.weights[j] / sum : 0.0f;
+            }
+
+            // Indices, or one per vertex when the primitive has none. Out of range ones are
+            // clamped rather than trusted.
+            if (primitive.indices >= 0)
+            {
+                indices.resize(indices.size() + primitiveIndices.getCount());
+                primitiveIndices.readUints(indices.data() + part.firstIndex, 1, sizeof(uint32_t));
+                uint32_t last = static_cast<uint32_t>(count - 1);
+                for (size_t i = part.firstIndex; i < indices.size(); ++i)
+                    indices[i] = part.firstVertex + std::min(indices[i], last);
+            }
+            else
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                    indices.push_back(part.firstVertex + i);
+            }
+            part.indexCount = static_cast<uint32_t>(indices.size()) - part.firstIndex;
+            if (!hasNormals)
+            {
+                generateNormals(out, count, indices.data() + part.firstIndex, part.indexCount,
+                                part.firstVertex);
+            }
+            if (!hasTangents)
+            {
+                generateTangents(out, count, indices.data() + part.firstIndex, part.indexCount,
+                                 part.firstVertex);
+            }
+            parts.push_back(part);
+        }
+    }
+}
+
+void optimizeParts(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices,
+                   std::vector<CookedPart>& parts)
+{
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (const CookedPart& part : parts)
+        ranges.emplace_back(part.firstIndex, part.firstIndex + part.indexCount);
+    optimizeMesh(vertices, indices, ranges);
+
+    // Parts don't share vertices, so each one's are still together, in first use order
+    for (CookedPart& part : parts)
+    {
+        if (part.indexCount == 0)
+        {
+            part.vertexCount = 0;
+            continue;
+        }
+        auto [low, high] = std::minmax_element(indices.begin() + part.firstIndex,
+                                               indices.begin() + part.firstIndex + part.indexCount);
+        part.firstVertex = *low;
+        part.vertexCount = *high - *low + 1;
+    }
+}
+
+bool cookTexture(const tinygltf::Image& image, CookedTexture& texture,
+                 std::vector<CookedMip>& mips, std::vector<uint8_t>& pixels)
+{
+    if (image.width <= 0 || image.height <= 0 || image.component < 1 || image.component > 4 ||
+        (image.bits != 8 && image.bits != 16))
+        return false;
+    size_t bytesPerComponent = image.bits / 8;
+    size_t texelCount = static_cast<size_t>(image.width) * image.height;
+    if (image.image.size() < texelCount * image.component * bytesPerComponent)
+        return false;
+
+    // Grey fills RGB, missing alpha is opaque. 16 bit data keeps its high byte.
+    std::vector<uint8_t> level(texelCount * 4);
+    for (size_t i = 0; i < texelCount; ++i)
+    {
+        uint8_t source[4] = { 0, 0, 0, 255 };
+        for (int c = 0; c < image.component; ++c)
+            source[c] = image.image[((i * image.component) + c + 1) * bytesPerComponent - 1];
+        bool grey = image.component <= 2;
+        level[i * 4 + 0] = source[0];
+        level[i * 4 + 1] = grey ? source[0] : source[1];
+        level[i * 4 + 2] = grey ? source[0] : source[2];
+        level[i * 4 + 3] = image.component == 2 ? source[1] : source[3];
+    }
+
+    texture.width = static_cast<uint32_t>(image.width);
+    texture.height = static_cast<uint32_t>(image.height);
+    texture.hash = hashTexture(texture.width, texture.height, level.data());
+    texture.firstMip = static_cast<uint32_t>(mips.size());
+    texture.mipCount = 0;
+    uint32_t width = texture.width;
+    uint32_t height = texture.height;
+    while (true)
+    {
+        CookedMip mip;
+        mip.width = width;
+        mip.height = height;
+        mip.offset = pixels.size();
+        mip.size = level.size();
+        mips.push_back(mip);
+        pixels.insert(pixels.end(), level.begin(), level.end());
+        texture.mipCount++;
+        if (width == 1 && height == 1)
+            break;
+
+        // Odd edges repeat their last row or column
+        uint32_t nextWidth = std::max(width / 2, 1u);
+        uint32_t nextHeight = std::max(height / 2, 1u);
+        std::vector<uint8_t> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+        for (uint32_t y = 0; y < nextHeight; ++y)
+        {
+            uint32_t y0 = std::min(y * 2, height - 1);
+            uint32_t y1 = std::min(y * 2 + 1, height - 1);
+            for (uint32_t x = 0; x < nextWidth; ++x)
+            {
+                uint32_t x0 = std::min(x * 2, width - 1);
+                uint32_t x1 = std::min(x * 2 + 1, width - 1);
+                for (int c = 0; c < 4; ++c)
+                {
+                    uint32_t sum = level[(y0 * width + x0) * 4 + c] +
+                                   level[(y0 * width + x1) * 4 + c] +
+                                   level[(y1 * width + x0) * 4 + c] +
+                                   level[(y1 * width + x1) * 4 + c];
+                    next[(y * nextWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+        level.swap(next);
+        width = nextWidth;
+        height = nextHeight;
+    }
+    return true;
+}
+
+int findBaseColorImage(const tinygltf::Model& model, int material)
+{
+    if (material < 0 || material >= static_cast<int>(model.materials.size()))
+        return -1;
+    int index = model.materials[material].pbrMetallicRoughness.baseColorTexture.index;
+    if (index < 0 || index >= static_cast<int>(model.textures.size()))
+        return -1;
+    int source = model.textures[index].source;
+    return source < static_cast<int>(model.images.size()) ? source : -1;
+}
+
+void cookPartTextures(const tinygltf::Model& model, const std::string& sourcePath,
+                      std::vector<CookedPart>& parts, std::vector<CookedTexture>& textures,
+                      std::vector<CookedMip>& mips, std::vector<uint8_t>& pixels)
+{
+    std::vector<int> cookedImages(model.images.size(), -2); // -2 not cooked yet, -1 unreadable
+    for (CookedPart& part : parts)
+    {
+        int image = part.texture;
+        if (image >= 0 && cookedImages[image] == -2)
+        {
+            CookedTexture texture;
+            size_t mipCount = mips.size();
+            size_t pixelCount = pixels.size();
+            cookedImages[image] = -1;
+            if (!cookTexture(model.images[image], texture, mips, pixels))
+                std::cerr << "Skipping texture of " << sourcePath << ", unsupported format"
+                          << std::endl;
+            else
+            {
+                auto same = std::find_if(textures.begin(), textures.end(),
+                                         [&](const CookedTexture& other)
+                                         { return other.hash == texture.hash; });
+                if (same != textures.end())
+                {
+                    mips.resize(mipCount);
+                    pixels.resize(pixelCount);
+                    cookedImages[image] = static_cast<int>(same - textures.begin());
+                }
+                else
+                {
+                    cookedImages[image] = static_cast<int>(textures.size());
+                    textures.push_back(texture);
+                }
+            }
+        }
+        part.texture = image >= 0 ? cookedImages[image] : -1;
+    }
+}
+
+bool cookModel(const std::string& sourcePath, std::vector<uint8_t>& blob)
+{
+    tinygltf::Model model;
+    tinygltf::TinyGLTF loader;
+    std::string err, warn;
+    bool binary = std::filesystem::path(sourcePath).extension() == ".glb";
+    bool loaded = binary ? loader.LoadBinaryFromFile(&model, &err, &warn, sourcePath)
+                         : loader.LoadASCIIFromFile(&model, &err, &warn, sourcePath);
+    if (!warn.empty())
+        std::cout << "Warn: " << warn << std::endl;
+    if (!loaded)
+    {
+        std::cerr << "Failed to cook " << sourcePath << ": " << err << std::endl;
+        return false;
+    }
+
+    // Palettes come from the first skin, the characters only have the one
+    std::vector<Skin> skins = loadSkins(model);
+    std::vector<int32_t> skinJoints;
+    std::vector<glm::mat4> inverseBindMatrices;
+    if (!skins.empty())
+    {
+        skinJoints.assign(skins[0].joints.begin(), skins[0].joints.end());
+        inverseBindMatrices = skins[0].inverseBindMatrices;
+    }
+
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<CookedPart> parts;
+    std::vector<int32_t> attachments;
+    cookGeometry(model, skinJoints.size(), vertices, indices, parts, attachments);
+    optimizeParts(vertices, indices, parts);
+
+    std::vector<CookedClip> clips;
+    std::vector<AnimChannel> channels;
+    std::vector<glm::vec3> rangeMin, rangeStep;
+    std::vector<uint16_t> times, words;
+    std::vector<char> names;
+    for (const AnimationClip& source : compileAnimationClips(model))
+    {
+        CompressedClip clip = compressClip(source, AnimCompressionSettings());
+        CookedClip cooked;
+        cooked.duration = clip.duration;
+        cooked.timeScale = clip.timeScale;
+        cooked.firstChannel = static_cast<uint32_t>(channels.size());
+        cooked.channelCount = static_cast<uint32_t>(clip.channels.size());
+        cooked.firstRange = static_cast<uint32_t>(rangeMin.size());
+        cooked.rangeCount = static_cast<uint32_t>(clip.rangeMin.size());
+        cooked.firstKey = static_cast<uint32_t>(times.size());
+        cooked.keyCount = static_cast<uint32_t>(clip.times.size());
+        cooked.firstName = static_cast<uint32_t>(names.size());
+        cooked.nameLength = static_cast<uint32_t>(clip.name.size());
+        clips.push_back(cooked);
+        channels.insert(channels.end(), clip.channels.begin(), clip.channels.end());
+        rangeMin.insert(rangeMin.end(), clip.rangeMin.begin(), clip.rangeMin.end());
+        rangeStep.insert(rangeStep.end(), clip.rangeStep.begin(), clip.rangeStep.end());
+        times.insert(times.end(), clip.times.begin(), clip.times.end());
+        words.insert(words.end(), clip.words.begin(), clip.words.end());
+        names.insert(names.end(), clip.name.begin(), clip.name.end());
+    }
+
+    std::vector<CookedTexture> textures;
+    std::vector<CookedMip> mips;
+    std::vector<uint8_t> pixels;
+    cookPartTextures(model, sourcePath, parts, textures, mips, pixels);
+    int baseColorTexture = -1;
+    for (const CookedPart& part : parts)
+    {
+        if (baseColorTexture < 0)
+            baseColorTexture = part.texture;
+    }
+
+    CookedHeader header = {};
+    header.magic = COOKED_MODEL_MAGIC;
+    header.version = COOKED_MODEL_VERSION;
+    header.baseColorTexture = baseColorTexture;
+    header.quantization = computeQuantization(vertices.data(), vertices.size());
+    std::vector<SkinnedVertex> packed(vertices.size());
+    packVertices(vertices.data(), vertices.size(), header.quantization, packed.data());
+    blob.assign(sizeof(CookedHeader), 0);
+    appendSection(blob, header.vertices, packed);
+    appendSection(blob, header.indices, indices);
+    appendSection(blob, header.parts, parts);
+    appendSection(blob, header.nodes, loadNodeTransforms(model));
+    appendSection(blob, header.attachments, attachments);
+    appendSection(blob, header.skinJoints, skinJoints);
+    appendSection(blob, header.inverseBindMatrices, inverseBindMatrices);
+    appendSection(blob, header.clips, clips);
+    appendSection(blob, header.channels, channels);
+    appendSection(blob, header.rangeMin, rangeMin);
+    appendSection(blob, header.rangeStep, rangeStep);
+    appendSection(blob, header.times, times);
+    appendSection(blob, header.words, words);
+    appendSection(blob, header.names, names);
+    appendSection(blob, header.textures, textures);
+    appendSection(blob, header.mips, mips);
+    appendSection(blob, header.pixels, pixels);
+    header.fileSize = blob.size();
+    std::memcpy(blob.data(), &header, sizeof(header));
+    return true;
+}
+
+CookedModel::CookedModel()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_mapping(nullptr)
+    , m_header(nullptr)
+{
+}
+
+CookedModel::~CookedModel() { close(); }
+
+bool CookedModel::open(const std::string& path)
+{
+    close();
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(CookedHeader)))
+    {
+        ::close(file);
+        return false;
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file); // The mapping keeps the file alive
+    if (mapping == MAP_FAILED)
+        return false;
+
+    m_mapping = mapping;
+    m_data = static_cast<const uint8_t*>(mapping);
+    m_size = static_cast<size_t>(info.st_size);
+    if (!validate())
+    {
+        std::cerr << "Ignoring " << path << ", it's damaged or from another version" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool CookedModel::open(std::vector<uint8_t> blob)
+{
+    close();
+    m_memory = std::move(blob);
+    m_data = m_memory.data();
+    m_size = m_memory.size();
+    if (!validate())
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CookedModel::close()
+{
+    if (m_mapping)
+        munmap(m_mapping, m_size);
+    m_mapping = nullptr;
+    m_memory.clear();
+    m_data = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+}
+
+// The cooker is trusted with the vertex data, but every offset and count the loader follows on
+// the CPU, and every index range the GPU draws, is checked so a truncated or foreign file can't
+// send either out of bounds
+bool CookedModel::validate()
+{
+    if (m_size < sizeof(CookedHeader))
+        return false;
+    const CookedHeader* header = reinterpret_cast<const CookedHeader*>(m_data);
+    if (header->magic != COOKED_MODEL_MAGIC || header->version != COOKED_MODEL_VERSION ||
+        header->fileSize != m_size)
+        return false;
+
+    auto fits = [&](const CookedRange& range, size_t elementSize)
+    {
+        return range.offset % 16 == 0 && range.offset >= sizeof(CookedHeader) &&
+               range.offset <= m_size && range.count <= (m_size - range.offset) / elementSize;
+    };
+    if (!fits(header->vertices, sizeof(SkinnedVertex)) ||
+        !fits(header->indices, sizeof(uint32_t)) || !fits(header->parts, sizeof(CookedPart)) ||
+        !fits(header->nodes, sizeof(NodeTransform)) ||
+        !fits(header->attachments, sizeof(int32_t)) ||
+        !fits(header->skinJoints, sizeof(int32_t)) ||
+        !fits(header->inverseBindMatrices, sizeof(glm::mat4)) ||
+        !fits(header->clips, sizeof(CookedClip)) || !fits(header->channels, sizeof(AnimChannel)) ||
+        !fits(header->rangeMin, sizeof(glm::vec3)) || !fits(header->rangeStep, sizeof(glm::vec3)) ||
+        !fits(header->times, sizeof(uint16_t)) || !fits(header->words, sizeof(uint16_t)) ||
+        !fits(header->names, 1) || !fits(header->textures, sizeof(CookedTexture)) ||
+        !fits(header->mips, sizeof(CookedMip)) || !fits(header->pixels, 1))
+        return false;
+    if (header->inverseBindMatrices.count != header->skinJoints.count ||
+        header->rangeStep.count != header->rangeMin.count ||
+        header->words.count != header->times.count * 3)
+        return false;
+
+    m_header = header;
+    uint64_t nodeCount = header->nodes.count;
+    for (size_t i = 0; i < header->attachments.count; ++i)
+    {
+        if (static_cast<uint64_t>(getAttachments()[i]) >= nodeCount)
+            return false;
+    }
+    const int32_t* joints = section<int32_t>(header->skinJoints);
+    for (size_t i = 0; i < header->skinJoints.count; ++i)
+    {
+        if (static_cast<uint64_t>(joints[i]) >= nodeCount)
+            return false;
+    }
+    const AnimChannel* channels = section<AnimChannel>(header->channels);
+    const CookedClip* clips = section<CookedClip>(header->clips);
+    for (size_t c = 0; c < header->clips.count; ++c)
+    {
+        const CookedClip& clip = clips[c];
+        if (uint64_t(clip.firstChannel) + clip.channelCount > header->channels.count ||
+            uint64_t(clip.firstRange) + clip.rangeCount > header->rangeMin.count ||
+            uint64_t(clip.firstKey) + clip.keyCount > header->times.count ||
+            uint64_t(clip.firstName) + clip.nameLength > header->names.count)
+            return false;
+        for (uint32_t i = 0; i < clip.channelCount; ++i)
+        {
+            const AnimChannel& channel = channels[clip.firstChannel + i];
+            bool ranged = channel.target != AnimTarget::Rotation;
+            if (static_cast<uint64_t>(channel.node) >= nodeCount ||
+                uint64_t(channel.firstKey) + channel.keyCount > clip.keyCount ||
+                (ranged && channel.firstValue >= clip.rangeCount))
+                return false;
+        }
+    }
+    const CookedMip* mips = section<CookedMip>(header->mips);
+    const CookedTexture* textures = section<CookedTexture>(header->textures);
+    for (size_t t = 0; t < header->textures.count; ++t)
+    {
+        if (uint64_t(textures[t].firstMip) + textures[t].mipCount > header->mips.count)
+            return false;
+    }
+    for (size_t m = 0; m < header->mips.count; ++m)
+    {
+        if (mips[m].size != uint64_t(mips[m].width) * mips[m].height * 4 ||
+            mips[m].offset > header->pixels.count ||
+            mips[m].size > header->pixels.count - mips[m].offset)
+            return false;
+    }
+    if (header->baseColorTexture >= static_cast<int64_t>(header->textures.count))
+        return false;
+    const CookedPart* parts = section<CookedPart>(header->parts);
+    for (size_t p = 0; p < header->parts.count; ++p)
+    {
+        if (parts[p].texture >= static_cast<int64_t>(header->textures.count) ||
+            uint64_t(parts[p].firstIndex) + parts[p].indexCount > header->indices.count ||
+            uint64_t(parts[p].firstVertex) + parts[p].vertexCount > header->vertices.count)
+            return false;
+    }
+    const uint32_t* indices = section<uint32_t>(header->indices);
+    for (size_t i = 0; i < header->indices.count; ++i)
+    {
+        if (indices[i] >= header->vertices.count)
+            return false;
+    }
+    return true;
+}
+
+Skin CookedModel::getSkin() const
+{
+    const int32_t* joints = section<int32_t>(m_header->skinJoints);
+    const glm::mat4* matrices = section<glm::mat4>(m_header->inverseBindMatrices);
+    Skin skin;
+    skin.joints.assign(joints, joints + m_header->skinJoints.count);
+    skin.inverseBindMatrices.assign(matrices, matrices + m_header->inverseBindMatrices.count);
+    return skin;
+}
+
+std::vector<CompressedClip> CookedModel::getClips() const
+{
+    const CookedClip* clips = section<CookedClip>(m_header->clips);
+    const AnimChannel* channels = section<AnimChannel>(m_header->channels);
+    const glm::vec3* rangeMin = section<glm::vec3>(m_header->rangeMin);
+    const glm::vec3* rangeStep = section<glm::vec3>(m_header->rangeStep);
+    const uint16_t* times = section<uint16_t>(m_header->times);
+    const uint16_t* words = section<uint16_t>(m_header->words);
+    const char* names = section<char>(m_header->names);
+
+    std::vector<CompressedClip> result(m_header->clips.count);
+    for (size_t c = 0; c < result.size(); ++c)
+    {
+        const CookedClip& cooked = clips[c];
+        CompressedClip& clip = result[c];
+        clip.name.assign(names + cooked.firstName, cooked.nameLength);
+        clip.duration = cooked.duration;
+        clip.timeScale = cooked.timeScale;
+        clip.channels.assign(channels + cooked.firstChannel,
+                             channels + cooked.firstChannel + cooked.channelCount);
+        clip.rangeMin.assign(rangeMin + cooked.firstRange,
+                             rangeMin + cooked.firstRange + cooked.rangeCount);
+        clip.rangeStep.assign(rangeStep + cooked.firstRange,
+                              rangeStep + cooked.firstRange + cooked.rangeCount);
+        clip.times.assign(times + cooked.firstKey, times + cooked.firstKey + cooked.keyCount);
+        clip.words.assign(words + cooked.firstKey * 3,
+                          words + (cooked.firstKey + cooked.keyCount) * 3);
+    }
+    return result;
+}
+
+GLuint CookedModel::loadTexture(int index, TextureCache& cache) const
+{
+    if (index < 0 || static_cast<size_t>(index) >= m_header->textures.count)
+        return 0;
+    const CookedTexture& texture = section<CookedTexture>(m_header->textures)[index];
+    return cache.upload(texture.hash, section<CookedMip>(m_header->mips) + texture.firstMip,
+                        texture.mipCount, section<uint8_t>(m_header->pixels));
+}
+
+std::vector<CookedPart> CookedModel::getMaterialBatches() const
+{
+    std::vector<CookedPart> batches;
+    const CookedPart* parts = getParts();
+    for (size_t p = 0; p < getPartCount(); ++p)
+    {
+        const CookedPart& part = parts[p];
+        if (!batches.empty() && batches.back().texture == part.texture &&
+            batches.back().firstIndex + batches.back().indexCount == part.firstIndex)
+        {
+            batches.back().vertexCount += part.vertexCount;
+            batches.back().indexCount += part.indexCount;
+            continue;
+        }
+        batches.push_back(part);
+    }
+    return batches;
+}
+
+bool writeCookedModel(const std::string& path, const std::vector<uint8_t>& blob)
+{
+    // Written aside and renamed into place, so a reader never maps half a file
+    std::string temporary = path + ".tmp";
+    std::error_code error;
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+        if (!out)
+            error = std::make_error_code(std::errc::io_error);
+    }
+    if (!error)
+        std::filesystem::rename(temporary, path, error);
+    if (!error)
+        return true;
+    std::filesystem::remove(temporary, error);
+    return false;
+}
+
+bool loadCookedModel(const std::string& sourcePath, CookedModel& cooked)
+{
+    std::filesystem::path cookedPath = sourcePath;
+    cookedPath.replace_extension(".cooked");
+
+    // Without the source the cooked file is used as is
+    std::error_code error;
+    auto cookedTime = std::filesystem::last_write_time(cookedPath, error);
+    if (!error)
+    {
+        auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+        if ((error || cookedTime >= sourceTime) && cooked.open(cookedPath.string()))
+            return true;
+    }
+
+    std::vector<uint8_t> blob;
+    if (!cookModel(sourcePath, blob))
+        return false;
+
+    if (writeCookedModel(cookedPath.string(), blob) && cooked.open(cookedPath.string()))
+    {
+        std::cout << "Cooked " << sourcePath << " into " << cookedPath.string() << ", "
+                  << blob.size() / 1024 << " KB" << std::endl;
+        return true;
+    }
+    std::cerr << "Failed to write " << cookedPath.string() << ", keeping it in memory"
+              << std::endl;
+    return cooked.open(std::move(blob));
+}
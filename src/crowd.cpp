@@ -0,0 +1,332 @@
+#include "crowd.h"
+#include "animation.h"
+#include "animation_compression.h"
+#include "cooked_model.h"
+#include "skinning.h"
+#include "transform_hierarchy.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Top three rows of an affine matrix, as the shaders read them back
+static void storeRows(const glm::mat4& m, glm::vec4* rows)
+{
+    for (int r = 0; r < 3; ++r)
+        rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+}
+
+CrowdRenderer::CrowdRenderer()
+    : m_textureCache(nullptr)
+    , m_time(0.0f)
+    , m_frame(0)
+    , m_maxTextureSize(0)
+    , m_drawnInstances(0)
+    , m_poseUpdates(0)
+    , m_paletteBytes(0)
+{
+}
+
+CrowdRenderer::~CrowdRenderer()
+{
+    for (const CharacterType& type : m_types)
+    {
+        glDeleteVertexArrays(1, &type.vao);
+        glDeleteBuffers(1, &type.vbo);
+        glDeleteBuffers(1, &type.ebo);
+        glDeleteBuffers(1, &type.instanceBuffer);
+        for (const MaterialBatch& batch : type.batches)
+            m_textureCache->release(batch.texture);
+        glDeleteTextures(1, &type.paletteTexture);
+    }
+}
+
+void CrowdRenderer::initialize()
+{
+    m_shader = ShaderBuilder()
+                   .load("shaders/crowd.vert.glsl", Shader::Type::Vertex)
+                   .load("shaders/fragment.glsl", Shader::Type::Fragment)
+                   .build();
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &m_maxTextureSize);
+}
+
+int CrowdRenderer::addCharacter(const std::string& path)
+{
+    CookedModel model;
+    if (!loadCookedModel(path, model))
+    {
+        std::cerr << "Failed to load crowd character " << path << std::endl;
+        return -1;
+    }
+    Skin skin = model.getSkin();
+    if (skin.joints.empty() || model.getIndexCount() == 0)
+    {
+        std::cerr << "Crowd character " << path << " has no skin or nothing to draw" << std::endl;
+        return -1;
+    }
+
+    TransformHierarchy hierarchy;
+    hierarchy.build(model.getNodes(), model.getNodeCount());
+
+    // The cooker merged every mesh already. Vertices of plain nodes are weighted to a slot of
+    // their own after the joints, their node's rest pose puts them in place for the bounds.
+    const SkinnedVertex* vertices = model.getVertices();
+    const VertexQuantization& quantization = model.getQuantization();
+    std::vector<int> attachments(model.getAttachments(),
+                                 model.getAttachments() + model.getAttachmentCount());
+    glm::vec3 boundsMin(1e30f);
+    glm::vec3 boundsMax(-1e30f);
+    for (size_t i = 0; i < model.getVertexCount(); ++i)
+    {
+        const SkinnedVertex& vertex = vertices[i];
+        glm::vec3 position = unpackPosition(vertex.position, quantization);
+        int attachment = vertex.joints[0] - static_cast<int>(skin.joints.size());
+        if (attachment >= 0 && attachment < static_cast<int>(attachments.size()))
+        {
+            const glm::mat4& rest = hierarchy.getWorldMatrix(attachments[attachment]);
+            position = glm::vec3(rest * glm::vec4(position, 1.0f));
+        }
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+    int slots = static_cast<int>(skin.joints.size() + attachments.size());
+
+    // Bake every clip from the rest pose at a fixed rate, the last frame lands on the end
+    CharacterType type;
+    type.slotsPerFrame = slots;
+    type.quantization = quantization;
+    type.bakeRate = m_lod.bakeRate;
+    std::vector<CompressedClip> clips = model.getClips();
+    std::vector<glm::vec4> texels;
+    std::vector<glm::vec4> values;
+    std::vector<glm::mat4> palette;
+    AnimationCursor cursor;
+    uint32_t frameCount = 0;
+    for (const CompressedClip& clip : clips)
+    {
+        BakedClip baked;
+        baked.name = clip.name;
+        baked.duration = clip.duration;
+        baked.firstFrame = frameCount;
+        baked.frameCount = static_cast<uint32_t>(std::ceil(clip.duration * type.bakeRate)) + 1;
+
+        // Clips don't all animate the same nodes
+        hierarchy.build(model.getNodes(), model.getNodeCount());
+        values.resize(clip.channels.size());
+        for (uint32_t frame = 0; frame < baked.frameCount; ++frame)
+        {
+            float time = std::min(frame / type.bakeRate, clip.duration);
+            sampleCompressedClip(clip, time, &cursor, values.data());
+            applyChannels(clip.channels, values.data(), hierarchy);
+            hierarchy.update();
+            computeJointPalette(skin, hierarchy, palette);
+            for (int node : attachments)
+                palette.push_back(hierarchy.getWorldMatrix(node));
+
+            size_t first = texels.size();
+            texels.resize(first + palette.size() * 3);
+            for (size_t j = 0; j < palette.size(); ++j)
+                storeRows(palette[j], &texels[first + j * 3]);
+        }
+        frameCount += baked.frameCount;
+        type.clips.push_back(std::move(baked));
+    }
+
+    // Whole frames per texture row, as many rows as that takes
+    int frameTexels = slots * 3;
+    int framesPerRow = std::max(1, m_maxTextureSize / frameTexels);
+    framesPerRow = std::min(framesPerRow, static_cast<int>(std::max(frameCount, 1u)));
+    int width = framesPerRow * frameTexels;
+    int height = static_cast<int>((frameCount + framesPerRow - 1) / framesPerRow);
+    if (height > m_maxTextureSize)
+    {
+        std::cerr << "Crowd character " << path << " bakes " << frameCount
+                  << " frames, more than fit a texture" << std::endl;
+        return -1;
+    }
+    texels.resize(static_cast<size_t>(width) * std::max(height, 1), glm::vec4(0.0f));
+
+    glGenTextures(1, &type.paletteTexture);
+    glBindTexture(GL_TEXTURE_2D, type.paletteTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, std::max(height, 1), 0, GL_RGBA, GL_FLOAT,
+                 texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_paletteBytes += texels.size() * sizeof(glm::vec4);
+
+    for (const CookedPart& part : model.getMaterialBatches())
+    {
+        MaterialBatch batch;
+        batch.texture = model.loadTexture(part.texture, *m_textureCache);
+        batch.firstIndex = part.firstIndex;
+        batch.indexCount = static_cast<GLsizei>(part.indexCount);
+        type.batches.push_back(batch);
+    }
+    // Centered on the instance's axis so yaw doesn't move it, and padded since attacks swing
+    // weapons well outside the bind pose
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    type.boundsCenter = glm::vec3(0.0f, center.y, 0.0f);
+    type.boundsRadius = glm::length(boundsMax - boundsMin) * 0.75f +
+                        glm::length(glm::vec2(center.x, center.z));
+
+    glGenVertexArrays(1, &type.vao);
+    glGenBuffers(1, &type.vbo);
+    glGenBuffers(1, &type.ebo);
+    glGenBuffers(1, &type.instanceBuffer);
+    glBindVertexArray(type.vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, type.vbo);
+    // Straight from the mapping
+    glBufferData(GL_ARRAY_BUFFER, model.getVertexCount() * sizeof(SkinnedVertex), vertices,
+                 GL_STATIC_DRAW);
+    setVertexAttributes(VertexFormat::Skinned);
+
+    // Per instance: three model matrix rows, then the animation frames
+    glBindBuffer(GL_ARRAY_BUFFER, type.instanceBuffer);
+    for (int i = 0; i < 4; ++i)
+    {
+        glVertexAttribPointer(4 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                              (void*)(i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(4 + i);
+        glVertexAttribDivisor(4 + i, 1);
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, type.ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, model.getIndexCount() * sizeof(uint32_t),
+                 model.getIndices(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    std::cout << "Crowd character " << path << ": " << clips.size() << " clips, " << frameCount
+              << " frames baked into " << width << "x" << height << std::endl;
+    m_types.push_back(std::move(type));
+    return static_cast<int>(m_types.size()) - 1;
+}
+
+void CrowdRenderer::addInstance(int type, const glm::vec3& position, float yaw, int clip,
+                                float timeOffset)
+{
+    Instance instance;
+    instance.type = type;
+    instance.clip = std::clamp(clip, 0, getClipCount(type) - 1);
+    instance.timeOffset = timeOffset;
+    instance.position = position;
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+    model = glm::rotate(model, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+    storeRows(model, instance.data.rows);
+    instance.data.animation = poseAt(m_types[type], instance.clip, m_time + timeOffset, true);
+    m_instances.push_back(instance);
+}
+
+void CrowdRenderer::clearInstances() { m_instances.clear(); }
+
+glm::vec4 CrowdRenderer::poseAt(const CharacterType& type, int clip, float time, bool blend) const
+{
+    if (type.clips.empty())
+        return glm::vec4(0.0f);
+    const BakedClip& baked = type.clips[clip];
+    float frame = 0.0f;
+    if (baked.duration > 0.0f)
+    {
+        float local = std::fmod(time, baked.duration);
+        if (local < 0.0f)
+            local += baked.duration;
+        frame = local * type.bakeRate;
+    }
+
+    uint32_t last = baked.frameCount - 1;
+    if (!blend)
+    {
+        float nearest = static_cast<float>(baked.firstFrame +
+                                           std::min(static_cast<uint32_t>(frame + 0.5f), last));
+        return glm::vec4(nearest, nearest, 0.0f, 0.0f);
+    }
+    uint32_t a = std::min(static_cast<uint32_t>(frame), last);
+    uint32_t b = std::min(a + 1, last);
+    return glm::vec4(static_cast<float>(baked.firstFrame + a),
+                     static_cast<float>(baked.firstFrame + b), frame - static_cast<float>(a), 0.0f);
+}
+
+void CrowdRenderer::render(const glm::mat4& view, const glm::mat4& projection,
+                           const glm::vec3& viewPos,
+                           const std::array<Camera::FrustumPlane, 6>& frustumPlanes)
+{
+    m_drawnInstances = 0;
+    m_poseUpdates = 0;
+    if (m_types.empty())
+        return;
+
+    for (CharacterType& type : m_types)
+        type.visible.clear();
+
+    for (size_t i = 0; i < m_instances.size(); ++i)
+    {
+        Instance& instance = m_instances[i];
+        CharacterType& type = m_types[instance.type];
+
+        glm::vec3 center = instance.position + type.boundsCenter;
+        bool visible = true;
+        for (const auto& plane : frustumPlanes)
+        {
+            if (glm::dot(plane.normal, center) + plane.distance < -type.boundsRadius)
+            {
+                visible = false;
+                break;
+            }
+        }
+        if (!visible)
+            continue;
+
+        // Staggered by index so a tier's updates don't all land on the same frame
+        int tier = m_lod.tierAt(glm::distance(viewPos, instance.position));
+        uint32_t interval = static_cast<uint32_t>(std::max(m_lod.updateIntervals[tier], 1));
+        if ((m_frame + i) % interval == 0)
+        {
+            instance.data.animation =
+                poseAt(type, instance.clip, m_time + instance.timeOffset, tier == 0);
+            m_poseUpdates++;
+        }
+        type.visible.push_back(instance.data);
+    }
+    m_frame++;
+
+    m_shader.use();
+    m_shader.setMat4("view", view);
+    m_shader.setMat4("projection", projection);
+    m_shader.setInt("texture1", 0);
+    m_shader.setInt("palettes", 1);
+
+    for (CharacterType& type : m_types)
+    {
+        if (type.visible.empty())
+            continue;
+
+        glBindBuffer(GL_ARRAY_BUFFER, type.instanceBuffer);
+        if (type.visible.size() > type.instanceCapacity)
+            type.instanceCapacity = std::max(type.visible.size(), type.instanceCapacity * 2);
+        // Orphan first so the driver doesn't wait on last frame's draw
+        glBufferData(GL_ARRAY_BUFFER, type.instanceCapacity * sizeof(InstanceData), nullptr,
+                     GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, type.visible.size() * sizeof(InstanceData),
+                        type.visible.data());
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, type.paletteTexture);
+        glActiveTexture(GL_TEXTURE0);
+        m_shader.setInt("slotsPerFrame", type.slotsPerFrame);
+        setVertexQuantization(m_shader, type.quantization);
+
+        glBindVertexArray(type.vao);
+        for (const MaterialBatch& batch : type.batches)
+        {
+            glBindTexture(GL_TEXTURE_2D, batch.texture);
+            glDrawElementsInstanced(GL_TRIANGLES, batch.indexCount, GL_UNSIGNED_INT,
+                                    (void*)(batch.firstIndex * sizeof(uint32_t)),
+                                    static_cast<GLsizei>(type.visible.size()));
+        }
+        m_drawnInstances += static_cast<int>(type.visible.size());
+    }
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
@@ -0,0 +1,281 @@
+#include "gltf_accessor.h"
+#include "tiny_gltf.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+// Converts count elements of have components of T, stride bytes apart, into want components of
+// U each, outStride bytes apart. The branches on the arguments are the same for every element,
+// so each instantiation is a tight loop, and packed data (the common case) is one flat loop the
+// compiler vectorizes, or a memcpy when nothing changes.
+template <typename T, typename U>
+static void convertElements(const uint8_t* data, size_t stride, size_t count, int have,
+                            bool normalized, U* out, int want, size_t outStride)
+{
+    const bool scaled = normalized && std::is_integral<T>::value;
+    const float scale = scaled ? 1.0f / static_cast<float>(std::numeric_limits<T>::max()) : 1.0f;
+    const bool clampToMinusOne = scaled && std::is_signed<T>::value;
+    auto convert = [&](const uint8_t* source) -> U
+    {
+        T value;
+        std::memcpy(&value, source, sizeof(T));
+        if constexpr (std::is_same<U, float>::value)
+        {
+            float result = static_cast<float>(value) * scale;
+            return clampToMinusOne ? std::max(result, -1.0f) : result;
+        }
+        else
+            return value > T(0) ? static_cast<U>(value) : U(0);
+    };
+
+    if (have == want && stride == have * sizeof(T) && outStride == want * sizeof(U))
+    {
+        size_t values = count * want;
+        if (std::is_same<T, U>::value && !scaled)
+        {
+            std::memcpy(out, data, values * sizeof(U));
+            return;
+        }
+        for (size_t i = 0; i < values; ++i)
+            out[i] = convert(data + i * sizeof(T));
+        return;
+    }
+
+    int shared = std::min(have, want);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint8_t* element = data + i * stride;
+        U* destination = reinterpret_cast<U*>(reinterpret_cast<uint8_t*>(out) + i * outStride);
+        for (int c = 0; c < shared; ++c)
+            destination[c] = convert(element + c * sizeof(T));
+        for (int c = shared; c < want; ++c)
+            destination[c] = U(0);
+    }
+}
+
+template <typename U>
+static void convertElements(int componentType, const uint8_t* data, size_t stride, size_t count,
+                            int have, bool normalized, U* out, int want, size_t outStride)
+{
+    switch (componentType)
+    {
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+        convertElements<int8_t>(data, stride, count, have, normalized, out, want, outStride);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        convertElements<uint8_t>(data, stride, count, have, normalized, out, want, outStride);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+        convertElements<int16_t>(data, stride, count, have, normalized, out, want, outStride);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        convertElements<uint16_t>(data, stride, count, have, normalized, out, want, outStride);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_INT:
+        convertElements<int32_t>(data, stride, count, have, normalized, out, want, outStride);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        convertElements<uint32_t>(data, stride, count, have, normalized, out, want, outStride);
+        break;
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+        convertElements<float>(data, stride, count, have, normalized, out, want, outStride);
+        break;
+    }
+}
+
+// Start of bytes bytes at offset into the buffer view, null unless they're all inside it
+static const uint8_t* viewBytes(const tinygltf::Model& model, int viewIndex, size_t offset,
+                                size_t bytes)
+{
+    if (viewIndex < 0 || viewIndex >= static_cast<int>(model.bufferViews.size()))
+        return nullptr;
+    const tinygltf::BufferView& view = model.bufferViews[viewIndex];
+    if (view.buffer < 0 || view.buffer >= static_cast<int>(model.buffers.size()))
+        return nullptr;
+    const tinygltf::Buffer& buffer = model.buffers[view.buffer];
+    size_t size = buffer.data.size();
+    if (view.byteOffset > size || view.byteLength > size - view.byteOffset ||
+        offset > view.byteLength || bytes > view.byteLength - offset)
+        return nullptr;
+    return buffer.data.data() + view.byteOffset + offset;
+}
+
+AccessorView::AccessorView(const tinygltf::Model& model, int accessorIndex)
+{
+    if (accessorIndex < 0 || accessorIndex >= static_cast<int>(model.accessors.size()))
+        return;
+    const tinygltf::Accessor& accessor = model.accessors[accessorIndex];
+    int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+    int components = tinygltf::GetNumComponentsInType(accessor.type);
+    if (componentSize <= 0 || components <= 0 ||
+        accessor.componentType == TINYGLTF_COMPONENT_TYPE_DOUBLE)
+        return;
+    size_t elementSize = static_cast<size_t>(componentSize) * components;
+
+    size_t count = accessor.count;
+    m_componentSize = static_cast<size_t>(componentSize);
+    m_elementSize = elementSize;
+    m_components = components;
+    m_componentType = accessor.componentType;
+    m_normalized = accessor.normalized;
+    m_stride = elementSize;
+    if (accessor.bufferView >= 0)
+    {
+        int stride = accessor.ByteStride(model.bufferViews[accessor.bufferView]);
+        if (stride <= 0)
+            return;
+        m_stride = static_cast<size_t>(stride);
+        size_t bytes = count > 0 ? (count - 1) * m_stride + elementSize : 0;
+        m_data = viewBytes(model, accessor.bufferView, accessor.byteOffset, bytes);
+        if (!m_data)
+            return;
+    }
+    else if (!accessor.sparse.isSparse)
+        return;
+
+    if (accessor.sparse.isSparse && accessor.sparse.count > 0)
+    {
+        const auto& sparse = accessor.sparse;
+        int indexSize = tinygltf::GetComponentSizeInBytes(sparse.indices.componentType);
+        if (sparse.indices.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE &&
+            sparse.indices.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT &&
+            sparse.indices.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)
+            return;
+        size_t sparseCount = static_cast<size_t>(sparse.count);
+        m_sparseIndices = viewBytes(model, sparse.indices.bufferView, sparse.indices.byteOffset,
+                                    sparseCount * indexSize);
+        m_sparseValues = viewBytes(model, sparse.values.bufferView, sparse.values.byteOffset,
+                                   sparseCount * elementSize);
+        if (!m_sparseIndices || !m_sparseValues)
+            return;
+        m_sparseIndexType = sparse.indices.componentType;
+        m_sparseCount = sparseCount;
+    }
+    m_count = count;
+    m_valid = true;
+}
+
+bool AccessorView::isPacked() const
+{
+    return m_valid && m_data && !isSparse() && m_stride == m_elementSize;
+}
+
+uint32_t AccessorView::sparseIndex(size_t slot) const
+{
+    uint32_t index = 0;
+    size_t indexSize = tinygltf::GetComponentSizeInBytes(m_sparseIndexType);
+    convertElements(m_sparseIndexType, m_sparseIndices + slot * indexSize, 0, 1, 1, false, &index,
+                    1, sizeof(uint32_t));
+    return index;
+}
+
+const uint8_t* AccessorView::elementData(size_t element) const
+{
+    if (isSparse())
+    {
+        // The indices are strictly increasing
+        size_t low = 0;
+        size_t high = m_sparseCount;
+        while (low < high)
+        {
+            size_t middle = (low + high) / 2;
+            if (sparseIndex(middle) < element)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if (low < m_sparseCount && sparseIndex(low) == element)
+            return m_sparseValues + low * m_elementSize;
+    }
+    return m_data ? m_data + element * m_stride : nullptr;
+}
+
+float AccessorView::getFloat(size_t element, int component) const
+{
+    float value = 0.0f;
+    if (element >= m_count || component < 0 || component >= m_components)
+        return value;
+    const uint8_t* data = elementData(element);
+    if (data)
+        convertElements(m_componentType, data + component * m_componentSize, 0, 1, 1, m_normalized,
+                        &value, 1, sizeof(float));
+    return value;
+}
+
+uint32_t AccessorView::getUint(size_t element, int component) const
+{
+    uint32_t value = 0;
+    if (element >= m_count || component < 0 || component >= m_components)
+        return value;
+    const uint8_t* data = elementData(element);
+    if (data)
+        convertElements(m_componentType, data + component * m_componentSize, 0, 1, 1, false,
+                        &value, 1, sizeof(uint32_t));
+    return value;
+}
+
+// Base data, or zeros without any, then the sparse substitutions on top
+template <typename U>
+void AccessorView::read(U* out, int components, size_t outStride, bool normalized) const
+{
+    if (!m_valid)
+        return;
+    if (m_data)
+    {
+        convertElements(m_componentType, m_data, m_stride, m_count, m_components, normalized, out,
+                        components, outStride);
+    }
+    else
+    {
+        for (size_t i = 0; i < m_count; ++i)
+        {
+            U* destination = reinterpret_cast<U*>(reinterpret_cast<uint8_t*>(out) + i * outStride);
+            std::fill_n(destination, components, U(0));
+        }
+    }
+
+    for (size_t k = 0; k < m_sparseCount; ++k)
+    {
+        uint32_t index = sparseIndex(k);
+        if (index >= m_count)
+            continue;
+        U* destination = reinterpret_cast<U*>(reinterpret_cast<uint8_t*>(out) + index * outStride);
+        convertElements(m_componentType, m_sparseValues + k * m_elementSize, m_elementSize, 1,
+                        m_components, normalized, destination, components, outStride);
+    }
+}
+
+void AccessorView::readFloats(float* out, int components, size_t outStride) const
+{
+    read(out, components, outStride, m_normalized);
+}
+
+void AccessorView::readUints(uint32_t* out, int components, size_t outStride) const
+{
+    read(out, components, outStride, false);
+}
+
+std::vector<float> readAccessorFloats(const tinygltf::Model& model, int accessorIndex,
+                                      int components)
+{
+    std::vector<float> result;
+    AccessorView view(model, accessorIndex);
+    if (!view.isValid())
+        return result;
+    result.resize(view.getCount() * components);
+    view.readFloats(result.data(), components, components * sizeof(float));
+    return result;
+}
+
+std::vector<uint32_t> readAccessorUints(const tinygltf::Model& model, int accessorIndex,
+                                        int components)
+{
+    std::vector<uint32_t> result;
+    AccessorView view(model, accessorIndex);
+    if (!view.isValid())
+        return result;
+    result.resize(view.getCount() * components);
+    view.readUints(result.data(), components, components * sizeof(uint32_t));
+    return result;
+}
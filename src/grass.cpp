@@ -1,12 +1,51 @@
 #include "grass.h"
-#include <random>
+#include "packing.h"
+#include <algorithm>
+#include <limits>
 #include <iostream>
 
 GrassManager::GrassManager()
-    : m_windStrength(0.5f)
+    : m_bladeCount(0)
+    , m_seed(1)
+    , m_terrain(nullptr)
+    , m_threadPool(nullptr)
+    , m_cullKernel(selectGrassCullKernel())
+    , m_gridOrigin(0.0f)
+    , m_gridWidth(0)
+    , m_gridDepth(0)
+    , m_streaming(false)
+    , m_ringOrigin(0)
+    , m_bladesPerCell(0)
+    , m_streamBudget(16)
+    , m_pendingCells(0)
+    , m_cellSize(4.0f)
+    , m_maxBladeHeight(0.0f)
+    , m_visibleCells(0)
+    , m_windStrength(0.5f)
     , m_time(0.0f)
     , m_windDirection(1.0f, 0.0f, 0.0f)
     , m_grassShader("shaders/grass.vert.glsl", "shaders/grass.frag.glsl")
+    , m_instanceLayout(InstanceLayout::Packed)
+    , m_bladeVBO(0)
+    , m_bladeTexture(0)
+    , m_cellVBO(0)
+    , m_cellTexture(0)
+    , m_cullMode(CullMode::CPU)
+    , m_cullVAO(0)
+    , m_feedbackVBO(0)
+    , m_feedbackVAO(0)
+    , m_feedback(0)
+    , m_feedbackQuery(0)
+    , m_feedbackQueryPending(false)
+    , m_feedbackCount(0)
+    , m_computeVAO(0)
+    , m_computeOutput(0)
+    , m_drawCommand(0)
+    , m_computeSupported(false)
+    , m_tierFirstVertex{}
+    , m_tierVertexCount{}
+    , m_tierCounts{}
+    , m_visibleCount(0)
 {
 }
 
@@ -15,39 +54,403 @@ GrassManager::~GrassManager()
     glDeleteVertexArrays(1, &m_VAO);
     glDeleteBuffers(1, &m_VBO);
     glDeleteBuffers(1, &m_instanceVBO);
+
+    glDeleteVertexArrays(1, &m_cullVAO);
+    glDeleteVertexArrays(1, &m_feedbackVAO);
+    glDeleteVertexArrays(1, &m_computeVAO);
+    glDeleteBuffers(1, &m_bladeVBO);
+    glDeleteTextures(1, &m_bladeTexture);
+    glDeleteBuffers(1, &m_cellVBO);
+    glDeleteTextures(1, &m_cellTexture);
+    glDeleteBuffers(1, &m_feedbackVBO);
+    glDeleteBuffers(1, &m_computeOutput);
+    glDeleteBuffers(1, &m_drawCommand);
+    glDeleteQueries(1, &m_feedbackQuery);
+    if (m_feedback != 0)
+        glDeleteTransformFeedbacks(1, &m_feedback);
 }
 
 void GrassManager::initialize(int numBlades, float areaWidth, float areaDepth)
 {
     generateGrassBlades(numBlades, areaWidth, areaDepth);
+    buildCells(areaWidth, areaDepth);
     setupBuffers();
+    setupGpuCulling();
+
+    // Everything the GPU needs now lives in m_bladeVBO, culling only reads m_cullData
+    m_grassBlades.clear();
+    m_grassBlades.shrink_to_fit();
+}
+
+// Blade index attribute 3, read from the uint buffer bound to GL_ARRAY_BUFFER from index first on
+static void setupIndexAttribute(GLuint divisor, size_t first = 0)
+{
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(uint32_t),
+                           (void*)(first * sizeof(uint32_t)));
+    glVertexAttribDivisor(3, divisor);
+}
+
+// Blade mesh attributes 0-2 sourced from the geometry buffer
+static void setupMeshAttributes(GLuint meshVBO)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, meshVBO);
+    // Position
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    // Normal
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    // TexCoord
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+}
+
+// Turns the scatter points of one world cell into blades, padding up to capacity with zero
+// height blades the GPU cull skips. Touches no members, so cells can run on any thread.
+int GrassManager::scatterBlades(const ScatterLayer& layer, glm::ivec2 coord, GrassBlade* blades,
+                                ScatterPoint* points, size_t capacity) const
+{
+    size_t count = scatterCell(m_seed, layer, coord, m_cellSize, points);
+
+    // One batched query for the whole cell, the points mostly share a terrain chunk
+    std::vector<glm::vec2> roots(count);
+    std::vector<float> ground(count, 0.0f);
+    for (size_t i = 0; i < count; ++i)
+        roots[i] = points[i].position;
+    if (m_terrain)
+        m_terrain->heights(roots.data(), count, ground.data());
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        ScatterRng rng(points[i].hash);
+        GrassBlade& blade = blades[i];
+        blade.position = glm::vec3(roots[i].x, ground[i], roots[i].y);
+        blade.height = rng.range(0.3f, 0.7f);
+        blade.width = rng.range(0.02f, 0.05f);
+        blade.rotation = rng.range(0.0f, 360.0f);
+        blade.color = glm::vec3(0.1f * rng.range(0.7f, 1.0f), 0.6f * rng.range(0.7f, 1.0f),
+                                0.1f * rng.range(0.7f, 1.0f));
+    }
+    std::fill(blades + count, blades + capacity, GrassBlade{});
+    return static_cast<int>(count);
 }
 
 void GrassManager::generateGrassBlades(int numBlades, float areaWidth, float areaDepth)
 {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> posXDist(-areaWidth / 2, areaWidth / 2);
-    std::uniform_real_distribution<float> posZDist(-areaDepth / 2, areaDepth / 2);
-    std::uniform_real_distribution<float> heightDist(0.3f, 0.7f);
-    std::uniform_real_distribution<float> widthDist(0.02f, 0.05f);
-    std::uniform_real_distribution<float> rotDist(0.0f, 360.0f);
-    std::uniform_real_distribution<float> colorDist(0.7f, 1.0f);
+    // Scatter the world cells covering the area, like the streaming field does, and trim them
+    // to the area with the mask
+    glm::vec2 areaMin(-areaWidth / 2, -areaDepth / 2);
+    glm::vec2 areaMax(areaWidth / 2, areaDepth / 2);
+    glm::ivec2 cellMin(glm::floor(areaMin / m_cellSize));
+    glm::ivec2 cellMax = glm::ivec2(glm::ceil(areaMax / m_cellSize)) - 1;
+    glm::ivec2 extent = cellMax - cellMin + 1;
+
+    ScatterLayer layer = m_grassLayer;
+    layer.density = numBlades / (areaWidth * areaDepth);
+    layer.mask = [&](const glm::vec2& p)
+    {
+        if (p.x < areaMin.x || p.y < areaMin.y || p.x >= areaMax.x || p.y >= areaMax.y)
+            return 0.0f;
+        return m_grassLayer.mask ? m_grassLayer.mask(p) : 1.0f;
+    };
+
+    size_t cellCount = static_cast<size_t>(extent.x) * extent.y;
+    size_t capacity = scatterCapacity(layer, m_cellSize);
+    std::vector<GrassBlade> blades(cellCount * capacity);
+    std::vector<ScatterPoint> points(cellCount * capacity);
+    std::vector<int> counts(cellCount);
+    parallelFor(m_threadPool, cellCount,
+                [&](size_t i)
+                {
+                    glm::ivec2 coord = cellMin + glm::ivec2(static_cast<int>(i % extent.x),
+                                                            static_cast<int>(i / extent.x));
+                    counts[i] = scatterBlades(layer, coord, &blades[i * capacity],
+                                              &points[i * capacity], capacity);
+                });
+
+    m_grassBlades.clear();
+    for (size_t i = 0; i < cellCount; ++i)
+    {
+        auto first = blades.begin() + i * capacity;
+        m_grassBlades.insert(m_grassBlades.end(), first, first + counts[i]);
+    }
+}
+
+void GrassManager::buildCells(float areaWidth, float areaDepth)
+{
+    m_gridOrigin = glm::vec2(-areaWidth / 2, -areaDepth / 2);
+    m_gridWidth = std::max(1, static_cast<int>(std::ceil(areaWidth / m_cellSize)));
+    m_gridDepth = std::max(1, static_cast<int>(std::ceil(areaDepth / m_cellSize)));
+
+    auto cellIndexOf = [&](const glm::vec3& p)
+    {
+        int cx = static_cast<int>((p.x - m_gridOrigin.x) / m_cellSize);
+        int cz = static_cast<int>((p.z - m_gridOrigin.y) / m_cellSize);
+        cx = std::clamp(cx, 0, m_gridWidth - 1);
+        cz = std::clamp(cz, 0, m_gridDepth - 1);
+        return cz * m_gridWidth + cx;
+    };
+
+    // Counting sort of the blades by cell so every cell is one contiguous range
+    std::vector<int> counts(m_gridWidth * m_gridDepth + 1, 0);
+    for (const auto& blade : m_grassBlades)
+        counts[cellIndexOf(blade.position) + 1]++;
+    for (size_t i = 1; i < counts.size(); ++i)
+        counts[i] += counts[i - 1];
+
+    std::vector<GrassBlade> sorted(m_grassBlades.size());
+    std::vector<int> cursor(counts.begin(), counts.end() - 1);
+    for (const auto& blade : m_grassBlades)
+        sorted[cursor[cellIndexOf(blade.position)]++] = blade;
+    m_grassBlades.swap(sorted);
+
+    m_bladeCount = m_grassBlades.size();
+    m_cullData.resize(m_bladeCount);
+    for (size_t i = 0; i < m_grassBlades.size(); ++i)
+    {
+        m_cullData.x[i] = m_grassBlades[i].position.x;
+        m_cullData.y[i] = m_grassBlades[i].position.y;
+        m_cullData.z[i] = m_grassBlades[i].position.z;
+        m_cullData.height[i] = m_grassBlades[i].height;
+    }
+
+    m_maxBladeHeight = 0.0f;
+    m_cells.resize(m_gridWidth * m_gridDepth);
+    for (int cz = 0; cz < m_gridDepth; ++cz)
+    {
+        for (int cx = 0; cx < m_gridWidth; ++cx)
+        {
+            int index = cz * m_gridWidth + cx;
+            GrassCell& cell = m_cells[index];
+            cell.firstBlade = counts[index];
+            cell.bladeCount = counts[index + 1] - counts[index];
+            // Bounds grow from the first root, the ground isn't at y = 0 anymore
+            float ground = cell.bladeCount > 0 ? m_grassBlades[cell.firstBlade].position.y : 0.0f;
+            cell.boundsMin = glm::vec3(m_gridOrigin.x + cx * m_cellSize, ground,
+                                       m_gridOrigin.y + cz * m_cellSize);
+            cell.boundsMax = cell.boundsMin + glm::vec3(m_cellSize, 0.0f, m_cellSize);
+            cell.coord = glm::ivec2(cx, cz);
+
+            for (int i = cell.firstBlade; i < cell.firstBlade + cell.bladeCount; ++i)
+            {
+                const GrassBlade& blade = m_grassBlades[i];
+                cell.boundsMin.y = std::min(cell.boundsMin.y, blade.position.y);
+                cell.boundsMax.y = std::max(cell.boundsMax.y, blade.position.y + blade.height);
+                m_maxBladeHeight = std::max(m_maxBladeHeight, blade.height);
+            }
+        }
+    }
+    visibleIndices.resize(m_bladeCount + GRASS_CULL_PADDING);
+}
+
+// One tapered blade per tier, split into LOD_SEGMENTS[tier] rows with a single triangle at the
+// tip. The vertex shader curves the blade, which is what the extra rows are for.
+void GrassManager::buildBladeMeshes()
+{
+    m_bladeVertices.clear();
+    auto addVertex = [&](float x, float y)
+    {
+        float u = y < 1.0f ? 0.5f + x / (1.0f - y) : 0.5f;
+        m_bladeVertices.insert(m_bladeVertices.end(), { x, y, 0.0f, 0.0f, 1.0f, 0.0f, u, y });
+    };
+
+    for (int tier = 0; tier < LOD_TIERS; ++tier)
+    {
+        m_tierFirstVertex[tier] = static_cast<GLint>(m_bladeVertices.size() / 8);
+        int segments = LOD_SEGMENTS[tier];
+        for (int row = 0; row < segments; ++row)
+        {
+            float y0 = float(row) / segments;
+            float y1 = float(row + 1) / segments;
+            float half0 = 0.5f * (1.0f - y0);
+            float half1 = 0.5f * (1.0f - y1);
+            addVertex(-half0, y0);
+            addVertex(half0, y0);
+            addVertex(-half1, y1);
+            if (row + 1 < segments)
+            {
+                addVertex(half0, y0);
+                addVertex(half1, y1);
+                addVertex(-half1, y1);
+            }
+        }
+        m_tierVertexCount[tier] =
+            static_cast<GLsizei>(m_bladeVertices.size() / 8) - m_tierFirstVertex[tier];
+    }
+}
+
+void GrassManager::initializeStreaming(const glm::vec3& center, float radius,
+                                       float bladesPerSquareMeter)
+{
+    m_streaming = true;
+    // Odd so the center cell sits in the middle of the ring
+    m_gridWidth = 2 * std::max(1, static_cast<int>(std::ceil(radius / m_cellSize))) + 1;
+    m_gridDepth = m_gridWidth;
+    m_grassLayer.density = bladesPerSquareMeter;
+    m_bladesPerCell = static_cast<int>(scatterCapacity(m_grassLayer, m_cellSize));
+    m_ringOrigin = glm::ivec2(static_cast<int>(std::floor(center.x / m_cellSize)),
+                              static_cast<int>(std::floor(center.z / m_cellSize))) -
+                   glm::ivec2(m_gridWidth / 2, m_gridDepth / 2);
+    m_gridOrigin = glm::vec2(m_ringOrigin) * m_cellSize;
+
+    // Every slot owns a fixed range of m_bladesPerCell blades for good
+    m_cells.resize(m_gridWidth * m_gridDepth);
+    m_bladeCount = m_cells.size() * m_bladesPerCell;
+    m_cullData.resize(m_bladeCount);
+    m_grassBlades.resize(m_bladeCount);
+    std::vector<ScatterPoint> points(m_bladeCount);
+    std::vector<int> counts(m_cells.size());
+    parallelFor(m_threadPool, m_cells.size(),
+                [&](size_t slot)
+                {
+                    size_t first = slot * m_bladesPerCell;
+                    counts[slot] = scatterBlades(m_grassLayer, slotCoord(static_cast<int>(slot)),
+                                                 &m_grassBlades[first], &points[first],
+                                                 m_bladesPerCell);
+                });
+
+    m_maxBladeHeight = 0.0f;
+    for (size_t slot = 0; slot < m_cells.size(); ++slot)
+    {
+        m_cells[slot].firstBlade = static_cast<int>(slot * m_bladesPerCell);
+        commitCell(static_cast<int>(slot), slotCoord(static_cast<int>(slot)),
+                   &m_grassBlades[m_cells[slot].firstBlade], counts[slot]);
+    }
+    visibleIndices.resize(m_bladeCount + GRASS_CULL_PADDING);
+    m_pending.reserve(m_cells.size());
+    m_streamPacked.resize(m_bladesPerCell);
+
+    setupBuffers();
+    setupGpuCulling();
+
+    m_grassBlades.clear();
+    m_grassBlades.shrink_to_fit();
+}
+
+int GrassManager::cellSlot(int gridX, int gridZ) const
+{
+    int x = (m_ringOrigin.x + gridX) % m_gridWidth;
+    int z = (m_ringOrigin.y + gridZ) % m_gridDepth;
+    x += x < 0 ? m_gridWidth : 0;
+    z += z < 0 ? m_gridDepth : 0;
+    return z * m_gridWidth + x;
+}
+
+// World cell a slot holds for the current ring origin
+glm::ivec2 GrassManager::slotCoord(int slot) const
+{
+    // Grid position of the slot, from inverting cellSlot()
+    int gridX = ((slot % m_gridWidth - m_ringOrigin.x) % m_gridWidth + m_gridWidth) % m_gridWidth;
+    int gridZ = ((slot / m_gridWidth - m_ringOrigin.y) % m_gridDepth + m_gridDepth) % m_gridDepth;
+    return m_ringOrigin + glm::ivec2(gridX, gridZ);
+}
+
+// Takes the freshly scattered blades of world cell coord into the slot. Blades only depend on the
+// seed and the coordinate, so a cell comes back exactly as it was whenever it streams in again.
+void GrassManager::commitCell(int slot, glm::ivec2 coord, const GrassBlade* blades, int count)
+{
+    GrassCell& cell = m_cells[slot];
+    cell.coord = coord;
+    cell.bladeCount = count;
+    float ground = count > 0 ? blades[0].position.y : 0.0f;
+    cell.boundsMin = glm::vec3(coord.x * m_cellSize, ground, coord.y * m_cellSize);
+    cell.boundsMax = cell.boundsMin + glm::vec3(m_cellSize, 0.0f, m_cellSize);
+
+    for (int i = 0; i < count; ++i)
+    {
+        const GrassBlade& blade = blades[i];
+        cell.boundsMin.y = std::min(cell.boundsMin.y, blade.position.y);
+        cell.boundsMax.y = std::max(cell.boundsMax.y, blade.position.y + blade.height);
+        m_maxBladeHeight = std::max(m_maxBladeHeight, blade.height);
+
+        size_t index = cell.firstBlade + i;
+        m_cullData.x[index] = blade.position.x;
+        m_cullData.y[index] = blade.position.y;
+        m_cullData.z[index] = blade.position.z;
+        m_cullData.height[index] = blade.height;
+    }
+}
+
+// Writes a regenerated slot into the resident blade buffer (and the cell table when packed). The
+// whole slot goes up so the padding clears whatever the previous cell left behind.
+void GrassManager::uploadCell(int slot, const GrassBlade* blades)
+{
+    const GrassCell& cell = m_cells[slot];
+    glBindBuffer(GL_ARRAY_BUFFER, m_bladeVBO);
+    if (m_instanceLayout == InstanceLayout::Float)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, cell.firstBlade * sizeof(GrassBlade),
+                        m_bladesPerCell * sizeof(GrassBlade), blades);
+        return;
+    }
+
+    glm::vec4 origin = packCell(slot, blades, m_bladesPerCell, m_streamPacked.data());
+    glBufferSubData(GL_ARRAY_BUFFER, cell.firstBlade * sizeof(PackedGrassBlade),
+                    m_bladesPerCell * sizeof(PackedGrassBlade), m_streamPacked.data());
+    glBindBuffer(GL_ARRAY_BUFFER, m_cellVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, slot * sizeof(glm::vec4), sizeof(glm::vec4), &origin);
+}
+
+void GrassManager::updateStreaming(const glm::vec3& center)
+{
+    if (!m_streaming)
+        return;
+
+    m_ringOrigin = glm::ivec2(static_cast<int>(std::floor(center.x / m_cellSize)),
+                              static_cast<int>(std::floor(center.z / m_cellSize))) -
+                   glm::ivec2(m_gridWidth / 2, m_gridDepth / 2);
+    m_gridOrigin = glm::vec2(m_ringOrigin) * m_cellSize;
+
+    // Slots still holding a cell that has left the ring. Until they're regenerated they keep
+    // drawing their old blades, which are still in the right place.
+    m_pending.clear();
+    for (int gz = 0; gz < m_gridDepth; ++gz)
+    {
+        for (int gx = 0; gx < m_gridWidth; ++gx)
+        {
+            if (m_cells[cellSlot(gx, gz)].coord != m_ringOrigin + glm::ivec2(gx, gz))
+            {
+                float dx = static_cast<float>(gx - m_gridWidth / 2);
+                float dz = static_cast<float>(gz - m_gridDepth / 2);
+                m_pending.push_back({ dx * dx + dz * dz, gx, gz });
+            }
+        }
+    }
 
-    m_grassBlades.resize(numBlades);
-    for (int i = 0; i < numBlades; ++i)
+    // Nearest first, and no more than the budget per frame so crossing a cell never hitches
+    size_t count = std::min(m_pending.size(), static_cast<size_t>(std::max(m_streamBudget, 0)));
+    std::partial_sort(m_pending.begin(), m_pending.begin() + count, m_pending.end(),
+                      [](const PendingCell& a, const PendingCell& b)
+                      { return a.distance < b.distance; });
+    // Scatter in parallel, then commit and upload on this thread which owns the GL context
+    m_streamBlades.resize(count * m_bladesPerCell);
+    m_streamPoints.resize(count * m_bladesPerCell);
+    m_streamCounts.resize(count);
+    parallelFor(m_threadPool, count,
+                [&](size_t i)
+                {
+                    glm::ivec2 coord =
+                        m_ringOrigin + glm::ivec2(m_pending[i].gridX, m_pending[i].gridZ);
+                    m_streamCounts[i] =
+                        scatterBlades(m_grassLayer, coord, &m_streamBlades[i * m_bladesPerCell],
+                                      &m_streamPoints[i * m_bladesPerCell], m_bladesPerCell);
+                });
+    for (size_t i = 0; i < count; ++i)
     {
-        m_grassBlades[i].position = glm::vec3(posXDist(gen), 0.0f, posZDist(gen));
-        m_grassBlades[i].height = heightDist(gen);
-        m_grassBlades[i].width = widthDist(gen);
-        m_grassBlades[i].rotation = rotDist(gen);
-        m_grassBlades[i].color =
-            glm::vec3(0.1f * colorDist(gen), 0.6f * colorDist(gen), 0.1f * colorDist(gen));
+        int slot = cellSlot(m_pending[i].gridX, m_pending[i].gridZ);
+        const GrassBlade* blades = &m_streamBlades[i * m_bladesPerCell];
+        commitCell(slot, m_ringOrigin + glm::ivec2(m_pending[i].gridX, m_pending[i].gridZ),
+                   blades, m_streamCounts[i]);
+        uploadCell(slot, blades);
     }
+    m_pendingCells = static_cast<int>(m_pending.size() - count);
 }
 
 void GrassManager::setupBuffers()
 {
+    buildBladeMeshes();
+
     // Setup VAO/VBO for grass blade geometry
     glGenVertexArrays(1, &m_VAO);
     glGenBuffers(1, &m_VBO);
@@ -56,50 +459,233 @@ void GrassManager::setupBuffers()
     glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
     glBufferData(GL_ARRAY_BUFFER, m_bladeVertices.size() * sizeof(float), &m_bladeVertices[0],
                  GL_STATIC_DRAW);
+    setupMeshAttributes(m_VBO);
 
-    // Vertex attributes
-    // Position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    // Normal
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    // TexCoord
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    uploadBlades();
 
-    // Setup instance VBO
+    // Per frame only the visible indices are streamed
     glGenBuffers(1, &m_instanceVBO);
     glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
-    glBufferData(GL_ARRAY_BUFFER, m_grassBlades.size() * sizeof(GrassBlade), nullptr,
+    glBufferData(GL_ARRAY_BUFFER, m_bladeCount * sizeof(uint32_t), nullptr, GL_STREAM_DRAW);
+    setupIndexAttribute(1);
+
+    glBindVertexArray(0);
+}
+
+size_t GrassManager::getBytesPerBlade() const
+{
+    return m_instanceLayout == InstanceLayout::Packed ? sizeof(PackedGrassBlade)
+                                                      : sizeof(GrassBlade);
+}
+
+// Blade attributes are uploaded once and fetched in the shaders by index
+void GrassManager::uploadBlades()
+{
+    glGenBuffers(1, &m_bladeVBO);
+    glGenTextures(1, &m_bladeTexture);
+
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    // A streaming field rewrites a few cells every time the ring moves
+    GLenum usage = m_streaming ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+
+    // Packed blades name their cell in 16 bits, past that they'd decode against the wrong one
+    if (m_instanceLayout == InstanceLayout::Packed && m_cells.size() > 65536)
+    {
+        std::cerr << "Too many grass cells for the packed layout (" << m_cells.size()
+                  << "), falling back to floats. Larger cells keep it packed." << std::endl;
+        m_instanceLayout = InstanceLayout::Float;
+    }
+
+    if (m_instanceLayout == InstanceLayout::Float)
+    {
+        if (m_bladeCount * (sizeof(GrassBlade) / sizeof(float)) > static_cast<size_t>(maxTexels))
+        {
+            std::cerr << "Grass blade buffer exceeds GL_MAX_TEXTURE_BUFFER_SIZE (" << maxTexels
+                      << " texels)" << std::endl;
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_bladeVBO);
+        glBufferData(GL_ARRAY_BUFFER, m_bladeCount * sizeof(GrassBlade), m_grassBlades.data(),
+                     usage);
+        glBindTexture(GL_TEXTURE_BUFFER, m_bladeTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, m_bladeVBO);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    else
+    {
+        std::vector<glm::vec4> cellOrigins(m_cells.size());
+        std::vector<PackedGrassBlade> packed(m_bladeCount);
+        for (size_t c = 0; c < m_cells.size(); ++c)
+        {
+            int first = m_cells[c].firstBlade;
+            cellOrigins[c] = packCell(static_cast<int>(c), m_grassBlades.data() + first,
+                                      m_cells[c].bladeCount, packed.data() + first);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_bladeVBO);
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedGrassBlade), packed.data(),
+                     usage);
+        glBindTexture(GL_TEXTURE_BUFFER, m_bladeTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, m_bladeVBO);
+
+        glGenBuffers(1, &m_cellVBO);
+        glGenTextures(1, &m_cellTexture);
+        glBindBuffer(GL_ARRAY_BUFFER, m_cellVBO);
+        glBufferData(GL_ARRAY_BUFFER, cellOrigins.size() * sizeof(glm::vec4), cellOrigins.data(),
+                     usage);
+        glBindTexture(GL_TEXTURE_BUFFER, m_cellTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_cellVBO);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // Per visible blade the vertex stage fetches one record, per frame the CPU path uploads 4 bytes
+    size_t floatBytes = m_bladeCount * sizeof(GrassBlade);
+    size_t bufferBytes = m_bladeCount * getBytesPerBlade();
+    std::cout << fmt::format("Grass: {} blades, {} B/blade, {:.2f} MB blade buffer "
+                             "({:.2f} MB saved vs float layout, {:.0f}% less fetch per blade)",
+                             m_bladeCount, getBytesPerBlade(), bufferBytes / (1024.0 * 1024.0),
+                             (floatBytes - bufferBytes) / (1024.0 * 1024.0),
+                             100.0 * (1.0 - double(getBytesPerBlade()) / sizeof(GrassBlade)))
+              << std::endl;
+}
+
+// Packs the blades of one cell and returns its cell table entry: root min corner and the height
+// span the unorm16 y covers
+glm::vec4 GrassManager::packCell(int slot, const GrassBlade* blades, int count,
+                                 PackedGrassBlade* out) const
+{
+    const GrassCell& cell = m_cells[slot];
+    float rootMax = cell.boundsMin.y;
+    for (int i = 0; i < cell.bladeCount; ++i)
+        rootMax = std::max(rootMax, blades[i].position.y);
+    float span = rootMax - cell.boundsMin.y;
+
+    for (int i = 0; i < count; ++i)
+    {
+        const GrassBlade& blade = blades[i];
+        PackedGrassBlade& packed = out[i];
+        packed.x = packUnorm16((blade.position.x - cell.boundsMin.x) / m_cellSize);
+        packed.z = packUnorm16((blade.position.z - cell.boundsMin.z) / m_cellSize);
+        packed.y = span > 0.0f ? packUnorm16((blade.position.y - cell.boundsMin.y) / span) : 0;
+        packed.cell = static_cast<uint16_t>(slot);
+        packed.width = floatToHalf(blade.width);
+        packed.height = floatToHalf(blade.height);
+        packed.color[0] = packUnorm8(blade.color.r);
+        packed.color[1] = packUnorm8(blade.color.g);
+        packed.color[2] = packUnorm8(blade.color.b);
+        float turns = blade.rotation / 360.0f;
+        packed.rotation = static_cast<uint8_t>(std::lround((turns - std::floor(turns)) * 256.0f));
+    }
+    return glm::vec4(cell.boundsMin, span);
+}
+
+template <typename Program> void GrassManager::setBladeUniforms(const Program& program) const
+{
+    program.setBool("packedBlades", m_instanceLayout == InstanceLayout::Packed);
+    program.setInt("bladeData", 0);
+    program.setInt("packedBladeData", 1);
+    program.setInt("cellData", 2);
+    program.setFloat("cellSize", m_cellSize);
+}
+
+template <typename Program> void GrassManager::setLodUniforms(const Program& program) const
+{
+    program.setFloat("lodDistances[0]", m_lod.tierDistances[0]);
+    program.setFloat("lodDistances[1]", m_lod.tierDistances[1]);
+    program.setFloat("thinningStart", m_lod.thinningStart);
+    program.setFloat("thinningEnd", m_lod.thinningEnd);
+    program.setFloat("minDensity", m_lod.minDensity);
+}
+
+void GrassManager::setupGpuCulling()
+{
+    // Transform feedback: one point per blade in, indices of the survivors captured. The cull
+    // shader fetches the blade itself, so its VAO has no attributes.
+    glGenVertexArrays(1, &m_cullVAO);
+
+    glGenBuffers(1, &m_feedbackVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_feedbackVBO);
+    glBufferData(GL_ARRAY_BUFFER, m_bladeCount * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+
+    glGenVertexArrays(1, &m_feedbackVAO);
+    glBindVertexArray(m_feedbackVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_feedbackVBO);
+    setupIndexAttribute(0);
+    glBindVertexArray(0);
+
+    // glDrawTransformFeedback (GL 4.0, or ARB_transform_feedback2 on nearly every 3.3 driver)
+    // keeps the count on the GPU. Only drivers without either fall back to a query.
+    if (GLAD_GL_VERSION_4_0 || GLAD_GL_ARB_transform_feedback2)
+    {
+        glGenTransformFeedbacks(1, &m_feedback);
+        glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, m_feedback);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_feedbackVBO);
+        glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+    }
+    else
+    {
+        glGenQueries(1, &m_feedbackQuery);
+    }
+
+    m_feedbackCullProgram = ShaderBuilder()
+                                .load("shaders/grass_cull.vert.glsl", Shader::Type::Vertex)
+                                .load("shaders/grass_cull.geom.glsl", Shader::Type::Geometry)
+                                .feedback({ "outIndex" })
+                                .build();
+    m_feedbackDrawProgram = ShaderBuilder()
+                                .load("shaders/grass_points.vert.glsl", Shader::Type::Vertex)
+                                .load("shaders/grass.geom.glsl", Shader::Type::Geometry)
+                                .load("shaders/grass.frag.glsl", Shader::Type::Fragment)
+                                .build();
+
+    // Compute + indirect draw, only where the driver gives us GL 4.3
+    if (!GLAD_GL_VERSION_4_3)
+        return;
+
+    try
+    {
+        m_computeCullProgram = ShaderBuilder()
+                                   .load("shaders/grass_cull.comp.glsl", Shader::Type::Compute)
+                                   .build();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Compute grass culling unavailable: " << e.what() << std::endl;
+        return;
+    }
+
+    // One region of bladeCount indices and one draw command per LOD tier
+    glGenBuffers(1, &m_computeOutput);
+    glBindBuffer(GL_ARRAY_BUFFER, m_computeOutput);
+    glBufferData(GL_ARRAY_BUFFER, LOD_TIERS * m_bladeCount * sizeof(uint32_t), nullptr,
+                 GL_DYNAMIC_COPY);
+
+    glGenBuffers(1, &m_drawCommand);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_drawCommand);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, LOD_TIERS * 4 * sizeof(GLuint), nullptr,
                  GL_DYNAMIC_DRAW);
-    // Instance attributes
-    // Position
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(GrassBlade), (void*)0);
-    glVertexAttribDivisor(3, 1);
-    // Width
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(GrassBlade),
-                          (void*)offsetof(GrassBlade, width));
-    glVertexAttribDivisor(4, 1);
-    // Height
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(GrassBlade),
-                          (void*)offsetof(GrassBlade, height));
-    glVertexAttribDivisor(5, 1);
-    // Color
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(GrassBlade),
-                          (void*)offsetof(GrassBlade, color));
-    glVertexAttribDivisor(6, 1);
-    // Rotation
-    glEnableVertexAttribArray(7);
-    glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(GrassBlade),
-                          (void*)offsetof(GrassBlade, rotation));
-    glVertexAttribDivisor(7, 1);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 
+    glGenVertexArrays(1, &m_computeVAO);
+    glBindVertexArray(m_computeVAO);
+    setupMeshAttributes(m_VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, m_computeOutput);
+    setupIndexAttribute(1);
     glBindVertexArray(0);
+
+    m_computeSupported = true;
+}
+
+bool GrassManager::isCullModeSupported(CullMode mode) const
+{
+    return mode != CullMode::Compute || m_computeSupported;
+}
+
+void GrassManager::setCullMode(CullMode mode)
+{
+    if (isCullModeSupported(mode))
+        m_cullMode = mode;
 }
 
 void GrassManager::update(float deltaTime, const glm::vec3& windDirection)
@@ -108,26 +694,274 @@ void GrassManager::update(float deltaTime, const glm::vec3& windDirection)
     m_windDirection = windDirection;
 }
 
+// Corner where three frustum planes meet (n.x + d = 0 for each plane)
+static glm::vec3 intersectPlanes(const Camera::FrustumPlane& a, const Camera::FrustumPlane& b,
+                                 const Camera::FrustumPlane& c)
+{
+    glm::vec3 bc = glm::cross(b.normal, c.normal);
+    float denom = glm::dot(a.normal, bc);
+    return -(a.distance * bc + b.distance * glm::cross(c.normal, a.normal) +
+             c.distance * glm::cross(a.normal, b.normal)) /
+           denom;
+}
+
+GrassManager::CellVisibility
+GrassManager::classifyCell(const GrassCell& cell,
+                           const std::array<Camera::FrustumPlane, 6>& planes) const
+{
+    // Blades are tested by their root with a margin of their height, so grow the box the same way
+    // to keep the coarse and fine tests in agreement
+    glm::vec3 boundsMin = cell.boundsMin - glm::vec3(m_maxBladeHeight);
+    glm::vec3 boundsMax = cell.boundsMax + glm::vec3(m_maxBladeHeight);
+
+    CellVisibility result = CellVisibility::Inside;
+    for (const auto& plane : planes)
+    {
+        // Farthest and nearest box corners along the plane normal
+        glm::vec3 positive(plane.normal.x >= 0 ? boundsMax.x : boundsMin.x,
+                           plane.normal.y >= 0 ? boundsMax.y : boundsMin.y,
+                           plane.normal.z >= 0 ? boundsMax.z : boundsMin.z);
+        glm::vec3 negative(plane.normal.x >= 0 ? cell.boundsMin.x : cell.boundsMax.x,
+                           plane.normal.y >= 0 ? cell.boundsMin.y : cell.boundsMax.y,
+                           plane.normal.z >= 0 ? cell.boundsMin.z : cell.boundsMax.z);
+
+        if (glm::dot(plane.normal, positive) + plane.distance < 0.0f)
+            return CellVisibility::Outside;
+        if (glm::dot(plane.normal, negative) + plane.distance < 0.0f)
+            result = CellVisibility::Intersecting;
+    }
+    return result;
+}
+
+void GrassManager::CullGrassBlades(const std::array<Camera::FrustumPlane, 6>& planes,
+                                   const glm::vec3& viewPos)
+{
+    m_visibleCount = 0;
+    m_visibleCells = 0;
+    for (int tier = 0; tier < LOD_TIERS; ++tier)
+    {
+        m_tierCells[tier].clear();
+        m_tierCounts[tier] = 0;
+    }
+    if (m_cells.empty())
+        return;
+
+    // Only walk the cells under the frustum's footprint on the ground plane.
+    // Plane order: left, right, bottom, top, near, far
+    glm::vec2 footprintMin(std::numeric_limits<float>::max());
+    glm::vec2 footprintMax(std::numeric_limits<float>::lowest());
+    for (int depth = 4; depth < 6; ++depth)
+    {
+        for (int side = 0; side < 2; ++side)
+        {
+            for (int vertical = 2; vertical < 4; ++vertical)
+            {
+                glm::vec3 corner = intersectPlanes(planes[depth], planes[side], planes[vertical]);
+                footprintMin = glm::min(footprintMin, glm::vec2(corner.x, corner.z));
+                footprintMax = glm::max(footprintMax, glm::vec2(corner.x, corner.z));
+            }
+        }
+    }
+    footprintMin -= glm::vec2(m_maxBladeHeight) + m_gridOrigin;
+    footprintMax += glm::vec2(m_maxBladeHeight) - m_gridOrigin;
+
+    int minX = std::max(0, static_cast<int>(std::floor(footprintMin.x / m_cellSize)));
+    int minZ = std::max(0, static_cast<int>(std::floor(footprintMin.y / m_cellSize)));
+    int maxX = std::min(m_gridWidth - 1, static_cast<int>(std::floor(footprintMax.x / m_cellSize)));
+    int maxZ = std::min(m_gridDepth - 1, static_cast<int>(std::floor(footprintMax.y / m_cellSize)));
+
+    // Each cell takes the tier and density of its nearest point to the camera
+    for (int cz = minZ; cz <= maxZ; ++cz)
+    {
+        for (int cx = minX; cx <= maxX; ++cx)
+        {
+            int index = cellSlot(cx, cz);
+            const GrassCell& cell = m_cells[index];
+            if (cell.bladeCount == 0)
+                continue;
+
+            CellVisibility visibility = classifyCell(cell, planes);
+            if (visibility == CellVisibility::Outside)
+                continue;
+
+            m_visibleCells++;
+            float distance =
+                glm::distance(viewPos, glm::clamp(viewPos, cell.boundsMin, cell.boundsMax));
+            // Jittered scatter shuffles each cell's blades, so keeping a prefix thins it evenly
+            int kept = static_cast<int>(std::ceil(cell.bladeCount * m_lod.densityAt(distance)));
+            m_tierCells[m_lod.tierAt(distance)].push_back({ index, kept, visibility });
+        }
+    }
+
+    // Emit tier by tier so each tier is one contiguous range of visibleIndices
+    for (int tier = 0; tier < LOD_TIERS; ++tier)
+    {
+        size_t tierStart = m_visibleCount;
+        for (const VisibleCell& visible : m_tierCells[tier])
+        {
+            const GrassCell& cell = m_cells[visible.cell];
+            uint32_t* out = visibleIndices.data() + m_visibleCount;
+            if (visible.visibility == CellVisibility::Inside)
+            {
+                for (int i = 0; i < visible.bladeCount; ++i)
+                    out[i] = static_cast<uint32_t>(cell.firstBlade + i);
+                m_visibleCount += visible.bladeCount;
+                continue;
+            }
+
+            // Straddling cell: fall back to the per-blade test
+            m_visibleCount +=
+                m_cullKernel(m_cullData, cell.firstBlade, visible.bladeCount, planes, out);
+        }
+        m_tierCounts[tier] = m_visibleCount - tierStart;
+    }
+}
+
+static void setFrustumUniforms(const ShaderProgram& program,
+                               const std::array<Camera::FrustumPlane, 6>& planes)
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        program.setVec4(fmt::format("frustumPlanes[{}]", i),
+                        glm::vec4(planes[i].normal, planes[i].distance));
+    }
+}
+
+void GrassManager::cullWithFeedback(const std::array<Camera::FrustumPlane, 6>& planes,
+                                    const glm::vec3& viewPos)
+{
+    m_feedbackCullProgram.use();
+    m_feedbackCullProgram.setVec3("viewPos", viewPos);
+    setFrustumUniforms(m_feedbackCullProgram, planes);
+    setBladeUniforms(m_feedbackCullProgram);
+    setLodUniforms(m_feedbackCullProgram);
+
+    if (m_feedback != 0)
+    {
+        glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, m_feedback);
+    }
+    else
+    {
+        // Pick up an earlier frame's count once it's ready instead of stalling on it. It lags a
+        // frame or more behind the indices written below, so while the visible set changes the
+        // draw is short a few blades or repeats stale ones past the new end.
+        if (m_feedbackQueryPending)
+        {
+            GLuint available = 0;
+            glGetQueryObjectuiv(m_feedbackQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+            {
+                GLuint written = 0;
+                glGetQueryObjectuiv(m_feedbackQuery, GL_QUERY_RESULT, &written);
+                m_feedbackCount = static_cast<GLsizei>(written);
+                m_feedbackQueryPending = false;
+            }
+        }
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_feedbackVBO);
+        if (!m_feedbackQueryPending)
+            glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, m_feedbackQuery);
+    }
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(m_cullVAO);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(m_bladeCount));
+    glEndTransformFeedback();
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    if (m_feedback != 0)
+    {
+        glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+    }
+    else if (!m_feedbackQueryPending)
+    {
+        glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+        m_feedbackQueryPending = true;
+    }
+}
+
+void GrassManager::cullWithCompute(const std::array<Camera::FrustumPlane, 6>& planes,
+                                   const glm::vec3& viewPos)
+{
+    // Reset the instance counts, the shader bumps its tier's count for each survivor
+    GLuint commands[LOD_TIERS][4];
+    for (int tier = 0; tier < LOD_TIERS; ++tier)
+    {
+        commands[tier][0] = static_cast<GLuint>(m_tierVertexCount[tier]);
+        commands[tier][1] = 0;
+        commands[tier][2] = static_cast<GLuint>(m_tierFirstVertex[tier]);
+        commands[tier][3] = 0;
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_drawCommand);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(commands), commands);
+
+    m_computeCullProgram.use();
+    glUniform1ui(glGetUniformLocation(m_computeCullProgram.id(), "bladeCount"),
+                 static_cast<GLuint>(m_bladeCount));
+    m_computeCullProgram.setVec3("viewPos", viewPos);
+    setFrustumUniforms(m_computeCullProgram, planes);
+    setBladeUniforms(m_computeCullProgram);
+    setLodUniforms(m_computeCullProgram);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_computeOutput);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_drawCommand);
+    glDispatchCompute(static_cast<GLuint>((m_bladeCount + 255) / 256), 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
 void GrassManager::render(const glm::mat4& view, const glm::mat4& projection,
                           const glm::vec3& viewPos,
                           const std::array<Camera::FrustumPlane, 6>& frustumPlanes)
 {
-    // Only update if view has changed
-    static glm::mat4 lastView;
-    static glm::vec3 lastPos;
-    glm::vec3 currentPos = glm::vec3(view[3]);
+    // Float and packed blades use different sampler types, so they get separate units
+    if (m_instanceLayout == InstanceLayout::Packed)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_BUFFER, m_bladeTexture);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_BUFFER, m_cellTexture);
+    }
+    else
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, m_bladeTexture);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    if (m_cullMode == CullMode::TransformFeedback)
+    {
+        cullWithFeedback(frustumPlanes, viewPos);
+
+        m_feedbackDrawProgram.use();
+        m_feedbackDrawProgram.setMat4("view", view);
+        m_feedbackDrawProgram.setMat4("projection", projection);
+        m_feedbackDrawProgram.setVec3("viewPos", viewPos);
+        m_feedbackDrawProgram.setFloat("time", m_time);
+        m_feedbackDrawProgram.setVec3("windDirection", m_windDirection);
+        m_feedbackDrawProgram.setFloat("windStrength", m_windStrength);
+        setBladeUniforms(m_feedbackDrawProgram);
+        setLodUniforms(m_feedbackDrawProgram);
 
-    // Check position change magnitude (more reliable than matrix comparison)
-    if (glm::length(currentPos - lastPos) > 0.1f)
+        glBindVertexArray(m_feedbackVAO);
+        if (m_feedback != 0)
+            glDrawTransformFeedback(GL_POINTS, m_feedback);
+        else
+            glDrawArrays(GL_POINTS, 0, m_feedbackCount);
+        return;
+    }
+
+    if (m_cullMode == CullMode::Compute)
+    {
+        cullWithCompute(frustumPlanes, viewPos);
+    }
+    else
     {
-        CullGrassBlades(frustumPlanes);
-        lastView = view;
-        lastPos = currentPos;
+        // Cells make culling cheap enough to redo every frame, so rotation alone is handled too
+        CullGrassBlades(frustumPlanes, viewPos);
 
-        // Only upload when culling changes
         glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, visibleBlades.size() * sizeof(GrassBlade),
-                        visibleBlades.data());
+        glBufferSubData(GL_ARRAY_BUFFER, 0, m_visibleCount * sizeof(uint32_t),
+                        visibleIndices.data());
     }
 
     // Render instances
@@ -138,7 +972,34 @@ void GrassManager::render(const glm::mat4& view, const glm::mat4& projection,
     m_grassShader.setFloat("time", m_time);
     m_grassShader.setVec3("windDirection", m_windDirection);
     m_grassShader.setFloat("windStrength", m_windStrength);
+    setBladeUniforms(m_grassShader);
+    setLodUniforms(m_grassShader);
+
+    // One draw per tier, each with its own mesh and its own range of the index buffer
+    if (m_cullMode == CullMode::Compute)
+    {
+        glBindVertexArray(m_computeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_computeOutput);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_drawCommand);
+        for (int tier = 0; tier < LOD_TIERS; ++tier)
+        {
+            setupIndexAttribute(1, tier * m_bladeCount);
+            glDrawArraysIndirect(GL_TRIANGLES, (void*)(tier * 4 * sizeof(GLuint)));
+        }
+        return;
+    }
 
     glBindVertexArray(m_VAO);
-    glDrawArraysInstanced(GL_TRIANGLES, 0, 3, visibleBlades.size());
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+    size_t tierStart = 0;
+    for (int tier = 0; tier < LOD_TIERS; ++tier)
+    {
+        if (m_tierCounts[tier] > 0)
+        {
+            setupIndexAttribute(1, tierStart);
+            glDrawArraysInstanced(GL_TRIANGLES, m_tierFirstVertex[tier], m_tierVertexCount[tier],
+                                  static_cast<GLsizei>(m_tierCounts[tier]));
+        }
+        tierStart += m_tierCounts[tier];
+    }
 }
\ No newline at end of file
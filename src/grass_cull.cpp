@@ -0,0 +1,217 @@
+#include "grass_cull.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GRASS_CULL_X86 1
+#endif
+
+size_t cullBladesScalar(const GrassCullData& data, size_t first, size_t count,
+                        const std::array<Camera::FrustumPlane, 6>& planes, uint32_t* out)
+{
+    const float* xs = data.x.data();
+    const float* ys = data.y.data();
+    const float* zs = data.z.data();
+    const float* hs = data.height.data();
+
+    size_t written = 0;
+    for (size_t i = first; i < first + count; ++i)
+    {
+        // Branch-free: evaluate every plane instead of breaking out early
+        bool visible = true;
+        for (const auto& plane : planes)
+        {
+            float d = plane.normal.x * xs[i] + plane.normal.y * ys[i] + plane.normal.z * zs[i] +
+                      plane.distance + hs[i];
+            visible &= d >= 0.0f;
+        }
+        out[written] = static_cast<uint32_t>(i);
+        written += visible;
+    }
+    return written;
+}
+
+#ifdef GRASS_CULL_X86
+
+namespace
+{
+// Byte shuffles that pack the selected 32-bit lanes of a 4-lane mask to the front
+struct CompressTable4
+{
+    alignas(16) uint8_t shuffle[16][16];
+
+    CompressTable4()
+    {
+        for (int mask = 0; mask < 16; ++mask)
+        {
+            int lane = 0;
+            for (int bit = 0; bit < 4; ++bit)
+            {
+                if (mask & (1 << bit))
+                {
+                    for (int b = 0; b < 4; ++b)
+                        shuffle[mask][lane * 4 + b] = static_cast<uint8_t>(bit * 4 + b);
+                    lane++;
+                }
+            }
+            for (; lane < 4; ++lane)
+                for (int b = 0; b < 4; ++b)
+                    shuffle[mask][lane * 4 + b] = 0x80;
+        }
+    }
+};
+
+// Lane permutations for _mm256_permutevar8x32_epi32, same idea for 8 lanes
+struct CompressTable8
+{
+    alignas(32) uint32_t permute[256][8];
+
+    CompressTable8()
+    {
+        for (int mask = 0; mask < 256; ++mask)
+        {
+            int lane = 0;
+            for (int bit = 0; bit < 8; ++bit)
+            {
+                if (mask & (1 << bit))
+                    permute[mask][lane++] = bit;
+            }
+            for (; lane < 8; ++lane)
+                permute[mask][lane] = 0;
+        }
+    }
+};
+
+const CompressTable4 compressTable4;
+const CompressTable8 compressTable8;
+} // namespace
+
+__attribute__((target("sse4.1,popcnt"))) size_t
+cullBladesSSE(const GrassCullData& data, size_t first, size_t count,
+              const std::array<Camera::FrustumPlane, 6>& planes, uint32_t* out)
+{
+    const float* xs = data.x.data();
+    const float* ys = data.y.data();
+    const float* zs = data.z.data();
+    const float* hs = data.height.data();
+
+    __m128 nx[6], ny[6], nz[6], nd[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        nx[p] = _mm_set1_ps(planes[p].normal.x);
+        ny[p] = _mm_set1_ps(planes[p].normal.y);
+        nz[p] = _mm_set1_ps(planes[p].normal.z);
+        nd[p] = _mm_set1_ps(planes[p].distance);
+    }
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128i laneOffsets = _mm_setr_epi32(0, 1, 2, 3);
+    const size_t end = first + count;
+
+    size_t written = 0;
+    size_t i = first;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+        __m128 z = _mm_loadu_ps(zs + i);
+        __m128 h = _mm_loadu_ps(hs + i);
+
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m128 d = _mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y));
+            d = _mm_add_ps(d, _mm_mul_ps(nz[p], z));
+            d = _mm_add_ps(d, _mm_add_ps(nd[p], h));
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(d, zero));
+        }
+
+        int mask = _mm_movemask_ps(visible);
+        __m128i indices = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(i)), laneOffsets);
+        __m128i shuffle =
+            _mm_load_si128(reinterpret_cast<const __m128i*>(compressTable4.shuffle[mask]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written),
+                         _mm_shuffle_epi8(indices, shuffle));
+        written += _mm_popcnt_u32(mask);
+    }
+
+    return written + cullBladesScalar(data, i, end - i, planes, out + written);
+}
+
+__attribute__((target("avx2,fma,popcnt"))) size_t
+cullBladesAVX2(const GrassCullData& data, size_t first, size_t count,
+               const std::array<Camera::FrustumPlane, 6>& planes, uint32_t* out)
+{
+    const float* xs = data.x.data();
+    const float* ys = data.y.data();
+    const float* zs = data.z.data();
+    const float* hs = data.height.data();
+
+    __m256 nx[6], ny[6], nz[6], nd[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        nx[p] = _mm256_set1_ps(planes[p].normal.x);
+        ny[p] = _mm256_set1_ps(planes[p].normal.y);
+        nz[p] = _mm256_set1_ps(planes[p].normal.z);
+        nd[p] = _mm256_set1_ps(planes[p].distance);
+    }
+
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const size_t end = first + count;
+
+    size_t written = 0;
+    size_t i = first;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 y = _mm256_loadu_ps(ys + i);
+        __m256 z = _mm256_loadu_ps(zs + i);
+        __m256 h = _mm256_loadu_ps(hs + i);
+
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 d = _mm256_fmadd_ps(nx[p], x, _mm256_add_ps(nd[p], h));
+            d = _mm256_fmadd_ps(ny[p], y, d);
+            d = _mm256_fmadd_ps(nz[p], z, d);
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(visible);
+        __m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), laneOffsets);
+        __m256i permute =
+            _mm256_load_si256(reinterpret_cast<const __m256i*>(compressTable8.permute[mask]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + written),
+                            _mm256_permutevar8x32_epi32(indices, permute));
+        written += _mm_popcnt_u32(mask);
+    }
+
+    return written + cullBladesScalar(data, i, end - i, planes, out + written);
+}
+
+#endif
+
+GrassCullKernel selectGrassCullKernel()
+{
+#ifdef GRASS_CULL_X86
+    __builtin_cpu_init();
+    // Both kernels count survivors with popcnt, which SSE4.1 doesn't imply
+    bool popcnt = __builtin_cpu_supports("popcnt");
+    if (popcnt && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return cullBladesAVX2;
+    if (popcnt && __builtin_cpu_supports("sse4.1"))
+        return cullBladesSSE;
+#endif
+    return cullBladesScalar;
+}
+
+const char* grassCullKernelName(GrassCullKernel kernel)
+{
+#ifdef GRASS_CULL_X86
+    if (kernel == cullBladesAVX2)
+        return "AVX2";
+    if (kernel == cullBladesSSE)
+        return "SSE4.1";
+#endif
+    return "Scalar";
+}
@@ -4,11 +4,11 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
-#include <map>
 #include <algorithm>
 #include <vector>
 #include <cstdlib>
 #include <ctime>
+#include <filesystem>
 #include "shader.h"
 
 #include "imgui/imgui.h"
@@ -20,13 +20,23 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "tiny_gltf.h"
 
-// FastNoiseLite for procedural generation
-#define FASTNOISE_LITE_IMPLEMENTATION
-#include "FastNoiseLite.h"
-
+#include "animation.h"
+#include "animation_compression.h"
+#include "asset_streamer.h"
+#include "bench.h"
 #include "camera.h"
+#include "cooked_model.h"
+#include "crowd.h"
 #include "grass.h"
+#include "mesh_pool.h"
 #include "player.h"
+#include "prop_renderer.h"
+#include "scatter.h"
+#include "skinning.h"
+#include "terrain.h"
+#include "texture_cache.h"
+#include "thread_pool.h"
+#include "transform_hierarchy.h"
 
 // Global variables
 const int SCR_WIDTH = 1280;
@@ -38,116 +48,6 @@ float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
-// Helper function to extract transformation from a glTF node
-glm::mat4 getNodeTransform(const tinygltf::Node& node)
-{
-    glm::mat4 transform = glm::mat4(1.0f);
-
-    // Apply translation
-    if (node.translation.size() >= 3)
-    {
-        transform = glm::translate(
-            transform, glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
-    }
-
-    // Apply rotation (quaternion)
-    if (node.rotation.size() >= 4)
-    {
-        glm::quat rot(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
-        transform = transform * glm::mat4_cast(rot);
-    }
-
-    // Apply scale
-    if (node.scale.size() >= 3)
-    {
-        transform = glm::scale(transform, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
-    }
-
-    // Apply matrix (if present, overrides the above)
-    if (node.matrix.size() >= 16)
-    {
-        glm::mat4 matrix;
-        for (int i = 0; i < 4; ++i)
-        {
-            for (int j = 0; j < 4; ++j)
-            {
-                matrix[i][j] = node.matrix[i * 4 + j];
-            }
-        }
-        transform = matrix;
-    }
-
-    return transform;
-}
-
-// Helper function to traverse scene hierarchy and build mesh transformations
-void traverseScene(const tinygltf::Model& model, int nodeIndex,
-                   const std::vector<glm::mat4>& nodeTransforms, glm::mat4 parentTransform,
-                   std::map<int, glm::mat4>& meshTransforms)
-{
-    if (nodeIndex < 0 || nodeIndex >= model.nodes.size())
-    {
-        return;
-    }
-
-    const tinygltf::Node& node = model.nodes[nodeIndex];
-    glm::mat4 localTransform = nodeTransforms[nodeIndex];
-    glm::mat4 worldTransform = parentTransform * localTransform;
-
-    // If this node has a mesh, store its world transformation
-    if (node.mesh >= 0)
-    {
-        meshTransforms[node.mesh] = worldTransform;
-        //std::cout << "Found mesh " << node.mesh << " at node " << nodeIndex << std::endl;
-    }
-
-    // Traverse children
-    for (int childIndex : node.children)
-    {
-        traverseScene(model, childIndex, nodeTransforms, worldTransform, meshTransforms);
-    }
-}
-
-// Helper function to build complete transformation matrix for a node (including parents)
-glm::mat4 buildNodeTransform(const tinygltf::Model& model, int nodeIndex,
-                             const std::vector<glm::mat4>& nodeTransforms)
-{
-    if (nodeIndex < 0 || nodeIndex >= model.nodes.size())
-    {
-        return glm::mat4(1.0f);
-    }
-
-    const tinygltf::Node& node = model.nodes[nodeIndex];
-    glm::mat4 localTransform = nodeTransforms[nodeIndex];
-
-    // Find parent node
-    int parentIndex = -1;
-    for (size_t i = 0; i < model.nodes.size(); ++i)
-    {
-        const auto& potentialParent = model.nodes[i];
-        for (int child : potentialParent.children)
-        {
-            if (child == nodeIndex)
-            {
-                parentIndex = i;
-                break;
-            }
-        }
-        if (parentIndex != -1)
-            break;
-    }
-
-    // If no parent, return local transform
-    if (parentIndex == -1)
-    {
-        return localTransform;
-    }
-
-    // Recursively get parent transform and combine
-    glm::mat4 parentTransform = buildNodeTransform(model, parentIndex, nodeTransforms);
-    return parentTransform * localTransform;
-}
-
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
@@ -192,124 +92,68 @@ struct CameraBufferObject
     float _pad = 0.0f; // Padding to align to 16 bytes
 };
 
-struct AnimSampler
-{
-    std::vector<float> input;
-    std::vector<glm::vec4> output;
-    std::string interpolation;
-};
+std::vector<CompressedClip> animations;
+AnimationCursor animationCursor;
+std::vector<glm::vec4> channelValues;
+float animationTime = 0.0f;
 
-struct AnimChannel
+void updateAnimation(float deltaTime, TransformHierarchy& hierarchy)
 {
-    int targetNode;
-    std::string path; // "translation", "rotation", "scale"
-    AnimSampler sampler;
-};
+    if (animations.empty())
+        return;
 
-struct Animation
-{
-    std::string name;
-    std::vector<AnimChannel> channels;
-};
+    animationTime += deltaTime;
 
-std::vector<Animation> animations;
-float animationTime = 0.0f;
+    const CompressedClip& clip = animations[0]; // just play the first animation for now
+    if (clip.duration <= 0.0f)
+        return;
 
-template <typename T>
-std::vector<T> readAccessorVec(const tinygltf::Model& model, const tinygltf::Accessor& accessor)
-{
-    const auto& bufferView = model.bufferViews[accessor.bufferView];
-    const auto& buffer = model.buffers[bufferView.buffer];
-    const uint8_t* data = buffer.data.data() + bufferView.byteOffset + accessor.byteOffset;
+    channelValues.resize(clip.channels.size());
+    sampleCompressedClip(clip, fmod(animationTime, clip.duration), &animationCursor,
+                         channelValues.data());
 
-    std::vector<T> values(accessor.count);
-    memcpy(values.data(), data, accessor.count * sizeof(T));
-    return values;
+    applyChannels(clip.channels, channelValues.data(), hierarchy);
+    hierarchy.update();
 }
 
-int findKeyframe(const std::vector<float>& times, float time)
+int main(int argc, char** argv)
 {
-    for (size_t i = 0; i < times.size() - 1; ++i)
-        if (time >= times[i] && time <= times[i + 1])
-            return i;
-    return 0;
-}
-
-glm::vec4 interpolate(const std::vector<float>& times, const std::vector<glm::vec4>& values,
-                      float time, const std::string& path)
-{
-    if (times.empty())
-        return values[0];
-    if (time <= times.front())
-        return values.front();
-    if (time >= times.back())
-        return values.back();
-
-    int index = findKeyframe(times, time);
-    float t0 = times[index];
-    float t1 = times[index + 1];
-    float alpha = (time - t0) / (t1 - t0);
-
-    const glm::vec4& v0 = values[index];
-    const glm::vec4& v1 = values[index + 1];
-
-    if (path == "rotation")
+    if (argc > 1 && std::string(argv[1]) == "--bench")
     {
-        return glm::mix(v0, v1, alpha); // vec4, assumes w is last
+        return runBenchmarks(std::vector<std::string>(argv + 2, argv + argc));
     }
-    else
+    // Offline: cook a model once so the game maps it instead of loading the glTF
+    if (argc > 1 && std::string(argv[1]) == "--cook")
     {
-        return glm::mix(v0, v1, alpha);
-    }
-}
-
-void updateAnimation(float deltaTime, tinygltf::Model& model, std::vector<glm::mat4>& nodeMatrices,
-                     std::map<int, glm::mat4> meshTransforms)
-{
-    if (animations.empty())
-        return;
-
-    animationTime += deltaTime;
-
-    Animation& anim = animations[0]; // just play the first animation for now
-
-    for (const auto& channel : anim.channels)
-    {
-        int nodeIndex = channel.targetNode;
-        const auto& sampler = channel.sampler;
-
-        glm::vec4 value = interpolate(sampler.input, sampler.output,
-                                      fmod(animationTime, sampler.input.back()), channel.path);
-
-        auto& node = model.nodes[nodeIndex];
-        if (channel.path == "translation")
-        {
-            node.translation = { value.x, value.y, value.z };
-        }
-        else if (channel.path == "rotation")
+        if (argc < 3)
         {
-            node.rotation = { value.x, value.y, value.z, value.w };
+            std::cerr << "Usage: sven --cook <model.glb|model.gltf> [out.cooked]" << std::endl;
+            return 1;
         }
-        else if (channel.path == "scale")
+        std::filesystem::path out = argc > 3 ? argv[3] : argv[2];
+        if (argc == 3)
+            out.replace_extension(".cooked");
+        std::vector<uint8_t> blob;
+        if (!cookModel(argv[2], blob))
+            return 1;
+        if (!writeCookedModel(out.string(), blob))
         {
-            node.scale = { value.x, value.y, value.z };
+            std::cerr << "Failed to write " << out.string() << std::endl;
+            return 1;
         }
+        std::cout << "Cooked " << argv[2] << " into " << out.string() << ", " << blob.size() / 1024
+                  << " KB" << std::endl;
+        return 0;
     }
 
-    // Recompute all local node matrices
-    nodeMatrices.clear();
-    for (const auto& node : model.nodes)
-        nodeMatrices.push_back(getNodeTransform(node)); // your existing helper
-
-    // Recompute world transforms
-    meshTransforms.clear();
-    const auto& defaultScene = model.scenes[model.defaultScene >= 0 ? model.defaultScene : 0];
-    for (int rootNodeIndex : defaultScene.nodes)
-        traverseScene(model, rootNodeIndex, nodeMatrices, glm::mat4(1.0f), meshTransforms);
-}
+    // Same seed, same world: grass and props are bit-identical between runs
+    uint64_t worldSeed = 1;
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--seed")
+            worldSeed = std::strtoull(argv[i + 1], nullptr, 10);
+    }
 
-int main()
-{
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -345,258 +189,62 @@ int main()
 
     Shader shader("shaders/vertex.glsl", "shaders/fragment.glsl");
 
-    // Load GLTF model
-    tinygltf::Model model;
-    tinygltf::TinyGLTF loader;
-    std::string err, warn;
-
     // Player model
     Player player(glm::vec3(0.0f, 15.0f, 15.0f)); // Start above terrain
 
-    bool ret = loader.LoadBinaryFromFile(&model, &err, &warn, "Assets/Characters/gltf/Knight.glb");
-
-    if (!warn.empty())
-        std::cout << "Warn: " << warn << std::endl;
-    if (!err.empty())
-        std::cerr << "Err: " << err << std::endl;
+    // One texture per distinct image, however many models and characters use it
+    TextureCache textureCache;
 
-    if (!ret)
+    // Cooked on first run, mapped from then on
+    CookedModel model;
+    if (!loadCookedModel("Assets/Characters/gltf/Knight.glb", model))
     {
-        std::cerr << "Failed to load glTF" << std::endl;
+        std::cerr << "Failed to load the player model" << std::endl;
         return -1;
     }
 
-    // Load all meshes from the glTF file
-    std::vector<GLuint> vaos;
-    std::vector<GLuint> vbos;
-    std::vector<GLuint> ebos;
-    std::vector<size_t> indexCounts;
-    std::vector<GLenum> indexTypes;
-    std::vector<glm::mat4> localTransforms; // Store local transformations
-
-    // First, build local transformations for all nodes
-    std::vector<glm::mat4> nodeTransforms;
-    for (const auto& node : model.nodes)
-    {
-        nodeTransforms.push_back(getNodeTransform(node));
-    }
-
-    // Build complete transformations for each mesh
-    std::map<int, glm::mat4> meshTransforms;
-
-    // Traverse the scene hierarchy starting from scene root nodes
-    if (!model.scenes.empty())
+    TransformHierarchy hierarchy;
+    hierarchy.build(model.getNodes(), model.getNodeCount());
+
+    // Palettes are built from the first skin, the characters only have the one. Meshes hanging
+    // from plain nodes (weapons, hats) were given a palette entry each after the joints by the
+    // cooker, holding their node's world matrix, so the whole character is one draw with no per
+    // mesh uniforms.
+    Skin skin = model.getSkin();
+    std::vector<int> attachmentNodes(model.getAttachments(),
+                                     model.getAttachments() + model.getAttachmentCount());
+    std::vector<glm::mat4> jointPalette;
+    JointPaletteBuffer jointPaletteBuffer;
+    jointPaletteBuffer.initialize();
+    bindJointPaletteBlock(shader.ID);
+
+    // The cooked vertices and indices go to the pool straight from the mapping
+    MeshPool meshPool;
+    meshPool.initialize(VertexFormat::Skinned);
+    VertexQuantization characterQuantization = model.getQuantization();
+    MeshRange characterMesh = meshPool.add(model.getVertices(), model.getVertexCount(),
+                                           model.getIndices(), model.getIndexCount());
+    // Parts sharing a texture draw together, in one multi-draw where they aren't adjacent
+    std::vector<int> batchTextures;
+    std::vector<std::pair<GLuint, std::vector<MeshRange>>> characterBatches;
+    for (const CookedPart& part : model.getMaterialBatches())
     {
-        const auto& defaultScene = model.scenes[model.defaultScene >= 0 ? model.defaultScene : 0];
-        for (int rootNodeIndex : defaultScene.nodes)
+        MeshRange range = characterMesh;
+        range.firstIndex += part.firstIndex;
+        range.indexCount = part.indexCount;
+        auto batch = std::find(batchTextures.begin(), batchTextures.end(), part.texture);
+        if (batch == batchTextures.end())
         {
-            traverseScene(model, rootNodeIndex, nodeTransforms, glm::mat4(1.0f), meshTransforms);
-        }
-    }
-    else
-    {
-        // Fallback: traverse all nodes that don't have parents
-        for (size_t nodeIndex = 0; nodeIndex < model.nodes.size(); ++nodeIndex)
-        {
-            const auto& node = model.nodes[nodeIndex];
-            if (node.mesh >= 0)
-            { // This node has a mesh
-                glm::mat4 completeTransform = buildNodeTransform(model, nodeIndex, nodeTransforms);
-                meshTransforms[node.mesh] = completeTransform;
-            }
+            batch = batchTextures.insert(batch, part.texture);
+            characterBatches.emplace_back(model.loadTexture(part.texture, textureCache),
+                                          std::vector<MeshRange>());
         }
+        characterBatches[batch - batchTextures.begin()].second.push_back(range);
     }
 
-    if (!model.scenes.empty())
-    {
-        const auto& defaultScene = model.scenes[model.defaultScene >= 0 ? model.defaultScene : 0];
-    }
-
-    for (size_t meshIndex = 0; meshIndex < model.meshes.size(); ++meshIndex)
-    {
-        const auto& mesh = model.meshes[meshIndex];
-
-        // Get the transformation for this mesh
-        glm::mat4 meshTransform = glm::mat4(1.0f);
-        auto transformIt = meshTransforms.find(meshIndex);
-        if (transformIt != meshTransforms.end())
-        {
-            meshTransform = transformIt->second;
-        }
-
-        for (const auto& primitive : mesh.primitives)
-        {
-            // Check if required attributes exist
-            auto posIt = primitive.attributes.find("POSITION");
-            auto texIt = primitive.attributes.find("TEXCOORD_0");
-            if (posIt == primitive.attributes.end() || texIt == primitive.attributes.end())
-            {
-                std::cerr << "Skipping primitive with missing attributes" << std::endl;
-                continue;
-            }
-
-            // Store the mesh transformation
-            localTransforms.push_back(meshTransform);
-
-            // Positions
-            const tinygltf::Accessor& posAccessor = model.accessors[posIt->second];
-            const tinygltf::BufferView& posView = model.bufferViews[posAccessor.bufferView];
-            const tinygltf::Buffer& posBuffer = model.buffers[posView.buffer];
-            const float* positions = reinterpret_cast<const float*>(
-                &(posBuffer.data[posView.byteOffset + posAccessor.byteOffset]));
-
-            // Indices
-            const tinygltf::Accessor& idxAccessor = model.accessors[primitive.indices];
-            const tinygltf::BufferView& idxView = model.bufferViews[idxAccessor.bufferView];
-            const tinygltf::Buffer& idxBuffer = model.buffers[idxView.buffer];
-            const void* indices = &(idxBuffer.data[idxView.byteOffset + idxAccessor.byteOffset]);
-
-            // Texture coordinates
-            const tinygltf::Accessor& texAccessor = model.accessors[texIt->second];
-            const tinygltf::BufferView& texView = model.bufferViews[texAccessor.bufferView];
-            const tinygltf::Buffer& texBuffer = model.buffers[texView.buffer];
-            const float* texcoords = reinterpret_cast<const float*>(
-                &(texBuffer.data[texView.byteOffset + texAccessor.byteOffset]));
-
-            // Create OpenGL buffers for this primitive
-            GLuint vao, vbo, ebo;
-            glGenVertexArrays(1, &vao);
-            glGenBuffers(1, &vbo);
-            glGenBuffers(1, &ebo);
-
-            glBindVertexArray(vao);
-
-            // Interleave vertex data
-            std::vector<float> vertexData;
-            for (size_t i = 0; i < posAccessor.count; ++i)
-            {
-                vertexData.push_back(positions[i * 3 + 0]);
-                vertexData.push_back(positions[i * 3 + 1]);
-                vertexData.push_back(positions[i * 3 + 2]);
-                vertexData.push_back(texcoords[i * 2 + 0]);
-                vertexData.push_back(texcoords[i * 2 + 1]);
-            }
-
-            glBindBuffer(GL_ARRAY_BUFFER, vbo);
-            glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(float), vertexData.data(),
-                         GL_STATIC_DRAW);
-
-            // Position
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-            glEnableVertexAttribArray(0);
-            // TexCoord
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
-                                  (void*)(3 * sizeof(float)));
-            glEnableVertexAttribArray(1);
-
-            // Indices
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-            GLenum indexType = idxAccessor.componentType;
-            size_t indexSize =
-                (indexType == GL_UNSIGNED_SHORT) ? sizeof(uint16_t) : sizeof(uint32_t);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, idxAccessor.count * indexSize, indices,
-                         GL_STATIC_DRAW);
-
-            glBindVertexArray(0);
-
-            // Store for rendering
-            vaos.push_back(vao);
-            vbos.push_back(vbo);
-            ebos.push_back(ebo);
-            indexCounts.push_back(idxAccessor.count);
-            indexTypes.push_back(indexType);
-        }
-    }
-
-    // Load texture (assuming all primitives use the same texture for now)
-    GLuint textureID = 0;
-    if (!model.meshes.empty() && !model.meshes[0].primitives.empty())
-    {
-        const auto& primitive = model.meshes[0].primitives[0];
-        if (primitive.material >= 0)
-        {
-            int materialIndex = primitive.material;
-            const tinygltf::Material& material = model.materials[materialIndex];
-            if (material.pbrMetallicRoughness.baseColorTexture.index >= 0)
-            {
-                int baseColorTextureIndex = material.pbrMetallicRoughness.baseColorTexture.index;
-                const tinygltf::Texture& tex = model.textures[baseColorTextureIndex];
-                const tinygltf::Image& image = model.images[tex.source];
-
-                // Upload to OpenGL
-                glGenTextures(1, &textureID);
-                glBindTexture(GL_TEXTURE_2D, textureID);
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA,
-                             GL_UNSIGNED_BYTE, image.image.data());
-                glGenerateMipmap(GL_TEXTURE_2D);
-
-                // Set texture parameters
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            }
-        }
-    }
-
-    for (const auto& anim : model.animations)
-    {
-        Animation animOut;
-        animOut.name = anim.name;
-
-        for (const auto& channel : anim.channels)
-        {
-            const auto& sampler = anim.samplers[channel.sampler];
-            const auto& inputAccessor = model.accessors[sampler.input];
-            const auto& outputAccessor = model.accessors[sampler.output];
-
-            AnimChannel channelOut;
-            channelOut.targetNode = channel.target_node;
-            channelOut.path = channel.target_path;
-            channelOut.sampler.interpolation = sampler.interpolation;
-
-            // Read input times
-            {
-                const auto& inputView = model.bufferViews[inputAccessor.bufferView];
-                const auto& inputBuffer = model.buffers[inputView.buffer];
-
-                const float* input = reinterpret_cast<const float*>(
-                    inputBuffer.data.data() + inputView.byteOffset + inputAccessor.byteOffset);
-
-                channelOut.sampler.input = std::vector<float>(input, input + inputAccessor.count);
-            }
-
-            // Read outputs
-
-            const auto& outputView = model.bufferViews[outputAccessor.bufferView];
-            const auto& outputBuffer = model.buffers[outputView.buffer];
-
-            const uint8_t* outputData =
-                outputBuffer.data.data() + outputView.byteOffset + outputAccessor.byteOffset;
-
-            if (channel.target_path == "rotation")
-            {
-                const glm::vec4* output = reinterpret_cast<const glm::vec4*>(
-                    outputBuffer.data.data() + outputView.byteOffset + outputAccessor.byteOffset);
-                channelOut.sampler.output =
-                    std::vector<glm::vec4>(output, output + outputAccessor.count);
-            }
-            else
-            {
-                const glm::vec3* output = reinterpret_cast<const glm::vec3*>(
-                    outputBuffer.data.data() + outputView.byteOffset + outputAccessor.byteOffset);
-                for (size_t i = 0; i < outputAccessor.count; ++i)
-                    channelOut.sampler.output.push_back(glm::vec4(output[i], 0.0f)); // pad to vec4
-            }
-
-            animOut.channels.push_back(channelOut);
-        }
-
-        animations.push_back(animOut);
-    }
-    std::cout << "Animations loaded: " << animations.size() << "\n";
-    for (auto& a : animations)
-        std::cout << " - " << a.name << " channel count: " << a.channels.size() << "\n";
+    animations = model.getClips();
+    std::cout << "Animations loaded: " << animations.size() << std::endl;
+    model.close();
 
     float deltaTime = 0.f;
     float lastFrame = 0.f;
@@ -613,8 +261,84 @@ int main()
     glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBufferObject), nullptr, GL_DYNAMIC_DRAW);
     glBindBufferBase(GL_UNIFORM_BUFFER, 0, camera_ubo); // Bind to binding = 0
 
+    ThreadPool threadPool;
+
+    TerrainSettings terrainSettings;
+    terrainSettings.seed = worldSeed;
+    Terrain terrain(terrainSettings);
+    terrain.setThreadPool(&threadPool);
+    terrain.initialize();
+
     GrassManager grassManager;
-    grassManager.initialize(160000, 60.f, 60.f);
+    grassManager.setThreadPool(&threadPool);
+    grassManager.setSeed(worldSeed);
+    grassManager.setTerrain(&terrain.getQuery());
+    // Same density the old fixed 60x60 patch had, kept around the player wherever they go
+    grassManager.initializeStreaming(player.getPosition(), 28.f, 45.f);
+
+    // Environment prop placements around the start
+    std::vector<PropLayer> propLayers = loadEnvironmentPropLayers("Assets/Environment/gltf");
+    std::vector<PropPlacement> props = scatterProps(worldSeed, propLayers, glm::ivec2(-8),
+                                                    glm::ivec2(7), 16.0f, &threadPool);
+    for (auto& prop : props)
+        prop.position.y = terrain.getQuery().height(prop.position.x, prop.position.z);
+    std::cout << "Scattered " << props.size() << " props from " << propLayers.size()
+              << " layers" << std::endl;
+
+    // Their models stream in on the workers, nearest to the camera first, and each one is drawn
+    // instanced wherever it was placed
+    AssetStreamer assetStreamer;
+    assetStreamer.setThreadPool(&threadPool);
+    assetStreamer.setTextureCache(&textureCache);
+    assetStreamer.initialize();
+    PropRenderer propRenderer;
+    propRenderer.initialize(&assetStreamer);
+    propRenderer.addPlacements(props, propLayers);
+
+    // A crowd of the other characters standing around the start, each looping its own clip
+    CrowdRenderer crowd;
+    crowd.initialize();
+    crowd.setTextureCache(&textureCache);
+    {
+        const char* characters[] = { "Knight", "Mage", "Rogue", "Barbarian" };
+        const char* clipNames[] = { "Idle", "Cheer", "2H_Melee_Idle", "Unarmed_Idle", "Blocking",
+                                    "Interact", "Spellcasting" };
+        std::vector<std::pair<int, std::vector<int>>> types; // Type and the clips it can play
+        for (const char* character : characters)
+        {
+            int type = crowd.addCharacter(std::string("Assets/Characters/gltf/") + character +
+                                          ".glb");
+            if (type < 0)
+                continue;
+            std::vector<int> clips;
+            for (int clip = 0; clip < crowd.getClipCount(type); ++clip)
+            {
+                for (const char* name : clipNames)
+                {
+                    if (crowd.getClipName(type, clip) == name)
+                        clips.push_back(clip);
+                }
+            }
+            if (clips.empty())
+                clips.push_back(0);
+            types.emplace_back(type, std::move(clips));
+        }
+
+        const int crowdSize = 400;
+        const float crowdRadius = 60.0f;
+        ScatterRng rng(scatterKey(worldSeed, glm::ivec2(0), 0x43524f57)); // "CROW"
+        for (int i = 0; i < crowdSize && !types.empty(); ++i)
+        {
+            const auto& [type, clips] = types[rng.next() % types.size()];
+            float angle = rng.range(0.0f, glm::two_pi<float>());
+            float distance = crowdRadius * std::sqrt(rng.uniform());
+            glm::vec3 position(std::cos(angle) * distance, 0.0f, std::sin(angle) * distance);
+            position.y = terrain.getQuery().height(position.x, position.z);
+            float yaw = rng.range(0.0f, 360.0f);
+            int clip = clips[rng.next() % clips.size()];
+            crowd.addInstance(type, position, yaw, clip, rng.range(0.0f, 10.0f));
+        }
+    }
 
     while (!glfwWindowShouldClose(window))
     {
@@ -629,6 +353,64 @@ int main()
         ImGui::Begin("Debug");
         ImGui::Text("FPS: %.1f", 1.0f / deltaTime);
         ImGui::Text("Delta Time: %.3f", deltaTime);
+        using CullMode = GrassManager::CullMode;
+        int cullMode = static_cast<int>(grassManager.getCullMode());
+        ImGui::RadioButton("CPU cull", &cullMode, static_cast<int>(CullMode::CPU));
+        ImGui::SameLine();
+        ImGui::RadioButton("Feedback cull", &cullMode,
+                           static_cast<int>(CullMode::TransformFeedback));
+        if (grassManager.isCullModeSupported(CullMode::Compute))
+        {
+            ImGui::SameLine();
+            ImGui::RadioButton("Compute cull", &cullMode, static_cast<int>(CullMode::Compute));
+        }
+        grassManager.setCullMode(static_cast<CullMode>(cullMode));
+        ImGui::Text("Grass buffer: %zu B/blade, %.1f MB", grassManager.getBytesPerBlade(),
+                    grassManager.getBladeCount() * grassManager.getBytesPerBlade() /
+                        (1024.0f * 1024.0f));
+        if (grassManager.getCullMode() == CullMode::CPU)
+        {
+            ImGui::Text("Grass: %zu blades, %d/%d cells (%s)",
+                        grassManager.getVisibleBladeCount(), grassManager.getVisibleCellCount(),
+                        grassManager.getCellCount(), grassManager.getCullKernelName());
+            ImGui::Text("LOD tiers: %zu / %zu / %zu", grassManager.getTierInstanceCount(0),
+                        grassManager.getTierInstanceCount(1), grassManager.getTierInstanceCount(2));
+        }
+        if (grassManager.isStreaming())
+            ImGui::Text("Grass cells pending: %d", grassManager.getPendingCellCount());
+        ImGui::Text("Terrain: %d/%d chunks drawn, %zu tris, %d pending",
+                    terrain.getDrawnChunkCount(), terrain.getResidentChunkCount(),
+                    terrain.getDrawnTriangleCount(), terrain.getPendingChunkCount());
+        ImGui::Text("Crowd: %d/%d drawn, %d poses updated, %.1f MB baked",
+                    crowd.getDrawnInstanceCount(), crowd.getInstanceCount(),
+                    crowd.getPoseUpdateCount(), crowd.getPaletteBytes() / (1024.0f * 1024.0f));
+        ImGui::Text("Assets: %d/%zu resident, %d pending, %.1f MB uploaded",
+                    assetStreamer.getResidentCount(), assetStreamer.getAssetCount(),
+                    assetStreamer.getPendingCount(),
+                    assetStreamer.getUploadedBytes() / (1024.0f * 1024.0f));
+        ImGui::Text("Props: %d/%d drawn in %d draws of %d prototypes, %zu triangles",
+                    propRenderer.getDrawnInstanceCount(), propRenderer.getInstanceCount(),
+                    propRenderer.getDrawCount(), propRenderer.getPrototypeCount(),
+                    propRenderer.getDrawnTriangleCount());
+        ImGui::Text("Impostors: %d drawn, %d atlases, %.1f MB",
+                    propRenderer.getDrawnImpostorCount(), propRenderer.getImpostorAtlasCount(),
+                    propRenderer.getImpostorAtlasBytes() / (1024.0f * 1024.0f));
+        ImGui::Text("Textures: %zu unique, %d uses, %.1f MB", textureCache.getTextureCount(),
+                    textureCache.getReferenceCount(),
+                    textureCache.getBytes() / (1024.0f * 1024.0f));
+        GrassLodSettings grassLod = grassManager.getLodSettings();
+        ImGui::SliderFloat("Near tier end", &grassLod.tierDistances[0], 0.0f, 50.0f);
+        ImGui::SliderFloat("Mid tier end", &grassLod.tierDistances[1], grassLod.tierDistances[0],
+                           100.0f);
+        ImGui::SliderFloat("Thinning start", &grassLod.thinningStart, 0.0f, 100.0f);
+        ImGui::SliderFloat("Thinning end", &grassLod.thinningEnd, grassLod.thinningStart, 100.0f);
+        ImGui::SliderFloat("Min density", &grassLod.minDensity, 0.05f, 1.0f);
+        grassManager.setLodSettings(grassLod);
+        PropImpostorSettings impostors = propRenderer.getImpostorSettings();
+        ImGui::Checkbox("Impostors", &impostors.enabled);
+        ImGui::SliderFloat("Impostor distance", &impostors.distance, 10.0f, 300.0f);
+        ImGui::SliderFloat("Impostor fade", &impostors.fadeRange, 0.0f, 50.0f);
+        propRenderer.setImpostorSettings(impostors);
         ImGui::End();
 
         glfwPollEvents();
@@ -641,26 +423,20 @@ int main()
 
         player.processInput(deltaTime, moveForward, moveBackward, moveLeft, moveRight, jump,
                             camera.getYaw());
-        player.update(deltaTime, 0);
+        player.update(deltaTime, terrain.getQuery());
+        terrain.update(player.getPosition());
+        grassManager.updateStreaming(player.getPosition());
+        assetStreamer.update(camera.getPosition());
         grassManager.update(deltaTime, glm::vec3(1.f, 0.f, 0.5f));
 
-        std::vector<glm::mat4> nodeMatrices;
-        nodeMatrices.clear();
-        for (const auto& node : model.nodes)
-        {
-            nodeMatrices.push_back(getNodeTransform(node));
-        }
-
-        updateAnimation(deltaTime, model, nodeMatrices, meshTransforms);
+        updateAnimation(deltaTime, hierarchy);
+        crowd.update(deltaTime);
 
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         shader.use();
-
-        // Bind texture
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureID);
         shader.setInt("texture1", 0);
 
         glm::mat4 modelMat = glm::mat4(1.0f);
@@ -674,38 +450,21 @@ int main()
         modelMat =
             glm::rotate(modelMat, glm::radians(playerRotationY), glm::vec3(0.0f, 1.0f, 0.0f));
 
-        // Calculate camera position based on mouse angles
-        glm::vec3 playerPos = player.getPosition();
-        //glm::vec3 camPos;
-
-        // Calculate camera offset based on yaw and pitch
-        // float horizontalDistance = cameraDistance * cos(glm::radians(pitch));
-        // float verticalOffset = cameraDistance * sin(glm::radians(pitch));
-
-        // Calculate camera position
-        // camPos.x = playerPos.x - horizontalDistance * cos(glm::radians(yaw));
-        // camPos.y = playerPos.y + cameraHeight + verticalOffset;
-        // camPos.z = playerPos.z - horizontalDistance * sin(glm::radians(yaw));
-
-        // If camera is below terrain, move it closer to the player until it's above
-        float minCameraHeight = 0.5f; // Minimum height above terrain
-        // float terrainY = grassManager->getTerrainHeight(camPos.x, camPos.z);
-
-        // If camera is below terrain, move it closer to the player until it's above
-        // if (camPos.y < terrainY + minCameraHeight)
-        // {
-        //     glm::vec3 toPlayer = glm::normalize(playerPos - camPos);
-        //     float step = 0.1f; // How much to move per iteration (tune as needed)
-        //     int maxSteps = 100; // Prevent infinite loop
-
-        //     for (int i = 0; i < maxSteps && camPos.y < terrainY + minCameraHeight; ++i)
-        //     {
-        //         camPos += toPlayer * step;
-        //         // terrainY = grassManager->getTerrainHeight(camPos.x, camPos.z);
-        //     }
-        // }
-
+        // Pull the camera in front of any terrain between it and the player, and keep it off the
+        // ground
         camera.updatePosition(player.getPosition());
+        {
+            const TerrainQuery& ground = terrain.getQuery();
+            const float minCameraHeight = 0.5f;
+            glm::vec3 lookFrom = player.getPosition() + glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::vec3 camPos = camera.getPosition();
+            TerrainHit hit;
+            if (ground.raycast(lookFrom, camPos, hit))
+                camPos = glm::mix(lookFrom, camPos, std::max(hit.fraction - 0.05f, 0.0f));
+            camPos.y = std::max(camPos.y, ground.height(camPos.x, camPos.z) + minCameraHeight);
+            if (camPos != camera.getPosition())
+                camera.setPosition(camPos);
+        }
 
         glm::mat4 view = camera.getViewMatrix();
         glm::mat4 projection =
@@ -722,17 +481,22 @@ int main()
         shader.setMat4("view", view);
         shader.setMat4("projection", projection);
 
-        // Draw all loaded meshes
-        for (size_t i = 0; i < vaos.size(); ++i)
+        // Joints first, then the attachments riding on their nodes
+        computeJointPalette(skin, hierarchy, jointPalette);
+        for (int node : attachmentNodes)
+            jointPalette.push_back(hierarchy.getWorldMatrix(node));
+        jointPaletteBuffer.upload(jointPalette);
+
+        // The whole character in one draw per texture whatever its mesh count
+        shader.setMat4("model", modelMat);
+        setVertexQuantization(shader, characterQuantization);
+        meshPool.bind();
+        for (const auto& [texture, ranges] : characterBatches)
         {
-            // Apply local transform first, then world transform
-            glm::mat4 finalModelMat = modelMat * localTransforms[i];
-            shader.setMat4("model", finalModelMat);
-
-            glBindVertexArray(vaos[i]);
-            glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indexCounts[i]), indexTypes[i], 0);
-            glBindVertexArray(0);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            meshPool.draw(ranges);
         }
+        glBindVertexArray(0);
 
         shader.setInt("texture1", 0);
 
@@ -741,6 +505,9 @@ int main()
         float aspectRatio = static_cast<float>(width) / height;
 
         auto frustumPlanes = camera.getFrustumPlanes(aspectRatio);
+        terrain.render(view, projection, camera.getPosition(), frustumPlanes);
+        propRenderer.render(view, projection, camera.getPosition(), frustumPlanes);
+        crowd.render(view, projection, camera.getPosition(), frustumPlanes);
         grassManager.render(view, projection, camera.getPosition(), frustumPlanes);
 
         ImGui::Render();
@@ -755,16 +522,8 @@ int main()
     }
 
     // Cleanup
-    for (size_t i = 0; i < vaos.size(); ++i)
-    {
-        glDeleteVertexArrays(1, &vaos[i]);
-        glDeleteBuffers(1, &vbos[i]);
-        glDeleteBuffers(1, &ebos[i]);
-    }
-    if (textureID != 0)
-    {
-        glDeleteTextures(1, &textureID);
-    }
+    for (const auto& [texture, ranges] : characterBatches)
+        textureCache.release(texture);
 
     // Cleanup ImGui
     ImGui_ImplOpenGL3_Shutdown();
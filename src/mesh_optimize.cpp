@@ -0,0 +1,276 @@
+#include "mesh_optimize.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount,
+                                    size_t vertexCount, size_t cacheSize)
+{
+    VertexCacheStats stats;
+    if (indexCount < 3 || vertexCount == 0)
+        return stats;
+    // Each vertex remembers when it went in, it's still cached while fewer than cacheSize
+    // others went in after it
+    std::vector<size_t> insertedAt(vertexCount, SIZE_MAX);
+    std::vector<uint8_t> referenced(vertexCount, 0);
+    size_t unique = 0;
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t v = indices[i];
+        if (v >= vertexCount)
+            continue;
+        if (insertedAt[v] == SIZE_MAX || stats.transformed - insertedAt[v] >= cacheSize)
+            insertedAt[v] = stats.transformed++;
+        unique += referenced[v] ? 0 : 1;
+        referenced[v] = 1;
+    }
+    stats.acmr = static_cast<float>(stats.transformed) / (indexCount / 3);
+    stats.atvr = unique > 0 ? static_cast<float>(stats.transformed) / unique : 0.0f;
+    return stats;
+}
+
+namespace
+{
+
+constexpr int CACHE_SIZE = 32;
+
+// Forsyth's scores: the last triangle's three vertices a bit less than the next few, so strips
+// don't just bounce back and forth, then falling off towards the end of the cache. Vertices with
+// few triangles left get a boost, finishing them off frees their slot for good.
+float vertexScore(int cachePosition, uint32_t remaining)
+{
+    if (remaining == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0)
+    {
+        if (cachePosition < 3)
+            score = 0.75f;
+        else
+        {
+            float scale = 1.0f / (CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+        }
+    }
+    return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+}
+
+} // namespace
+
+void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0 || vertexCount == 0)
+        return;
+
+    // Triangles around each vertex
+    std::vector<uint32_t> start(vertexCount + 1, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        start[indices[i] + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        start[v + 1] += start[v];
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    std::vector<uint32_t> fill(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; ++i)
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    std::vector<uint32_t> remaining(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        remaining[v] = start[v + 1] - start[v];
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        triangleScore[t] =
+            score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    // Room for the cache plus the three vertices pushed in front of it
+    uint32_t cache[CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t nextUnemitted = 0;
+    int64_t best = 0;
+    for (size_t output = 0; output < triangleCount; ++output)
+    {
+        if (best < 0)
+        {
+            // Nothing in the cache has triangles left, carry on from the first unemitted one
+            while (emitted[nextUnemitted])
+                nextUnemitted++;
+            best = static_cast<int64_t>(nextUnemitted);
+        }
+        const uint32_t* tri = &source[best * 3];
+        std::copy_n(tri, 3, indices + output * 3);
+        emitted[best] = 1;
+
+        // Its vertices go to the front of the cache, the rest shift back
+        uint32_t next[CACHE_SIZE + 3];
+        int nextCount = 0;
+        for (int c = 0; c < 3; ++c)
+            next[nextCount++] = tri[c];
+        for (int i = 0; i < cacheCount; ++i)
+        {
+            uint32_t v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                next[nextCount++] = v;
+        }
+        for (int c = 0; c < 3; ++c)
+        {
+            uint32_t v = tri[c];
+            remaining[v]--;
+            // Drop the triangle from the vertex's list, its order doesn't matter
+            uint32_t* list = &adjacency[start[v]];
+            uint32_t* end = list + remaining[v] + 1;
+            std::iter_swap(std::find(list, end, static_cast<uint32_t>(best)), end - 1);
+        }
+
+        // Rescore what's in the cache and whatever fell out of it, then their triangles
+        for (int i = 0; i < nextCount; ++i)
+        {
+            uint32_t v = next[i];
+            cachePosition[v] = i < CACHE_SIZE ? i : -1;
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+        best = -1;
+        float bestScore = -1.0f;
+        for (int i = 0; i < nextCount; ++i)
+        {
+            uint32_t v = next[i];
+            for (uint32_t k = start[v]; k < start[v] + remaining[v]; ++k)
+            {
+                uint32_t t = adjacency[k];
+                triangleScore[t] = score[source[t * 3]] + score[source[t * 3 + 1]] +
+                                   score[source[t * 3 + 2]];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+        cacheCount = std::min(nextCount, CACHE_SIZE);
+        std::copy_n(next, cacheCount, cache);
+    }
+}
+
+void optimizeOverdraw(uint32_t* indices, size_t indexCount, const MeshVertex* vertices,
+                      size_t vertexCount, float threshold)
+{
+    size_t triangleCount = indexCount / 3;
+    if (triangleCount < 2)
+        return;
+    VertexCacheStats before = analyzeVertexCache(indices, indexCount, vertexCount);
+
+    // A cluster starts wherever a triangle misses the cache on all three vertices, reordering
+    // from there costs nothing the order didn't pay already
+    std::vector<size_t> clusterStart;
+    std::vector<size_t> insertedAt(vertexCount, SIZE_MAX);
+    size_t transformed = 0;
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        int misses = 0;
+        for (int c = 0; c < 3; ++c)
+        {
+            uint32_t v = indices[t * 3 + c];
+            if (insertedAt[v] == SIZE_MAX || transformed - insertedAt[v] >= 16)
+            {
+                insertedAt[v] = transformed++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3)
+            clusterStart.push_back(t);
+    }
+    size_t clusterCount = clusterStart.size();
+    if (clusterCount < 2)
+        return;
+    clusterStart.push_back(triangleCount);
+
+    auto position = [&](uint32_t v)
+    {
+        const float* p = vertices[v].position;
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> clusterCenter(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        float area = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t)
+        {
+            glm::vec3 p0 = position(indices[t * 3]);
+            glm::vec3 p1 = position(indices[t * 3 + 1]);
+            glm::vec3 p2 = position(indices[t * 3 + 2]);
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0); // Twice the area long
+            float triangleArea = glm::length(normal);
+            clusterCenter[c] += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            clusterNormal[c] += normal;
+            area += triangleArea;
+        }
+        meshCenter += clusterCenter[c];
+        meshArea += area;
+        clusterCenter[c] /= std::max(area, 1e-12f);
+        float length = glm::length(clusterNormal[c]);
+        clusterNormal[c] = length > 0.0f ? clusterNormal[c] / length : glm::vec3(0.0f);
+    }
+    meshCenter /= std::max(meshArea, 1e-12f);
+
+    // Clusters further out along their own normal are more likely to be in front
+    std::vector<float> sortKey(clusterCount);
+    std::vector<uint32_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        sortKey[c] = glm::dot(clusterCenter[c] - meshCenter, clusterNormal[c]);
+        order[c] = static_cast<uint32_t>(c);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](uint32_t a, uint32_t b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(triangleCount * 3);
+    for (uint32_t c : order)
+    {
+        sorted.insert(sorted.end(), indices + clusterStart[c] * 3,
+                      indices + clusterStart[c + 1] * 3);
+    }
+    VertexCacheStats after = analyzeVertexCache(sorted.data(), sorted.size(), vertexCount);
+    if (after.transformed <= before.transformed * threshold)
+        std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+void optimizeVertexFetch(std::vector<MeshVertex>& vertices, uint32_t* indices,
+                         size_t indexCount)
+{
+    std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    std::vector<MeshVertex> ordered;
+    ordered.reserve(vertices.size());
+    for (size_t i = 0; i < indexCount; ++i)
+    {
+        uint32_t& target = remap[indices[i]];
+        if (target == UINT32_MAX)
+        {
+            target = static_cast<uint32_t>(ordered.size());
+            ordered.push_back(vertices[indices[i]]);
+        }
+        indices[i] = target;
+    }
+    vertices.swap(ordered);
+}
+
+void optimizeMesh(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices,
+                  const std::vector<std::pair<size_t, size_t>>& ranges)
+{
+    for (const auto& [first, end] : ranges)
+    {
+        optimizeVertexCache(indices.data() + first, end - first, vertices.size());
+        optimizeOverdraw(indices.data() + first, end - first, vertices.data(), vertices.size());
+    }
+    optimizeVertexFetch(vertices, indices.data(), indices.size());
+}
@@ -0,0 +1,213 @@
+#include "mesh_pool.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+MeshPool::MeshPool()
+    : m_format(VertexFormat::Static)
+    , m_vertexSize(sizeof(StaticVertex))
+    , m_vao(0)
+    , m_vbo(0)
+    , m_ebo(0)
+    , m_vertexCapacity(0)
+    , m_indexCapacity(0)
+    , m_usedVertices(0)
+    , m_usedIndices(0)
+{
+}
+
+MeshPool::~MeshPool()
+{
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ebo);
+}
+
+void MeshPool::initialize(VertexFormat format, size_t vertexCapacity, size_t indexCapacity)
+{
+    m_format = format;
+    m_vertexSize = ::getVertexSize(format);
+    m_vertexCapacity = std::max<size_t>(vertexCapacity, 1);
+    m_indexCapacity = std::max<size_t>(indexCapacity, 1);
+    m_freeVertices = { { 0, m_vertexCapacity } };
+    m_freeIndices = { { 0, m_indexCapacity } };
+
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glGenBuffers(1, &m_ebo);
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER, m_vertexCapacity * m_vertexSize, nullptr, GL_STATIC_DRAW);
+    setVertexLayout();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indexCapacity * sizeof(uint32_t), nullptr,
+                 GL_STATIC_DRAW);
+    glBindVertexArray(0);
+}
+
+void MeshPool::setVertexLayout()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    setVertexAttributes(m_format);
+}
+
+size_t MeshPool::allocate(std::vector<FreeRange>& free, size_t count)
+{
+    for (size_t i = 0; i < free.size(); ++i)
+    {
+        if (free[i].count < count)
+            continue;
+        size_t offset = free[i].offset;
+        free[i].offset += count;
+        free[i].count -= count;
+        if (free[i].count == 0)
+            free.erase(free.begin() + i);
+        return offset;
+    }
+    return SIZE_MAX;
+}
+
+void MeshPool::release(std::vector<FreeRange>& free, size_t offset, size_t count)
+{
+    auto it = std::lower_bound(free.begin(), free.end(), offset,
+                               [](const FreeRange& range, size_t value)
+                               { return range.offset < value; });
+    it = free.insert(it, { offset, count });
+    // Merge with the next range, then the previous one
+    auto next = it + 1;
+    if (next != free.end() && it->offset + it->count == next->offset)
+    {
+        it->count += next->count;
+        free.erase(next);
+    }
+    if (it != free.begin())
+    {
+        auto previous = it - 1;
+        if (previous->offset + previous->count == it->offset)
+        {
+            previous->count += it->count;
+            free.erase(it);
+        }
+    }
+}
+
+void MeshPool::grow(GLenum target, GLuint& buffer, size_t& capacity, size_t elementSize,
+                    size_t needed, std::vector<FreeRange>& free)
+{
+    size_t newCapacity = std::max(capacity * 2, capacity + needed);
+    GLuint newBuffer;
+    glGenBuffers(1, &newBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * elementSize, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, capacity * elementSize);
+    glDeleteBuffers(1, &buffer);
+    buffer = newBuffer;
+
+    release(free, capacity, newCapacity - capacity);
+    capacity = newCapacity;
+
+    // Point the VAO at the new buffer
+    glBindVertexArray(m_vao);
+    if (target == GL_ARRAY_BUFFER)
+        setVertexLayout();
+    else
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    glBindVertexArray(0);
+}
+
+MeshRange MeshPool::add(const void* vertices, size_t vertexCount, const uint32_t* indices,
+                        size_t indexCount)
+{
+    MeshRange range = reserve(vertexCount, indexCount);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, range.baseVertex * m_vertexSize, vertexCount * m_vertexSize,
+                    vertices);
+    // Through the copy target so the VAO's element binding stays as it is
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, range.firstIndex * sizeof(uint32_t),
+                    indexCount * sizeof(uint32_t), indices);
+    return range;
+}
+
+MeshRange MeshPool::reserve(size_t vertexCount, size_t indexCount)
+{
+    size_t vertexOffset = allocate(m_freeVertices, vertexCount);
+    if (vertexOffset == SIZE_MAX)
+    {
+        grow(GL_ARRAY_BUFFER, m_vbo, m_vertexCapacity, m_vertexSize, vertexCount,
+             m_freeVertices);
+        vertexOffset = allocate(m_freeVertices, vertexCount);
+    }
+    size_t indexOffset = allocate(m_freeIndices, indexCount);
+    if (indexOffset == SIZE_MAX)
+    {
+        grow(GL_ELEMENT_ARRAY_BUFFER, m_ebo, m_indexCapacity, sizeof(uint32_t), indexCount,
+             m_freeIndices);
+        indexOffset = allocate(m_freeIndices, indexCount);
+    }
+
+    m_usedVertices += vertexCount;
+    m_usedIndices += indexCount;
+
+    MeshRange range;
+    range.baseVertex = static_cast<GLint>(vertexOffset);
+    range.vertexCount = static_cast<uint32_t>(vertexCount);
+    range.firstIndex = static_cast<uint32_t>(indexOffset);
+    range.indexCount = static_cast<uint32_t>(indexCount);
+    return range;
+}
+
+void MeshPool::copyVertices(const MeshRange& range, GLuint source, size_t offset)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, source);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset,
+                        range.baseVertex * m_vertexSize, range.vertexCount * m_vertexSize);
+}
+
+void MeshPool::copyIndices(const MeshRange& range, GLuint source, size_t offset)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, source);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset,
+                        range.firstIndex * sizeof(uint32_t), range.indexCount * sizeof(uint32_t));
+}
+
+void MeshPool::remove(const MeshRange& range)
+{
+    release(m_freeVertices, static_cast<size_t>(range.baseVertex), range.vertexCount);
+    release(m_freeIndices, range.firstIndex, range.indexCount);
+    m_usedVertices -= range.vertexCount;
+    m_usedIndices -= range.indexCount;
+}
+
+void MeshPool::draw(const MeshRange& range) const
+{
+    glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount),
+                             GL_UNSIGNED_INT, (void*)(range.firstIndex * sizeof(uint32_t)),
+                             range.baseVertex);
+}
+
+void MeshPool::drawInstanced(const MeshRange& range, GLsizei instanceCount) const
+{
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(range.indexCount),
+                                      GL_UNSIGNED_INT, (void*)(range.firstIndex * sizeof(uint32_t)),
+                                      instanceCount, range.baseVertex);
+}
+
+void MeshPool::draw(const std::vector<MeshRange>& ranges)
+{
+    m_drawCounts.clear();
+    m_drawOffsets.clear();
+    m_drawBaseVertices.clear();
+    for (const MeshRange& range : ranges)
+    {
+        m_drawCounts.push_back(static_cast<GLsizei>(range.indexCount));
+        m_drawOffsets.push_back((const void*)(range.firstIndex * sizeof(uint32_t)));
+        m_drawBaseVertices.push_back(range.baseVertex);
+    }
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_drawCounts.data(), GL_UNSIGNED_INT,
+                                  m_drawOffsets.data(), static_cast<GLsizei>(ranges.size()),
+                                  m_drawBaseVertices.data());
+}
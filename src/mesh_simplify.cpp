@@ -0,0 +1,313 @@
+#include "mesh_simplify.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+namespace
+{
+
+// Sum of squared distances to a set of planes, each weighted by its triangle's area. Dividing
+// by the total weight keeps the error a squared distance however many triangles went in.
+struct Quadric
+{
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+    double weight = 0;
+
+    void addPlane(const glm::dvec3& n, double d, double w)
+    {
+        a2 += w * n.x * n.x;
+        ab += w * n.x * n.y;
+        ac += w * n.x * n.z;
+        ad += w * n.x * d;
+        b2 += w * n.y * n.y;
+        bc += w * n.y * n.z;
+        bd += w * n.y * d;
+        c2 += w * n.z * n.z;
+        cd += w * n.z * d;
+        d2 += w * d * d;
+        weight += w;
+    }
+
+    Quadric& operator+=(const Quadric& o)
+    {
+        a2 += o.a2;
+        ab += o.ab;
+        ac += o.ac;
+        ad += o.ad;
+        b2 += o.b2;
+        bc += o.bc;
+        bd += o.bd;
+        c2 += o.c2;
+        cd += o.cd;
+        d2 += o.d2;
+        weight += o.weight;
+        return *this;
+    }
+
+    double error(const glm::dvec3& p) const
+    {
+        double e = a2 * p.x * p.x + b2 * p.y * p.y + c2 * p.z * p.z + d2 +
+                   2.0 * (ab * p.x * p.y + ac * p.x * p.z + bc * p.y * p.z + ad * p.x +
+                          bd * p.y + cd * p.z);
+        return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+    }
+};
+
+struct Collapse
+{
+    double cost;
+    uint32_t from;
+    uint32_t to;
+};
+
+glm::dvec3 positionOf(const MeshVertex& vertex)
+{
+    return glm::dvec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+}
+
+// The first of each run of vertices that compare equal on the first floatCount floats
+std::vector<uint32_t> weld(const MeshVertex* vertices, size_t vertexCount, size_t floatCount)
+{
+    // texcoord and normal follow position
+    auto key = [&](uint32_t v) { return vertices[v].position; };
+    std::vector<uint32_t> order(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i)
+        order[i] = static_cast<uint32_t>(i);
+    auto less = [&](uint32_t a, uint32_t b)
+    { return std::memcmp(key(a), key(b), floatCount * sizeof(float)) < 0; };
+    std::stable_sort(order.begin(), order.end(), less);
+
+    std::vector<uint32_t> remap(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        bool same = i > 0 && !less(order[i - 1], order[i]);
+        remap[order[i]] = same ? remap[order[i - 1]] : order[i];
+    }
+    return remap;
+}
+
+} // namespace
+
+std::vector<uint32_t> simplifyMesh(const MeshVertex* vertices, size_t vertexCount,
+                                   const uint32_t* indices, size_t indexCount,
+                                   size_t targetIndexCount, float maxError, float* resultError)
+{
+    static_assert(offsetof(MeshVertex, texcoord) == 3 * sizeof(float) &&
+                      offsetof(MeshVertex, normal) == 5 * sizeof(float),
+                  "Welding compares position, texcoord and normal as one run of floats");
+    std::vector<uint32_t> result(indices, indices + indexCount - indexCount % 3);
+    double worstError = 0.0;
+    if (resultError)
+        *resultError = 0.0f;
+    if (vertexCount == 0 || result.empty())
+        return result;
+
+    // Exact duplicates are one vertex here. Corners keep their own vertex, a position shared by
+    // vertices with different texcoords or normals is a seam or a hard edge.
+    std::vector<uint32_t> vertex = weld(vertices, vertexCount, 8);
+    std::vector<uint32_t> corner = weld(vertices, vertexCount, 3);
+    for (uint32_t& index : result)
+        index = vertex[std::min<size_t>(index, vertexCount - 1)];
+
+    std::vector<uint8_t> locked(vertexCount, 0);
+    std::vector<uint32_t> cornerVertex(vertexCount, UINT32_MAX);
+    for (uint32_t index : result)
+    {
+        uint32_t& seen = cornerVertex[corner[index]];
+        if (seen != UINT32_MAX && seen != index)
+            locked[corner[index]] = 1;
+        seen = index;
+    }
+    // Edges not shared by exactly two triangles are open or non-manifold
+    std::unordered_map<uint64_t, int> edgeUses;
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+        for (int e = 0; e < 3; ++e)
+        {
+            uint32_t a = corner[result[t + e]];
+            uint32_t b = corner[result[t + (e + 1) % 3]];
+            edgeUses[uint64_t(std::min(a, b)) << 32 | std::max(a, b)]++;
+        }
+    }
+    for (const auto& [edge, uses] : edgeUses)
+    {
+        if (uses != 2)
+        {
+            locked[edge >> 32] = 1;
+            locked[edge & 0xffffffffu] = 1;
+        }
+    }
+
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+        glm::dvec3 p0 = positionOf(vertices[result[t]]);
+        glm::dvec3 n = glm::cross(positionOf(vertices[result[t + 1]]) - p0,
+                                  positionOf(vertices[result[t + 2]]) - p0);
+        double length = glm::length(n);
+        if (length <= 0.0)
+            continue;
+        n /= length;
+        for (int c = 0; c < 3; ++c)
+            quadrics[corner[result[t + c]]].addPlane(n, -glm::dot(n, p0), length * 0.5);
+    }
+
+    double maxCost = double(maxError) * maxError;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> collapseTo(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    std::vector<uint32_t> triangleStart(vertexCount + 1);
+    std::vector<uint32_t> triangles;
+    while (result.size() > targetIndexCount)
+    {
+        // Triangles around each corner
+        std::fill(triangleStart.begin(), triangleStart.end(), 0);
+        for (uint32_t index : result)
+            triangleStart[corner[index] + 1]++;
+        for (size_t v = 0; v < vertexCount; ++v)
+            triangleStart[v + 1] += triangleStart[v];
+        triangles.resize(result.size());
+        std::vector<uint32_t> fill(triangleStart.begin(), triangleStart.end() - 1);
+        for (size_t i = 0; i < result.size(); ++i)
+            triangles[fill[corner[result[i]]]++] = static_cast<uint32_t>(i / 3);
+
+        collapses.clear();
+        for (size_t t = 0; t < result.size(); t += 3)
+        {
+            for (int e = 0; e < 3; ++e)
+            {
+                uint32_t from = result[t + e];
+                uint32_t to = result[t + (e + 1) % 3];
+                for (int direction = 0; direction < 2; ++direction, std::swap(from, to))
+                {
+                    if (locked[corner[from]] || corner[from] == corner[to])
+                        continue;
+                    Quadric q = quadrics[corner[from]];
+                    q += quadrics[corner[to]];
+                    double cost = q.error(positionOf(vertices[to]));
+                    if (cost <= maxCost)
+                        collapses.push_back({ cost, from, to });
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+        // Each collapse takes its neighbourhood out of the pass, so the checks below stay valid
+        std::fill(touched.begin(), touched.end(), 0);
+        for (size_t v = 0; v < vertexCount; ++v)
+            collapseTo[v] = static_cast<uint32_t>(v);
+        size_t wanted = (result.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            uint32_t from = corner[collapse.from];
+            uint32_t to = corner[collapse.to];
+            if (touched[from] || touched[to])
+                continue;
+
+            glm::dvec3 target = positionOf(vertices[collapse.to]);
+            bool flips = false;
+            for (uint32_t i = triangleStart[from]; i < triangleStart[from + 1] && !flips; ++i)
+            {
+                const uint32_t* tri = &result[triangles[i] * 3];
+                glm::dvec3 before[3], after[3];
+                bool collapsing = false;
+                for (int c = 0; c < 3; ++c)
+                {
+                    before[c] = after[c] = positionOf(vertices[tri[c]]);
+                    if (corner[tri[c]] == from)
+                        after[c] = target;
+                    collapsing |= corner[tri[c]] == to;
+                }
+                if (collapsing)
+                    continue;
+                glm::dvec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::dvec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(n0, n1) <= 0.0;
+            }
+            if (flips)
+                continue;
+
+            collapseTo[collapse.from] = collapse.to;
+            quadrics[to] += quadrics[from];
+            worstError = std::max(worstError, collapse.cost);
+            for (uint32_t i = triangleStart[from]; i < triangleStart[from + 1]; ++i)
+            {
+                bool collapsing = false;
+                for (int c = 0; c < 3; ++c)
+                {
+                    uint32_t other = corner[result[triangles[i] * 3 + c]];
+                    touched[other] = 1;
+                    collapsing |= other == to;
+                }
+                removed += collapsing ? 1 : 0;
+            }
+            if (removed >= wanted)
+                break;
+        }
+        if (removed == 0)
+            break;
+
+        size_t kept = 0;
+        for (size_t t = 0; t < result.size(); t += 3)
+        {
+            uint32_t a = collapseTo[result[t]];
+            uint32_t b = collapseTo[result[t + 1]];
+            uint32_t c = collapseTo[result[t + 2]];
+            if (corner[a] == corner[b] || corner[b] == corner[c] || corner[a] == corner[c])
+                continue;
+            result[kept++] = a;
+            result[kept++] = b;
+            result[kept++] = c;
+        }
+        result.resize(kept);
+    }
+
+    if (resultError)
+        *resultError = static_cast<float>(std::sqrt(worstError));
+    return result;
+}
+
+std::vector<MeshLod> buildMeshLods(const std::vector<MeshVertex>& vertices,
+                                   std::vector<uint32_t>& indices, const MeshLodSettings& settings)
+{
+    std::vector<MeshLod> lods;
+    lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0.0f });
+    if (vertices.empty() || indices.empty())
+        return lods;
+
+    glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+    for (const MeshVertex& vertex : vertices)
+    {
+        glm::vec3 position(vertex.position[0], vertex.position[1], vertex.position[2]);
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+    float maxError = glm::length(boundsMax - boundsMin) * 0.5f * settings.maxError;
+
+    // Each LOD starts from the one before, errors add up along the chain. Coarser ones are only
+    // drawn smaller, so each may stray further than the one before.
+    while (lods.size() < MAX_MESH_LODS)
+    {
+        MeshLod previous = lods.back();
+        if (lods.size() > 1)
+            maxError *= settings.errorGrowth;
+        if (previous.error >= maxError)
+            break;
+        size_t target = static_cast<size_t>(previous.indexCount * settings.reduction) / 3 * 3;
+        float error = 0.0f;
+        std::vector<uint32_t> lod =
+            simplifyMesh(vertices.data(), vertices.size(), indices.data() + previous.firstIndex,
+                         previous.indexCount, target, maxError - previous.error, &error);
+        if (lod.empty() || lod.size() > previous.indexCount * settings.minReduction)
+            break;
+        lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lod.size()),
+                         previous.error + error });
+        indices.insert(indices.end(), lod.begin(), lod.end());
+    }
+    return lods;
+}
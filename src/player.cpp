@@ -48,8 +48,10 @@ void Player::processInput(float deltaTime, bool forward, bool backward, bool lef
 
 void Player::move(const glm::vec3& dir, float deltaTime) { position += dir * speed * deltaTime; }
 
-void Player::update(float deltaTime, float terrainY)
+void Player::update(float deltaTime, const TerrainQuery& terrain)
 {
+    float terrainY = terrain.height(position.x, position.z);
+
     // Apply gravity if not grounded
     if (!isGrounded)
     {
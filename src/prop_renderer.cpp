@@ -0,0 +1,422 @@
+#include "prop_renderer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+
+// Directions over the upper hemisphere (+Y) folded onto the square [-1, 1]^2, the same as
+// shaders/impostor.vert.glsl
+glm::vec3 decodeHemiOctahedral(const glm::vec2& e)
+{
+    glm::vec2 p = glm::vec2(e.x + e.y, e.x - e.y) * 0.5f;
+    return glm::normalize(glm::vec3(p.x, 1.0f - std::fabs(p.x) - std::fabs(p.y), p.y));
+}
+
+// The right and up of a frame looking back along direction
+void frameBasis(const glm::vec3& direction, glm::vec3& right, glm::vec3& up)
+{
+    glm::vec3 reference = std::fabs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, -1.0f)
+                                                          : glm::vec3(0.0f, 1.0f, 0.0f);
+    right = glm::normalize(glm::cross(reference, direction));
+    up = glm::cross(direction, right);
+}
+
+} // namespace
+
+PropRenderer::PropRenderer()
+    : m_streamer(nullptr)
+    , m_instanceBuffer(0)
+    , m_instanceCapacity(0)
+    , m_impostorVao(0)
+    , m_bakeFramebuffer(0)
+    , m_bakeDepth(0)
+    , m_bakeDepthSize(0)
+    , m_bakeInstanceBuffer(0)
+    , m_instanceCount(0)
+    , m_drawnInstances(0)
+    , m_drawCount(0)
+    , m_drawnTriangles(0)
+    , m_drawnImpostors(0)
+    , m_impostorAtlasCount(0)
+    , m_impostorAtlasBytes(0)
+{
+}
+
+PropRenderer::~PropRenderer()
+{
+    for (const Prototype& prototype : m_prototypes)
+        glDeleteTextures(1, &prototype.impostorAtlas);
+    glDeleteBuffers(1, &m_instanceBuffer);
+    glDeleteBuffers(1, &m_bakeInstanceBuffer);
+    glDeleteVertexArrays(1, &m_impostorVao);
+    glDeleteFramebuffers(1, &m_bakeFramebuffer);
+    glDeleteRenderbuffers(1, &m_bakeDepth);
+}
+
+void PropRenderer::initialize(AssetStreamer* streamer)
+{
+    m_streamer = streamer;
+    m_shader = ShaderBuilder()
+                   .load("shaders/prop.vert.glsl", Shader::Type::Vertex)
+                   .load("shaders/prop.frag.glsl", Shader::Type::Fragment)
+                   .build();
+    m_impostorShader = ShaderBuilder()
+                           .load("shaders/impostor.vert.glsl", Shader::Type::Vertex)
+                           .load("shaders/impostor.frag.glsl", Shader::Type::Fragment)
+                           .build();
+    glGenBuffers(1, &m_instanceBuffer);
+    glGenVertexArrays(1, &m_impostorVao);
+    glGenFramebuffers(1, &m_bakeFramebuffer);
+    glGenRenderbuffers(1, &m_bakeDepth);
+
+    DrawInstance identity;
+    for (int r = 0; r < 3; ++r)
+        identity.rows[r] = glm::vec4(r == 0, r == 1, r == 2, 0.0f);
+    identity.fade = 1.0f;
+    glGenBuffers(1, &m_bakeInstanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_bakeInstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(identity), &identity, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PropRenderer::setInstanceAttributes(size_t offset)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        glVertexAttribPointer(4 + i, 4, GL_FLOAT, GL_FALSE, sizeof(DrawInstance),
+                              (void*)(offset + i * sizeof(glm::vec4)));
+    }
+    glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(DrawInstance),
+                          (void*)(offset + offsetof(DrawInstance, fade)));
+    for (int i = 4; i < 8; ++i)
+    {
+        glEnableVertexAttribArray(i);
+        glVertexAttribDivisor(i, 1);
+    }
+}
+
+void PropRenderer::bakeImpostor(Prototype& prototype)
+{
+    const StreamedAsset& asset = m_streamer->getAsset(prototype.asset);
+    int grid = std::max(m_impostor.gridSize, 1);
+    int frame = std::max(m_impostor.frameSize, 1);
+    int size = grid * frame;
+
+    GLint previousFramebuffer;
+    GLint previousViewport[4];
+    GLfloat previousClear[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, previousClear);
+
+    GLuint atlas;
+    glGenTextures(1, &atlas);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Mips stop while frames are still 4 texels wide and aligned to them, below that they'd
+    // blend neighbouring frames together
+    int maxLevel = 0;
+    while (frame % (2 << maxLevel) == 0 && (frame >> (maxLevel + 1)) >= 4)
+        maxLevel++;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+    if (m_bakeDepthSize != size)
+    {
+        glBindRenderbuffer(GL_RENDERBUFFER, m_bakeDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        m_bakeDepthSize = size;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, m_bakeFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_bakeDepth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cerr << "Impostor framebuffer incomplete, " << m_streamer->getPath(prototype.asset)
+                  << " stays a mesh" << std::endl;
+        glDeleteTextures(1, &atlas);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        return;
+    }
+    // Zero outside the model, so the mips come out premultiplied by coverage
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    m_shader.use();
+    m_shader.setInt("texture1", 0);
+    setVertexQuantization(m_shader, asset.quantization);
+    glActiveTexture(GL_TEXTURE0);
+    MeshPool& pool = m_streamer->getMeshPool();
+    pool.bind();
+    glBindBuffer(GL_ARRAY_BUFFER, m_bakeInstanceBuffer);
+    setInstanceAttributes(0);
+
+    // Each frame is an orthographic view of the bounding sphere from its direction
+    glm::vec3 center = (asset.boundsMin + asset.boundsMax) * 0.5f;
+    float radius = std::max(glm::length(asset.boundsMax - asset.boundsMin) * 0.5f, 1e-3f);
+    m_shader.setMat4("projection",
+                     glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius));
+    for (int y = 0; y < grid; ++y)
+    {
+        for (int x = 0; x < grid; ++x)
+        {
+            glm::vec2 cell((x + 0.5f) / grid * 2.0f - 1.0f, (y + 0.5f) / grid * 2.0f - 1.0f);
+            glm::vec3 direction = decodeHemiOctahedral(cell);
+            glm::vec3 right, up;
+            frameBasis(direction, right, up);
+            m_shader.setMat4("view", glm::lookAt(center + direction * 2.0f * radius, center, up));
+            glViewport(x * frame, y * frame, frame, frame);
+            for (const StreamedBatch& batch : asset.batches)
+            {
+                glBindTexture(GL_TEXTURE_2D, batch.texture);
+                pool.drawInstanced(batch.lods[0], 1);
+            }
+        }
+    }
+    glBindVertexArray(0);
+
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    glClearColor(previousClear[0], previousClear[1], previousClear[2], previousClear[3]);
+
+    prototype.impostorAtlas = atlas;
+    prototype.impostorGrid = grid;
+    m_impostorAtlasCount++;
+    m_impostorAtlasBytes += size_t(size) * size * 4 * 4 / 3; // With the mips
+}
+
+int PropRenderer::addPrototype(const std::string& path)
+{
+    AssetHandle asset = m_streamer->request(path);
+    auto it = m_prototypeOf.find(asset);
+    if (it != m_prototypeOf.end())
+        return it->second;
+    int prototype = static_cast<int>(m_prototypes.size());
+    m_prototypeOf.emplace(asset, prototype);
+    m_prototypes.emplace_back();
+    m_prototypes.back().asset = asset;
+    return prototype;
+}
+
+void PropRenderer::addInstance(int prototype, const glm::vec3& position, float yaw, float scale)
+{
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), position);
+    model = glm::rotate(model, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::scale(model, glm::vec3(scale));
+    InstanceData data;
+    for (int r = 0; r < 3; ++r)
+        data.rows[r] = glm::vec4(model[0][r], model[1][r], model[2][r], model[3][r]);
+
+    Prototype& target = m_prototypes[prototype];
+    target.instances.push_back(data);
+    target.lods.push_back(0);
+    m_streamer->addUse(target.asset, position);
+    m_instanceCount++;
+}
+
+void PropRenderer::addPlacements(const std::vector<PropPlacement>& placements,
+                                 const std::vector<PropLayer>& layers)
+{
+    for (const PropPlacement& placement : placements)
+    {
+        int prototype = addPrototype(layers[placement.layer].assets[placement.asset]);
+        addInstance(prototype, placement.position, placement.rotation, placement.scale);
+    }
+}
+
+void PropRenderer::clearInstances()
+{
+    for (Prototype& prototype : m_prototypes)
+    {
+        prototype.instances.clear();
+        prototype.lods.clear();
+    }
+    m_instanceCount = 0;
+}
+
+void PropRenderer::render(const glm::mat4& view, const glm::mat4& projection,
+                          const glm::vec3& viewPos,
+                          const std::array<Camera::FrustumPlane, 6>& frustumPlanes)
+{
+    m_drawnInstances = 0;
+    m_drawCount = 0;
+    m_drawnTriangles = 0;
+    m_drawnImpostors = 0;
+
+    // Large prototypes get their atlas once resident, a few a frame
+    int bakes = 0;
+    for (Prototype& prototype : m_prototypes)
+    {
+        if (!m_impostor.enabled || bakes >= m_impostor.bakesPerFrame)
+            break;
+        if (prototype.impostorChecked || prototype.instances.empty() ||
+            m_streamer->getState(prototype.asset) != AssetState::Resident)
+            continue;
+        prototype.impostorChecked = true;
+        const StreamedAsset& asset = m_streamer->getAsset(prototype.asset);
+        if (glm::length(asset.boundsMax - asset.boundsMin) * 0.5f >= m_impostor.minRadius)
+        {
+            bakeImpostor(prototype);
+            bakes++;
+        }
+    }
+
+    // Bounding spheres from the model's box, moved and scaled by each instance's rows. The
+    // scale is uniform, so it's the length of any column of the rotation part.
+    const float focalScale = projection[1][1]; // 1 / tan(fov / 2)
+    const float down = 1.0f - m_lod.hysteresis;
+    const float up = 1.0f + m_lod.hysteresis;
+    m_visible.clear();
+    for (Prototype& prototype : m_prototypes)
+    {
+        std::fill_n(prototype.visibleCount, MAX_MESH_LODS, 0);
+        prototype.impostorCount = 0;
+        if (m_streamer->getState(prototype.asset) != AssetState::Resident)
+            continue;
+        const StreamedAsset& asset = m_streamer->getAsset(prototype.asset);
+        glm::vec4 center((asset.boundsMin + asset.boundsMax) * 0.5f, 1.0f);
+        float radius = glm::length(asset.boundsMax - asset.boundsMin) * 0.5f;
+        int lastLod = asset.lodCount - 1;
+        bool impostor = m_impostor.enabled && prototype.impostorAtlas != 0;
+        float fadeRange = std::max(m_impostor.fadeRange, 1e-3f);
+
+        for (size_t i = 0; i < prototype.instances.size(); ++i)
+        {
+            const InstanceData& instance = prototype.instances[i];
+            glm::vec3 worldCenter(glm::dot(instance.rows[0], center),
+                                  glm::dot(instance.rows[1], center),
+                                  glm::dot(instance.rows[2], center));
+            float scale = glm::length(glm::vec3(instance.rows[0].x, instance.rows[1].x,
+                                                instance.rows[2].x));
+            float worldRadius = radius * scale;
+            bool visible = true;
+            for (const auto& plane : frustumPlanes)
+            {
+                if (glm::dot(plane.normal, worldCenter) + plane.distance < -worldRadius)
+                {
+                    visible = false;
+                    break;
+                }
+            }
+            if (!visible)
+                continue;
+
+            float distance = std::max(glm::distance(viewPos, worldCenter), 1e-3f);
+            float size = worldRadius * focalScale / distance;
+            if (size < m_lod.cullScreenSize)
+                continue;
+            // 0 all mesh, 1 all impostor, both in between on complementary pixels
+            float blend = 0.0f;
+            if (impostor)
+                blend = std::clamp((distance - m_impostor.distance) / fadeRange, 0.0f, 1.0f);
+            if (blend > 0.0f)
+            {
+                m_impostorVisible.push_back(
+                    { { instance.rows[0], instance.rows[1], instance.rows[2] }, blend });
+            }
+            if (blend >= 1.0f)
+                continue;
+            int lod = std::min<int>(prototype.lods[i], lastLod);
+            while (lod < lastLod && size < m_lod.screenSizes[lod] * down)
+                lod++;
+            while (lod > 0 && size > m_lod.screenSizes[lod - 1] * up)
+                lod--;
+            prototype.lods[i] = static_cast<uint8_t>(lod);
+            m_lodVisible[lod].push_back(
+                { { instance.rows[0], instance.rows[1], instance.rows[2] }, 1.0f - blend });
+        }
+
+        for (int lod = 0; lod < MAX_MESH_LODS; ++lod)
+        {
+            prototype.firstVisible[lod] = m_visible.size();
+            prototype.visibleCount[lod] = m_lodVisible[lod].size();
+            m_visible.insert(m_visible.end(), m_lodVisible[lod].begin(), m_lodVisible[lod].end());
+            m_lodVisible[lod].clear();
+        }
+        prototype.firstImpostor = m_visible.size();
+        prototype.impostorCount = m_impostorVisible.size();
+        m_visible.insert(m_visible.end(), m_impostorVisible.begin(), m_impostorVisible.end());
+        m_impostorVisible.clear();
+    }
+    if (m_visible.empty())
+        return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    if (m_visible.size() > m_instanceCapacity)
+        m_instanceCapacity = std::max(m_visible.size(), m_instanceCapacity * 2);
+    // Orphan first so the driver doesn't wait on last frame's draws
+    glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity * sizeof(DrawInstance), nullptr,
+                 GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, m_visible.size() * sizeof(DrawInstance),
+                    m_visible.data());
+
+    m_shader.use();
+    m_shader.setMat4("view", view);
+    m_shader.setMat4("projection", projection);
+    m_shader.setInt("texture1", 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    // GL 3.3 has no base instance, so each draw points the instance attributes at its own run
+    // of the buffer instead
+    MeshPool& pool = m_streamer->getMeshPool();
+    pool.bind();
+    for (const Prototype& prototype : m_prototypes)
+    {
+        const StreamedAsset& asset = m_streamer->getAsset(prototype.asset);
+        if (std::all_of(prototype.visibleCount, prototype.visibleCount + MAX_MESH_LODS,
+                        [](size_t count) { return count == 0; }))
+            continue;
+        setVertexQuantization(m_shader, asset.quantization);
+        for (int lod = 0; lod < MAX_MESH_LODS; ++lod)
+        {
+            size_t count = prototype.visibleCount[lod];
+            if (count == 0)
+                continue;
+            setInstanceAttributes(prototype.firstVisible[lod] * sizeof(DrawInstance));
+            for (const StreamedBatch& batch : asset.batches)
+            {
+                glBindTexture(GL_TEXTURE_2D, batch.texture);
+                pool.drawInstanced(batch.lods[lod], static_cast<GLsizei>(count));
+                m_drawnTriangles += count * (batch.lods[lod].indexCount / 3);
+                m_drawCount++;
+            }
+            m_drawnInstances += static_cast<int>(count);
+        }
+    }
+
+    // One quad per impostor, facing the frame it shows
+    m_impostorShader.use();
+    m_impostorShader.setMat4("view", view);
+    m_impostorShader.setMat4("projection", projection);
+    m_impostorShader.setVec3("viewPos", viewPos);
+    m_impostorShader.setInt("atlas", 0);
+    glBindVertexArray(m_impostorVao);
+    for (const Prototype& prototype : m_prototypes)
+    {
+        if (prototype.impostorCount == 0)
+            continue;
+        const StreamedAsset& asset = m_streamer->getAsset(prototype.asset);
+        m_impostorShader.setVec3("boundsCenter", (asset.boundsMin + asset.boundsMax) * 0.5f);
+        m_impostorShader.setFloat("boundsRadius",
+                                  glm::length(asset.boundsMax - asset.boundsMin) * 0.5f);
+        m_impostorShader.setInt("gridSize", prototype.impostorGrid);
+        setInstanceAttributes(prototype.firstImpostor * sizeof(DrawInstance));
+        glBindTexture(GL_TEXTURE_2D, prototype.impostorAtlas);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4,
+                              static_cast<GLsizei>(prototype.impostorCount));
+        m_drawnImpostors += static_cast<int>(prototype.impostorCount);
+        m_drawnTriangles += prototype.impostorCount * 2;
+        m_drawCount++;
+    }
+    glBindVertexArray(0);
+}
@@ -0,0 +1,250 @@
+#include "scatter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iterator>
+#include <iostream>
+
+// SplitMix64 finalizer
+static uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+uint32_t ScatterRng::next()
+{
+    return static_cast<uint32_t>(mix64(m_key + ++m_counter * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+uint64_t scatterKey(uint64_t seed, glm::ivec2 cell, uint32_t layer)
+{
+    uint64_t coord = static_cast<uint64_t>(static_cast<uint32_t>(cell.x)) |
+                     (static_cast<uint64_t>(static_cast<uint32_t>(cell.y)) << 32);
+    return mix64(mix64(seed) ^ mix64(coord) ^ mix64(0x51A7C0DEull + layer));
+}
+
+static int jitterStrata(const ScatterLayer& layer, float cellSize)
+{
+    return std::max(1, static_cast<int>(std::lround(std::sqrt(layer.density) * cellSize)));
+}
+
+size_t scatterCapacity(const ScatterLayer& layer, float cellSize)
+{
+    if (layer.pattern == ScatterPattern::Jittered)
+    {
+        int strata = jitterStrata(layer, cellSize);
+        return static_cast<size_t>(strata * strata);
+    }
+    return static_cast<size_t>(std::ceil(layer.density * cellSize * cellSize));
+}
+
+// Drops the points the mask rejects. Every point rolls against the mask whether or not there is
+// one, so adding a mask never moves the points that survive it.
+static size_t applyMask(const ScatterLayer& layer, ScatterPoint* points, size_t count)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        // Keyed apart from the point's attribute stream so masks don't skew the attributes
+        ScatterRng roll(static_cast<uint64_t>(points[i].hash) | 0xA5A5A5A500000000ull);
+        float chance = roll.uniform();
+        if (!layer.mask || chance < layer.mask(points[i].position))
+            points[kept++] = points[i];
+    }
+    return kept;
+}
+
+static size_t scatterJittered(ScatterRng& rng, const ScatterLayer& layer, glm::vec2 origin,
+                              float cellSize, ScatterPoint* out)
+{
+    int strata = jitterStrata(layer, cellSize);
+    float step = cellSize / strata;
+
+    size_t count = 0;
+    for (int z = 0; z < strata; ++z)
+    {
+        for (int x = 0; x < strata; ++x)
+        {
+            float jitterX = rng.uniform();
+            float jitterZ = rng.uniform();
+            out[count].position = origin + glm::vec2(x + jitterX, z + jitterZ) * step;
+            out[count].hash = rng.next();
+            count++;
+        }
+    }
+
+    // Fisher-Yates, so any prefix of the cell is an even subset rather than its first rows. The
+    // grass LOD thins cells by keeping a prefix.
+    for (size_t i = count - 1; i > 0; --i)
+        std::swap(out[i], out[rng.next() % (i + 1)]);
+    return count;
+}
+
+static size_t scatterPoisson(ScatterRng& rng, const ScatterLayer& layer, glm::vec2 origin,
+                             float cellSize, ScatterPoint* out)
+{
+    const int attempts = 30;
+    float spacing = std::max(layer.minSpacing, 1e-3f);
+    // Staying half the spacing away from the edges keeps the spacing between cells too
+    float margin = std::min(spacing * 0.5f, cellSize * 0.5f);
+    float span = cellSize - 2.0f * margin;
+
+    // Stochastic rounding keeps the average density right for cells that expect under one point
+    float expected = layer.density * cellSize * cellSize;
+    size_t target = static_cast<size_t>(std::floor(expected + rng.uniform()));
+
+    // Buckets small enough to hold at most one point each
+    float bucketSize = spacing / std::sqrt(2.0f);
+    int buckets = std::max(1, static_cast<int>(std::ceil(cellSize / bucketSize)));
+    std::vector<int> grid(buckets * buckets, -1);
+
+    size_t count = 0;
+    for (size_t i = 0; i < target; ++i)
+    {
+        for (int attempt = 0; attempt < attempts; ++attempt)
+        {
+            glm::vec2 local(margin + span * rng.uniform(), margin + span * rng.uniform());
+            int bx = std::min(buckets - 1, static_cast<int>(local.x / bucketSize));
+            int bz = std::min(buckets - 1, static_cast<int>(local.y / bucketSize));
+
+            bool free = true;
+            for (int z = std::max(0, bz - 2); free && z <= std::min(buckets - 1, bz + 2); ++z)
+            {
+                for (int x = std::max(0, bx - 2); x <= std::min(buckets - 1, bx + 2); ++x)
+                {
+                    int other = grid[z * buckets + x];
+                    if (other >= 0 &&
+                        glm::distance(out[other].position - origin, local) < spacing)
+                    {
+                        free = false;
+                        break;
+                    }
+                }
+            }
+            if (!free)
+                continue;
+
+            grid[bz * buckets + bx] = static_cast<int>(count);
+            out[count].position = origin + local;
+            out[count].hash = rng.next();
+            count++;
+            break;
+        }
+    }
+    return count;
+}
+
+size_t scatterCell(uint64_t seed, const ScatterLayer& layer, glm::ivec2 cell, float cellSize,
+                   ScatterPoint* out)
+{
+    ScatterRng rng(scatterKey(seed, cell, layer.id));
+    glm::vec2 origin = glm::vec2(cell) * cellSize;
+    size_t count = layer.pattern == ScatterPattern::Jittered
+                       ? scatterJittered(rng, layer, origin, cellSize, out)
+                       : scatterPoisson(rng, layer, origin, cellSize, out);
+    return applyMask(layer, out, count);
+}
+
+std::vector<PropLayer> loadEnvironmentPropLayers(const std::string& directory)
+{
+    struct Kind
+    {
+        const char* prefix;
+        float density;
+        float minSpacing;
+        float minScale;
+        float maxScale;
+    };
+    // Grass meshes are left out, GrassManager covers the ground
+    const Kind kinds[] = {
+        { "Tree", 0.004f, 8.0f, 0.8f, 1.2f },
+        { "Rock", 0.01f, 3.0f, 0.6f, 1.4f },
+        { "Bush", 0.02f, 2.5f, 0.8f, 1.2f },
+    };
+
+    std::vector<std::string> files;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        if (entry.path().extension() == ".gltf")
+            files.push_back(entry.path().string());
+    }
+    if (error)
+    {
+        std::cerr << "Failed to list props in " << directory << ": " << error.message()
+                  << std::endl;
+    }
+    // Directory order isn't stable, asset indices have to be
+    std::sort(files.begin(), files.end());
+
+    std::vector<PropLayer> layers;
+    for (uint32_t k = 0; k < std::size(kinds); ++k)
+    {
+        const Kind& kind = kinds[k];
+        PropLayer layer;
+        layer.name = kind.prefix;
+        for (const auto& file : files)
+        {
+            if (std::filesystem::path(file).filename().string().rfind(kind.prefix, 0) == 0)
+                layer.assets.push_back(file);
+        }
+        if (layer.assets.empty())
+            continue;
+
+        layer.scatter.id = 1 + k; // 0 is the grass
+        layer.scatter.pattern = ScatterPattern::Poisson;
+        layer.scatter.density = kind.density;
+        layer.scatter.minSpacing = kind.minSpacing;
+        layer.minScale = kind.minScale;
+        layer.maxScale = kind.maxScale;
+        layers.push_back(std::move(layer));
+    }
+    return layers;
+}
+
+std::vector<PropPlacement> scatterProps(uint64_t seed, const std::vector<PropLayer>& layers,
+                                        glm::ivec2 cellMin, glm::ivec2 cellMax, float cellSize,
+                                        ThreadPool* pool)
+{
+    glm::ivec2 extent = glm::max(cellMax - cellMin + 1, glm::ivec2(0));
+    std::vector<std::vector<PropPlacement>> cells(static_cast<size_t>(extent.x) * extent.y);
+
+    parallelFor(pool, cells.size(),
+                [&](size_t index)
+                {
+                    glm::ivec2 cell = cellMin + glm::ivec2(static_cast<int>(index % extent.x),
+                                                           static_cast<int>(index / extent.x));
+                    std::vector<ScatterPoint> points;
+                    for (size_t l = 0; l < layers.size(); ++l)
+                    {
+                        const PropLayer& layer = layers[l];
+                        points.resize(scatterCapacity(layer.scatter, cellSize));
+                        size_t count =
+                            scatterCell(seed, layer.scatter, cell, cellSize, points.data());
+                        for (size_t i = 0; i < count; ++i)
+                        {
+                            ScatterRng rng(points[i].hash);
+                            PropPlacement placement;
+                            placement.layer = static_cast<uint16_t>(l);
+                            placement.asset =
+                                static_cast<uint16_t>(rng.next() % layer.assets.size());
+                            placement.position =
+                                glm::vec3(points[i].position.x, 0.0f, points[i].position.y);
+                            placement.rotation = rng.range(0.0f, 360.0f);
+                            placement.scale = rng.range(layer.minScale, layer.maxScale);
+                            cells[index].push_back(placement);
+                        }
+                    }
+                });
+
+    std::vector<PropPlacement> placements;
+    for (const auto& cell : cells)
+        placements.insert(placements.end(), cell.begin(), cell.end());
+    return placements;
+}
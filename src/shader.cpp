@@ -5,29 +5,14 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
 {
     std::string vertexCode;
     std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
     try
     {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-
-        vShaderFile.close();
-        fShaderFile.close();
-
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
+        vertexCode = readFile(vertexPath);
+        fragmentCode = readFile(fragmentPath);
     }
-    catch (std::ifstream::failure& e)
+    catch (const std::runtime_error& e)
     {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ " << e.what() << std::endl;
     }
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
@@ -105,7 +90,7 @@ Shader& Shader::operator=(Shader&& other) noexcept
     return *this;
 }
 
-// Read whole file into a string
+// Read whole file into a string, expanding `#include "file"` lines relative to the including file
 std::string Shader::readFile(std::string_view filename)
 {
     std::ifstream file{ std::string(filename) };
@@ -113,8 +98,32 @@ std::string Shader::readFile(std::string_view filename)
     {
         throw std::runtime_error("Failed to open file: " + std::string(filename));
     }
+
+    const std::string directory = [&]
+    {
+        size_t slash = filename.find_last_of('/');
+        return slash == std::string_view::npos ? std::string()
+                                               : std::string(filename.substr(0, slash + 1));
+    }();
+
     std::stringstream buffer;
-    buffer << file.rdbuf();
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if (start != std::string::npos && line.compare(start, 8, "#include") == 0)
+        {
+            size_t open = line.find('"', start);
+            size_t close = line.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos)
+            {
+                throw std::runtime_error("Malformed #include in " + std::string(filename));
+            }
+            buffer << readFile(directory + line.substr(open + 1, close - open - 1)) << '\n';
+            continue;
+        }
+        buffer << line << '\n';
+    }
     return buffer.str();
 }
 
@@ -124,7 +133,8 @@ ShaderProgram::ShaderProgram()
 {
 }
 
-ShaderProgram::ShaderProgram(const std::vector<Shader>& shaders)
+ShaderProgram::ShaderProgram(const std::vector<Shader>& shaders,
+                             const std::vector<std::string>& feedbackVaryings)
     : id_{ glCreateProgram() }
 {
     for (const auto& shader : shaders)
@@ -132,6 +142,15 @@ ShaderProgram::ShaderProgram(const std::vector<Shader>& shaders)
         glAttachShader(id_, shader.id_);
     }
 
+    if (!feedbackVaryings.empty())
+    {
+        std::vector<const char*> names;
+        for (const auto& varying : feedbackVaryings)
+            names.push_back(varying.c_str());
+        glTransformFeedbackVaryings(id_, static_cast<GLsizei>(names.size()), names.data(),
+                                    GL_INTERLEAVED_ATTRIBS);
+    }
+
     glLinkProgram(id_);
     checkLinkingError(id_);
 }
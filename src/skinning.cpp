@@ -0,0 +1,73 @@
+#include "skinning.h"
+#include "gltf_accessor.h"
+#include "tiny_gltf.h"
+#include "transform_hierarchy.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+std::vector<Skin> loadSkins(const tinygltf::Model& model)
+{
+    std::vector<Skin> skins;
+    for (const auto& gltfSkin : model.skins)
+    {
+        Skin skin;
+        skin.joints = gltfSkin.joints;
+        if (skin.joints.size() > MAX_JOINTS)
+        {
+            std::cerr << "Skin " << gltfSkin.name << " has " << skin.joints.size()
+                      << " joints, only " << MAX_JOINTS << " are skinned" << std::endl;
+            skin.joints.resize(MAX_JOINTS);
+        }
+
+        // Missing inverse bind matrices mean identity
+        skin.inverseBindMatrices.assign(skin.joints.size(), glm::mat4(1.0f));
+        std::vector<float> matrices = readAccessorFloats(model, gltfSkin.inverseBindMatrices, 16);
+        size_t count = std::min(skin.joints.size(), matrices.size() / 16);
+        for (size_t j = 0; j < count; ++j)
+            std::memcpy(&skin.inverseBindMatrices[j], &matrices[j * 16], sizeof(glm::mat4));
+
+        skins.push_back(std::move(skin));
+    }
+    return skins;
+}
+
+void computeJointPalette(const Skin& skin, const TransformHierarchy& hierarchy,
+                         std::vector<glm::mat4>& palette)
+{
+    palette.resize(skin.joints.size());
+    for (size_t j = 0; j < skin.joints.size(); ++j)
+        palette[j] = hierarchy.getWorldMatrix(skin.joints[j]) * skin.inverseBindMatrices[j];
+}
+
+void bindJointPaletteBlock(GLuint program)
+{
+    GLuint block = glGetUniformBlockIndex(program, "JointPalette");
+    if (block != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, block, JOINT_PALETTE_BINDING);
+}
+
+JointPaletteBuffer::JointPaletteBuffer()
+    : m_buffer(0)
+{
+}
+
+JointPaletteBuffer::~JointPaletteBuffer() { glDeleteBuffers(1, &m_buffer); }
+
+void JointPaletteBuffer::initialize()
+{
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, MAX_JOINTS * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void JointPaletteBuffer::upload(const std::vector<glm::mat4>& palette)
+{
+    size_t count = std::min(palette.size(), static_cast<size_t>(MAX_JOINTS));
+    glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    // Orphan first so the driver doesn't wait on draws still reading the last palette
+    glBufferData(GL_UNIFORM_BUFFER, MAX_JOINTS * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(glm::mat4), palette.data());
+    glBindBufferBase(GL_UNIFORM_BUFFER, JOINT_PALETTE_BINDING, m_buffer);
+}
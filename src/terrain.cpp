@@ -0,0 +1,442 @@
+#include "terrain.h"
+#include "FastNoiseLite.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+TerrainGenerator::TerrainGenerator(const TerrainSettings& settings)
+    : m_noise(std::make_unique<FastNoiseLite>(static_cast<int>(settings.seed ^
+                                                                (settings.seed >> 32))))
+    , m_heightScale(settings.heightScale)
+{
+    m_noise->SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+    m_noise->SetFractalType(FastNoiseLite::FractalType_FBm);
+    m_noise->SetFractalOctaves(settings.noiseOctaves);
+    m_noise->SetFrequency(settings.noiseFrequency);
+}
+
+TerrainGenerator::~TerrainGenerator() = default;
+
+float TerrainGenerator::sample(float x, float z) const
+{
+    return m_noise->GetNoise(x, z) * m_heightScale;
+}
+
+// Chunk indices are 16 bit, so a chunk can't have more than 65536 vertices
+static TerrainSettings checkSettings(const TerrainSettings& settings)
+{
+    const int maxResolution = 128; // The largest power of two with (resolution + 1)^2 <= 65536
+    TerrainSettings checked = settings;
+    if (checked.chunkResolution > maxResolution)
+    {
+        std::cerr << "Terrain chunkResolution " << checked.chunkResolution
+                  << " overflows 16 bit indices, using " << maxResolution << std::endl;
+        checked.chunkResolution = maxResolution;
+    }
+    return checked;
+}
+
+Terrain::Terrain(const TerrainSettings& settings)
+    : m_settings(checkSettings(settings))
+    , m_generator(std::make_shared<TerrainGenerator>(m_settings))
+    , m_query(m_settings, m_generator)
+    , m_threadPool(nullptr)
+    , m_gridSize(m_settings.chunkResolution + 1)
+    , m_lodCount(0)
+    , m_jobsInFlight(0)
+    , m_indexBuffer(0)
+    , m_residentChunks(0)
+    , m_pendingChunks(0)
+    , m_drawnChunks(0)
+    , m_drawnTriangles(0)
+{
+    // One LOD per halving, down to two quads per side so a coarser neighbour still exists
+    for (int step = 1; step * 2 <= m_settings.chunkResolution; step *= 2)
+        m_lodCount++;
+}
+
+Terrain::~Terrain()
+{
+    for (auto& [key, chunk] : m_chunks)
+        releaseChunk(chunk);
+    for (const auto& [vao, vbo] : m_freeBuffers)
+    {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+    }
+    glDeleteBuffers(1, &m_indexBuffer);
+}
+
+void Terrain::initialize()
+{
+    m_shader = ShaderBuilder()
+                   .load("shaders/terrain.vert.glsl", Shader::Type::Vertex)
+                   .load("shaders/terrain.frag.glsl", Shader::Type::Fragment)
+                   .build();
+    buildIndices();
+}
+
+uint64_t Terrain::chunkKey(glm::ivec2 coord)
+{
+    return static_cast<uint64_t>(static_cast<uint32_t>(coord.x)) |
+           (static_cast<uint64_t>(static_cast<uint32_t>(coord.y)) << 32);
+}
+
+// Samples the chunk's grid plus a one sample border for the normals. Runs on the workers, so it
+// only touches its arguments.
+void Terrain::buildChunk(const TerrainGenerator& generator, const TerrainSettings& settings,
+                         glm::ivec2 coord, ChunkBuild& build)
+{
+    int grid = settings.chunkResolution + 1;
+    int border = grid + 2;
+    float spacing = settings.chunkSize / settings.chunkResolution;
+    glm::vec2 origin = glm::vec2(coord) * settings.chunkSize;
+
+    std::vector<float> heights(border * border);
+    for (int z = 0; z < border; ++z)
+    {
+        for (int x = 0; x < border; ++x)
+        {
+            heights[z * border + x] =
+                generator.sample(origin.x + (x - 1) * spacing, origin.y + (z - 1) * spacing);
+        }
+    }
+
+    build.vertices.resize(grid * grid);
+    build.heights = std::make_shared<std::vector<float>>(grid * grid);
+    build.minHeight = heights[border + 1];
+    build.maxHeight = heights[border + 1];
+    for (int z = 0; z < grid; ++z)
+    {
+        for (int x = 0; x < grid; ++x)
+        {
+            const float* h = &heights[(z + 1) * border + (x + 1)];
+            float dx = (h[1] - h[-1]) / (2.0f * spacing);
+            float dz = (h[border] - h[-border]) / (2.0f * spacing);
+            glm::vec3 normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+
+            TerrainVertex& vertex = build.vertices[z * grid + x];
+            vertex.height = h[0];
+            (*build.heights)[z * grid + x] = h[0];
+            vertex.normal[0] = static_cast<int16_t>(std::lround(normal.x * 32767.0f));
+            vertex.normal[1] = static_cast<int16_t>(std::lround(normal.y * 32767.0f));
+            vertex.normal[2] = static_cast<int16_t>(std::lround(normal.z * 32767.0f));
+            vertex.normal[3] = 0;
+            build.minHeight = std::min(build.minHeight, h[0]);
+            build.maxHeight = std::max(build.maxHeight, h[0]);
+        }
+    }
+}
+
+// Every LOD and every combination of coarser neighbours gets its own index range. On an edge
+// facing a coarser chunk the odd vertices are snapped onto the previous even one, which folds the
+// triangles there onto the neighbour's edge and leaves no T-junction to crack.
+void Terrain::buildIndices()
+{
+    const int res = m_settings.chunkResolution;
+    std::vector<uint16_t> indices;
+    m_indexRanges.assign(m_lodCount * 16, IndexRange{ 0, 0 });
+
+    for (int lod = 0; lod < m_lodCount; ++lod)
+    {
+        int step = 1 << lod;
+        int coarse = step * 2;
+        for (int mask = 0; mask < 16; ++mask)
+        {
+            auto index = [&](int x, int z)
+            {
+                if ((mask & 1) && z == 0)
+                    x = x / coarse * coarse;
+                if ((mask & 2) && x == res)
+                    z = z / coarse * coarse;
+                if ((mask & 4) && z == res)
+                    x = x / coarse * coarse;
+                if ((mask & 8) && x == 0)
+                    z = z / coarse * coarse;
+                return static_cast<uint16_t>(z * m_gridSize + x);
+            };
+            auto triangle = [&](uint16_t a, uint16_t b, uint16_t c)
+            {
+                // Snapping collapses some triangles, no point drawing them
+                if (a == b || b == c || a == c)
+                    return;
+                indices.push_back(a);
+                indices.push_back(b);
+                indices.push_back(c);
+            };
+
+            IndexRange& range = m_indexRanges[lod * 16 + mask];
+            range.offset = indices.size() * sizeof(uint16_t);
+            for (int z = 0; z < res; z += step)
+            {
+                for (int x = 0; x < res; x += step)
+                {
+                    uint16_t a = index(x, z);
+                    uint16_t b = index(x + step, z);
+                    uint16_t c = index(x, z + step);
+                    uint16_t d = index(x + step, z + step);
+                    triangle(a, c, b);
+                    triangle(b, c, d);
+                }
+            }
+            range.count =
+                static_cast<GLsizei>(indices.size() - range.offset / sizeof(uint16_t));
+        }
+    }
+
+    glGenBuffers(1, &m_indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Terrain::uploadChunk(Chunk& chunk)
+{
+    if (!m_freeBuffers.empty())
+    {
+        chunk.vao = m_freeBuffers.back().first;
+        chunk.vbo = m_freeBuffers.back().second;
+        m_freeBuffers.pop_back();
+        glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, chunk.build->vertices.size() * sizeof(TerrainVertex),
+                        chunk.build->vertices.data());
+    }
+    else
+    {
+        glGenVertexArrays(1, &chunk.vao);
+        glGenBuffers(1, &chunk.vbo);
+        glBindVertexArray(chunk.vao);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+        glBufferData(GL_ARRAY_BUFFER, chunk.build->vertices.size() * sizeof(TerrainVertex),
+                     chunk.build->vertices.data(), GL_DYNAMIC_DRAW);
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 1, GL_FLOAT, GL_FALSE, sizeof(TerrainVertex),
+                              (void*)offsetof(TerrainVertex, height));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 4, GL_SHORT, GL_TRUE, sizeof(TerrainVertex),
+                              (void*)offsetof(TerrainVertex, normal));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+        glBindVertexArray(0);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    chunk.minHeight = chunk.build->minHeight;
+    chunk.maxHeight = chunk.build->maxHeight;
+    m_query.insertChunk(chunk.coord, std::move(chunk.build->heights));
+    chunk.build.reset();
+    chunk.resident = true;
+}
+
+// Keeps the buffers around for the next chunk, they all have the same size
+void Terrain::releaseChunk(Chunk& chunk)
+{
+    if (chunk.resident)
+    {
+        m_freeBuffers.emplace_back(chunk.vao, chunk.vbo);
+        m_query.removeChunk(chunk.coord);
+    }
+    chunk.resident = false;
+    chunk.vao = 0;
+    chunk.vbo = 0;
+}
+
+void Terrain::update(const glm::vec3& center)
+{
+    glm::vec2 centerXZ(center.x, center.z);
+    glm::ivec2 centerChunk(static_cast<int>(std::floor(center.x / m_settings.chunkSize)),
+                           static_cast<int>(std::floor(center.z / m_settings.chunkSize)));
+    float chunkSize = m_settings.chunkSize;
+    float keepRadius = m_settings.viewRadius * chunkSize;
+    // A chunk of slack before dropping, so walking along a border doesn't thrash
+    float dropRadius = keepRadius + chunkSize;
+
+    auto distanceTo = [&](glm::ivec2 coord)
+    {
+        glm::vec2 min = glm::vec2(coord) * chunkSize;
+        return glm::distance(centerXZ, glm::clamp(centerXZ, min, min + glm::vec2(chunkSize)));
+    };
+
+    for (auto it = m_chunks.begin(); it != m_chunks.end();)
+    {
+        if (distanceTo(it->second.coord) > dropRadius)
+        {
+            // A worker may still be writing the build, it keeps its job slot until done
+            if (it->second.build)
+                m_orphanedBuilds.push_back(std::move(it->second.build));
+            releaseChunk(it->second);
+            it = m_chunks.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    auto finished = [](const std::shared_ptr<ChunkBuild>& build)
+    { return build->ready.load(std::memory_order_acquire); };
+    auto orphansEnd =
+        std::remove_if(m_orphanedBuilds.begin(), m_orphanedBuilds.end(), finished);
+    m_jobsInFlight -= static_cast<int>(m_orphanedBuilds.end() - orphansEnd);
+    m_orphanedBuilds.erase(orphansEnd, m_orphanedBuilds.end());
+
+    // Upload what the workers finished, nearest first and a few per frame to keep the frame
+    // time flat
+    m_readyChunks.clear();
+    m_residentChunks = 0;
+    for (auto& [key, chunk] : m_chunks)
+    {
+        if (!chunk.resident && chunk.build && finished(chunk.build))
+            m_readyChunks.push_back(&chunk);
+        m_residentChunks += chunk.resident ? 1 : 0;
+    }
+    int uploads = std::min(static_cast<int>(m_readyChunks.size()), m_settings.uploadBudget);
+    std::partial_sort(m_readyChunks.begin(), m_readyChunks.begin() + uploads, m_readyChunks.end(),
+                      [&](const Chunk* a, const Chunk* b)
+                      { return distanceTo(a->coord) < distanceTo(b->coord); });
+    for (int i = 0; i < uploads; ++i)
+        uploadChunk(*m_readyChunks[i]);
+    m_jobsInFlight -= uploads;
+    m_residentChunks += uploads;
+
+    m_missing.clear();
+    int radius = m_settings.viewRadius;
+    for (int z = -radius; z <= radius; ++z)
+    {
+        for (int x = -radius; x <= radius; ++x)
+        {
+            glm::ivec2 coord = centerChunk + glm::ivec2(x, z);
+            if (distanceTo(coord) <= keepRadius && !m_chunks.count(chunkKey(coord)))
+                m_missing.push_back(coord);
+        }
+    }
+    std::sort(m_missing.begin(), m_missing.end(),
+              [&](glm::ivec2 a, glm::ivec2 b) { return distanceTo(a) < distanceTo(b); });
+    m_pendingChunks = static_cast<int>(m_missing.size()) + m_jobsInFlight;
+
+    // Without workers the chunks are built right here, one upload budget per frame
+    bool async = m_threadPool && m_threadPool->getThreadCount() > 0;
+    int capacity = async ? m_settings.maxJobsInFlight - m_jobsInFlight
+                         : m_settings.uploadBudget - uploads;
+    size_t queue = std::min(m_missing.size(), static_cast<size_t>(std::max(capacity, 0)));
+    for (size_t i = 0; i < queue; ++i)
+    {
+        Chunk& chunk = m_chunks[chunkKey(m_missing[i])];
+        chunk.coord = m_missing[i];
+        chunk.build = std::make_shared<ChunkBuild>();
+        m_jobsInFlight++;
+
+        if (async)
+        {
+            m_threadPool->submit(
+                [generator = m_generator, settings = m_settings, coord = chunk.coord,
+                 build = chunk.build]
+                {
+                    buildChunk(*generator, settings, coord, *build);
+                    build->ready.store(true, std::memory_order_release);
+                });
+        }
+        else
+        {
+            buildChunk(*m_generator, m_settings, chunk.coord, *chunk.build);
+            uploadChunk(chunk);
+            m_jobsInFlight--;
+            m_residentChunks++;
+        }
+    }
+}
+
+// Detail drops one level every lodDistance, then neighbours are pulled to within one level of
+// each other since the stitched edges only bridge a single step
+void Terrain::selectLods(const glm::vec3& viewPos)
+{
+    for (auto& [key, chunk] : m_chunks)
+    {
+        glm::vec3 min(chunk.coord.x * m_settings.chunkSize, chunk.minHeight,
+                      chunk.coord.y * m_settings.chunkSize);
+        glm::vec3 max(min.x + m_settings.chunkSize, chunk.maxHeight, min.z + m_settings.chunkSize);
+        float distance = glm::distance(viewPos, glm::clamp(viewPos, min, max));
+        chunk.lod = std::min(static_cast<int>(distance / m_settings.lodDistance), m_lodCount - 1);
+    }
+
+    const glm::ivec2 offsets[4] = { { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, 0 } };
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (auto& [key, chunk] : m_chunks)
+        {
+            for (const glm::ivec2& offset : offsets)
+            {
+                auto neighbour = m_chunks.find(chunkKey(chunk.coord + offset));
+                if (neighbour != m_chunks.end() && chunk.lod > neighbour->second.lod + 1)
+                {
+                    chunk.lod = neighbour->second.lod + 1;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+void Terrain::render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos,
+                     const std::array<Camera::FrustumPlane, 6>& frustumPlanes)
+{
+    m_drawnChunks = 0;
+    m_drawnTriangles = 0;
+    if (m_indexRanges.empty())
+        return;
+
+    selectLods(viewPos);
+
+    m_shader.use();
+    m_shader.setMat4("view", view);
+    m_shader.setMat4("projection", projection);
+    m_shader.setVec3("viewPos", viewPos);
+    m_shader.setFloat("gridSpacing", m_settings.chunkSize / m_settings.chunkResolution);
+    m_shader.setInt("gridSize", m_gridSize);
+
+    // Edge bits in the order buildIndices reads them: -z, +x, +z, -x
+    const glm::ivec2 offsets[4] = { { 0, -1 }, { 1, 0 }, { 0, 1 }, { -1, 0 } };
+    for (const auto& [key, chunk] : m_chunks)
+    {
+        if (!chunk.resident)
+            continue;
+
+        glm::vec3 min(chunk.coord.x * m_settings.chunkSize, chunk.minHeight,
+                      chunk.coord.y * m_settings.chunkSize);
+        glm::vec3 max(min.x + m_settings.chunkSize, chunk.maxHeight, min.z + m_settings.chunkSize);
+        bool visible = true;
+        for (const auto& plane : frustumPlanes)
+        {
+            glm::vec3 positive(plane.normal.x >= 0 ? max.x : min.x,
+                               plane.normal.y >= 0 ? max.y : min.y,
+                               plane.normal.z >= 0 ? max.z : min.z);
+            if (glm::dot(plane.normal, positive) + plane.distance < 0)
+            {
+                visible = false;
+                break;
+            }
+        }
+        if (!visible)
+            continue;
+
+        int mask = 0;
+        for (int edge = 0; edge < 4; ++edge)
+        {
+            auto neighbour = m_chunks.find(chunkKey(chunk.coord + offsets[edge]));
+            if (neighbour != m_chunks.end() && neighbour->second.resident &&
+                neighbour->second.lod > chunk.lod)
+                mask |= 1 << edge;
+        }
+
+        const IndexRange& range = m_indexRanges[chunk.lod * 16 + mask];
+        m_shader.setVec2("chunkOrigin", glm::vec2(min.x, min.z));
+        glBindVertexArray(chunk.vao);
+        glDrawElements(GL_TRIANGLES, range.count, GL_UNSIGNED_SHORT, (void*)range.offset);
+        m_drawnChunks++;
+        m_drawnTriangles += range.count / 3;
+    }
+    glBindVertexArray(0);
+}
@@ -0,0 +1,259 @@
+#include "terrain_query.h"
+#include "terrain.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+static int floorDiv(int value, int divisor)
+{
+    return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+static int floorMod(int value, int divisor)
+{
+    int mod = value % divisor;
+    return mod < 0 ? mod + divisor : mod;
+}
+
+static float bilinear(const float corners[4], float fx, float fz)
+{
+    return glm::mix(glm::mix(corners[0], corners[1], fx), glm::mix(corners[2], corners[3], fx), fz);
+}
+
+static glm::vec3 bilinearNormal(const float corners[4], float fx, float fz, float spacing)
+{
+    float dx = glm::mix(corners[1] - corners[0], corners[3] - corners[2], fz) / spacing;
+    float dz = glm::mix(corners[2] - corners[0], corners[3] - corners[1], fx) / spacing;
+    return glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+}
+
+TerrainQuery::TerrainQuery(const TerrainSettings& settings,
+                           std::shared_ptr<const TerrainGenerator> generator)
+    : m_generator(std::move(generator))
+    , m_chunkSize(settings.chunkSize)
+    , m_spacing(settings.chunkSize / settings.chunkResolution)
+    , m_resolution(settings.chunkResolution)
+    , m_gridSize(settings.chunkResolution + 1)
+    // Resident chunks stay within viewRadius + 2 of the center chunk, so this never collides
+    , m_tableSize(2 * settings.viewRadius + 5)
+    , m_table(m_tableSize * m_tableSize, Slot{ glm::ivec2(std::numeric_limits<int>::min()), {} })
+{
+}
+
+size_t TerrainQuery::slotIndex(glm::ivec2 chunk) const
+{
+    return static_cast<size_t>(floorMod(chunk.y, m_tableSize) * m_tableSize +
+                               floorMod(chunk.x, m_tableSize));
+}
+
+void TerrainQuery::insertChunk(glm::ivec2 coord, std::shared_ptr<const std::vector<float>> heights)
+{
+    Slot& slot = m_table[slotIndex(coord)];
+    slot.coord = coord;
+    slot.heights = std::move(heights);
+}
+
+void TerrainQuery::removeChunk(glm::ivec2 coord)
+{
+    Slot& slot = m_table[slotIndex(coord)];
+    if (slot.coord == coord)
+        slot.heights.reset();
+}
+
+const TerrainQuery::Slot* TerrainQuery::findSlot(glm::ivec2 chunk) const
+{
+    const Slot& slot = m_table[slotIndex(chunk)];
+    return slot.coord == chunk && slot.heights ? &slot : nullptr;
+}
+
+// cached carries the last chunk between calls so runs of nearby points skip the table
+void TerrainQuery::cellCorners(int cx, int cz, const Slot*& cached, float corners[4]) const
+{
+    glm::ivec2 chunk(floorDiv(cx, m_resolution), floorDiv(cz, m_resolution));
+    int lx = cx - chunk.x * m_resolution;
+    int lz = cz - chunk.y * m_resolution;
+
+    if (!cached || cached->coord != chunk)
+        cached = findSlot(chunk);
+
+    if (cached)
+    {
+        const float* row = cached->heights->data() + lz * m_gridSize + lx;
+        corners[0] = row[0];
+        corners[1] = row[1];
+        corners[2] = row[m_gridSize];
+        corners[3] = row[m_gridSize + 1];
+        return;
+    }
+
+    // Same sample positions the chunk builder uses, so the answer doesn't change once it's cached
+    glm::vec2 origin = glm::vec2(chunk) * m_chunkSize;
+    float x0 = origin.x + lx * m_spacing;
+    float x1 = origin.x + (lx + 1) * m_spacing;
+    float z0 = origin.y + lz * m_spacing;
+    float z1 = origin.y + (lz + 1) * m_spacing;
+    corners[0] = m_generator->sample(x0, z0);
+    corners[1] = m_generator->sample(x1, z0);
+    corners[2] = m_generator->sample(x0, z1);
+    corners[3] = m_generator->sample(x1, z1);
+}
+
+float TerrainQuery::height(float x, float z) const
+{
+    float result;
+    glm::vec2 position(x, z);
+    heights(&position, 1, &result);
+    return result;
+}
+
+TerrainSample TerrainQuery::sample(float x, float z) const
+{
+    TerrainSample result;
+    glm::vec2 position(x, z);
+    samples(&position, 1, &result);
+    return result;
+}
+
+void TerrainQuery::heights(const glm::vec2* positions, size_t count, float* out) const
+{
+    const Slot* cached = nullptr;
+    for (size_t i = 0; i < count; ++i)
+    {
+        float gx = positions[i].x / m_spacing;
+        float gz = positions[i].y / m_spacing;
+        float cx = std::floor(gx);
+        float cz = std::floor(gz);
+        float corners[4];
+        cellCorners(static_cast<int>(cx), static_cast<int>(cz), cached, corners);
+        out[i] = bilinear(corners, gx - cx, gz - cz);
+    }
+}
+
+void TerrainQuery::samples(const glm::vec2* positions, size_t count, TerrainSample* out) const
+{
+    const Slot* cached = nullptr;
+    for (size_t i = 0; i < count; ++i)
+    {
+        float gx = positions[i].x / m_spacing;
+        float gz = positions[i].y / m_spacing;
+        float cx = std::floor(gx);
+        float cz = std::floor(gz);
+        float corners[4];
+        cellCorners(static_cast<int>(cx), static_cast<int>(cz), cached, corners);
+        out[i].height = bilinear(corners, gx - cx, gz - cz);
+        out[i].normal = bilinearNormal(corners, gx - cx, gz - cz, m_spacing);
+    }
+}
+
+// Amanatides-Woo walk over the grid cells the segment crosses in x/z. Inside a cell the surface is
+// bilinear, which is quadratic along the segment, so three samples pin it down and the first root
+// comes out in closed form.
+bool TerrainQuery::raycast(const glm::vec3& start, const glm::vec3& end, TerrainHit& hit) const
+{
+    const float infinity = std::numeric_limits<float>::infinity();
+    glm::vec3 delta = end - start;
+    glm::vec2 grid(start.x / m_spacing, start.z / m_spacing);
+    glm::vec2 gridDelta(delta.x / m_spacing, delta.z / m_spacing);
+
+    int cx = static_cast<int>(std::floor(grid.x));
+    int cz = static_cast<int>(std::floor(grid.y));
+    int stepX = gridDelta.x > 0.0f ? 1 : -1;
+    int stepZ = gridDelta.y > 0.0f ? 1 : -1;
+    float tDeltaX = gridDelta.x != 0.0f ? 1.0f / std::abs(gridDelta.x) : infinity;
+    float tDeltaZ = gridDelta.y != 0.0f ? 1.0f / std::abs(gridDelta.y) : infinity;
+    float tMaxX = gridDelta.x > 0.0f   ? (cx + 1 - grid.x) * tDeltaX
+                  : gridDelta.x < 0.0f ? (grid.x - cx) * tDeltaX
+                                       : infinity;
+    float tMaxZ = gridDelta.y > 0.0f   ? (cz + 1 - grid.y) * tDeltaZ
+                  : gridDelta.y < 0.0f ? (grid.y - cz) * tDeltaZ
+                                       : infinity;
+
+    // Guards against float drift walking past the last cell
+    int cellsLeft = static_cast<int>(std::abs(std::floor(grid.x + gridDelta.x) - cx) +
+                                     std::abs(std::floor(grid.y + gridDelta.y) - cz)) +
+                    2;
+
+    const Slot* cached = nullptr;
+    float t = 0.0f;
+    while (cellsLeft-- > 0)
+    {
+        float tExit = std::min(std::min(tMaxX, tMaxZ), 1.0f);
+
+        float corners[4];
+        cellCorners(cx, cz, cached, corners);
+        float highest =
+            std::max(std::max(corners[0], corners[1]), std::max(corners[2], corners[3]));
+        float lowestRay = std::min(start.y + delta.y * t, start.y + delta.y * tExit);
+
+        if (lowestRay <= highest)
+        {
+            auto above = [&](float at)
+            {
+                glm::vec3 point = start + delta * at;
+                float fx = glm::clamp(point.x / m_spacing - cx, 0.0f, 1.0f);
+                float fz = glm::clamp(point.z / m_spacing - cz, 0.0f, 1.0f);
+                return point.y - bilinear(corners, fx, fz);
+            };
+            float f0 = above(t);
+            float fm = above(0.5f * (t + tExit));
+            float f1 = above(tExit);
+
+            // f(u) = a u^2 + b u + c over u in [0, 1] across the cell
+            float a = 2.0f * (f1 - 2.0f * fm + f0);
+            float b = f1 - f0 - a;
+            float c = f0;
+            float u = -1.0f;
+            if (c <= 0.0f)
+            {
+                u = 0.0f;
+            }
+            else if (std::abs(a) < 1e-6f)
+            {
+                if (f1 <= 0.0f)
+                    u = c / (c - f1);
+            }
+            else
+            {
+                float discriminant = b * b - 4.0f * a * c;
+                if (discriminant >= 0.0f)
+                {
+                    float root = std::sqrt(discriminant);
+                    float u0 = (-b - root) / (2.0f * a);
+                    float u1 = (-b + root) / (2.0f * a);
+                    if (u0 > u1)
+                        std::swap(u0, u1);
+                    if (u0 >= 0.0f && u0 <= 1.0f)
+                        u = u0;
+                    else if (u1 >= 0.0f && u1 <= 1.0f)
+                        u = u1;
+                }
+            }
+
+            if (u >= 0.0f)
+            {
+                hit.fraction = t + (tExit - t) * u;
+                hit.position = start + delta * hit.fraction;
+                float fx = glm::clamp(hit.position.x / m_spacing - cx, 0.0f, 1.0f);
+                float fz = glm::clamp(hit.position.z / m_spacing - cz, 0.0f, 1.0f);
+                hit.position.y = bilinear(corners, fx, fz);
+                hit.normal = bilinearNormal(corners, fx, fz, m_spacing);
+                return true;
+            }
+        }
+
+        if (tExit >= 1.0f)
+            break;
+        t = tExit;
+        if (tMaxX < tMaxZ)
+        {
+            cx += stepX;
+            tMaxX += tDeltaX;
+        }
+        else
+        {
+            cz += stepZ;
+            tMaxZ += tDeltaZ;
+        }
+    }
+    return false;
+}
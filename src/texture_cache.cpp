@@ -0,0 +1,130 @@
+#include "texture_cache.h"
+#include "cooked_model.h"
+#include <cstring>
+
+TextureHash hashTexture(uint32_t width, uint32_t height, const uint8_t* pixels)
+{
+    // A word at a time with a multiply and fold per word, then a final mix. Far from a
+    // cryptographic hash, but a few megabytes go through in about a millisecond and accidental
+    // collisions between 64 bit values of real images aren't a worry.
+    const uint64_t multiplier = 0x9e3779b97f4a7c15ull;
+    uint64_t hash = 0xcbf29ce484222325ull ^ (uint64_t(width) << 32 | height);
+    size_t size = size_t(width) * height * 4;
+    size_t words = size / 8;
+    for (size_t i = 0; i < words; ++i)
+    {
+        uint64_t word;
+        std::memcpy(&word, pixels + i * 8, 8);
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 32;
+    }
+    for (size_t i = words * 8; i < size; ++i)
+        hash = (hash ^ pixels[i]) * multiplier;
+
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebull;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+TextureCache::~TextureCache()
+{
+    for (const auto& [hash, entry] : m_entries)
+        glDeleteTextures(1, &entry.texture);
+}
+
+GLuint TextureCache::acquire(TextureHash hash)
+{
+    auto it = m_entries.find(hash);
+    if (it == m_entries.end())
+        return 0;
+    it->second.references++;
+    m_references++;
+    return it->second.texture;
+}
+
+GLuint TextureCache::create(TextureHash hash, const CookedMip* mips, size_t mipCount)
+{
+    if (mipCount == 0)
+        return 0;
+    Entry& entry = m_entries[hash];
+    if (entry.texture != 0)
+    {
+        // Same content already created, nothing to fill
+        entry.references++;
+        m_references++;
+        return entry.texture;
+    }
+
+    glGenTextures(1, &entry.texture);
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    for (size_t level = 0; level < mipCount; ++level)
+    {
+        glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), GL_RGBA, mips[level].width,
+                     mips[level].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        entry.bytes += mips[level].size;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(mipCount) - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    entry.references = 1;
+    m_references++;
+    m_bytes += entry.bytes;
+    m_hashes[entry.texture] = hash;
+    return entry.texture;
+}
+
+GLuint TextureCache::upload(TextureHash hash, const CookedMip* mips, size_t mipCount,
+                            const uint8_t* pixels)
+{
+    GLuint texture = acquire(hash);
+    if (texture != 0)
+        return texture;
+    texture = create(hash, mips, mipCount);
+    if (texture == 0)
+        return 0;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for (size_t level = 0; level < mipCount; ++level)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), 0, 0, mips[level].width,
+                        mips[level].height, GL_RGBA, GL_UNSIGNED_BYTE,
+                        pixels + mips[level].offset);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    markComplete(hash);
+    return texture;
+}
+
+void TextureCache::release(GLuint texture)
+{
+    auto it = m_hashes.find(texture);
+    if (it == m_hashes.end())
+        return;
+    auto entry = m_entries.find(it->second);
+    m_references--;
+    if (--entry->second.references > 0)
+        return;
+    m_bytes -= entry->second.bytes;
+    glDeleteTextures(1, &texture);
+    m_entries.erase(entry);
+    m_hashes.erase(it);
+}
+
+void TextureCache::markComplete(TextureHash hash)
+{
+    auto it = m_entries.find(hash);
+    if (it != m_entries.end())
+        it->second.complete = true;
+}
+
+bool TextureCache::isComplete(TextureHash hash) const
+{
+    auto it = m_entries.find(hash);
+    return it != m_entries.end() && it->second.complete;
+}
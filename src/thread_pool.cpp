@@ -0,0 +1,99 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : m_stopping(false)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+    m_workers.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; ++i)
+        m_workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+            if (m_stopping && m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+    if (count == 0)
+        return;
+
+    // Helpers that only get scheduled after the loop is done still touch this, so it's shared
+    struct Loop
+    {
+        std::atomic<size_t> next{ 0 };
+        size_t completed = 0;
+        size_t count = 0;
+        const std::function<void(size_t)>* body = nullptr;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto loop = std::make_shared<Loop>();
+    loop->count = count;
+    loop->body = &body;
+
+    auto run = [](Loop& state)
+    {
+        size_t finished = 0;
+        for (size_t i = state.next++; i < state.count; i = state.next++)
+        {
+            (*state.body)(i);
+            finished++;
+        }
+        if (finished == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.completed += finished;
+        if (state.completed == state.count)
+            state.done.notify_all();
+    };
+
+    size_t helpers = std::min(m_workers.size(), count - 1);
+    for (size_t i = 0; i < helpers; ++i)
+        submit([loop, run] { run(*loop); });
+
+    run(*loop);
+
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->done.wait(lock, [&] { return loop->completed == loop->count; });
+}
@@ -0,0 +1,180 @@
+#include "transform_hierarchy.h"
+#include "tiny_gltf.h"
+#include <cstring>
+#include <glm/gtc/matrix_transform.hpp>
+
+std::vector<NodeTransform> loadNodeTransforms(const tinygltf::Model& model)
+{
+    size_t count = model.nodes.size();
+    std::vector<NodeTransform> nodes(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const tinygltf::Node& node = model.nodes[i];
+        NodeTransform& out = nodes[i];
+        out.parent = -1;
+        out.hasMatrix = node.matrix.size() >= 16;
+        for (int c = 0; c < 3; ++c)
+        {
+            out.translation[c] = node.translation.size() >= 3 ? node.translation[c] : 0.0f;
+            out.scale[c] = node.scale.size() >= 3 ? node.scale[c] : 1.0f;
+        }
+        for (int c = 0; c < 4; ++c)
+            out.rotation[c] = node.rotation.size() >= 4 ? node.rotation[c] : c == 3 ? 1.0f : 0.0f;
+        for (int c = 0; c < 16; ++c)
+            out.matrix[c] = out.hasMatrix ? node.matrix[c] : c % 5 == 0 ? 1.0f : 0.0f;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (int child : model.nodes[i].children)
+        {
+            if (child >= 0 && static_cast<size_t>(child) < count)
+                nodes[child].parent = static_cast<int32_t>(i);
+        }
+    }
+    return nodes;
+}
+
+void TransformHierarchy::build(const tinygltf::Model& model)
+{
+    std::vector<NodeTransform> nodes = loadNodeTransforms(model);
+    build(nodes.data(), nodes.size());
+}
+
+void TransformHierarchy::build(const NodeTransform* nodes, size_t count)
+{
+    std::vector<int> parents(count, -1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (nodes[i].parent >= 0 && static_cast<size_t>(nodes[i].parent) < count)
+            parents[i] = nodes[i].parent;
+    }
+
+    // Children of node i are children[childStart[i]] up to childStart[i + 1]
+    std::vector<int> childStart(count + 1, 0);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (parents[i] >= 0)
+            childStart[parents[i] + 1]++;
+    }
+    for (size_t i = 0; i < count; ++i)
+        childStart[i + 1] += childStart[i];
+    std::vector<int> children(childStart[count]);
+    std::vector<int> fill(childStart.begin(), childStart.end() - 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (parents[i] >= 0)
+            children[fill[parents[i]]++] = static_cast<int>(i);
+    }
+
+    // Breadth first from the roots puts every parent before its children
+    std::vector<int> order;
+    order.reserve(count);
+    m_flatIndex.assign(count, -1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (parents[i] == -1)
+        {
+            m_flatIndex[i] = static_cast<int>(order.size());
+            order.push_back(static_cast<int>(i));
+        }
+    }
+    for (size_t next = 0; next < order.size(); ++next)
+    {
+        int node = order[next];
+        for (int c = childStart[node]; c < childStart[node + 1]; ++c)
+        {
+            m_flatIndex[children[c]] = static_cast<int>(order.size());
+            order.push_back(children[c]);
+        }
+    }
+    // Whatever a cycle kept out of reach becomes a root
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (m_flatIndex[i] == -1)
+        {
+            m_flatIndex[i] = static_cast<int>(order.size());
+            order.push_back(static_cast<int>(i));
+            parents[i] = -1;
+        }
+    }
+
+    m_parent.resize(count);
+    m_translation.resize(count);
+    m_rotation.resize(count);
+    m_scale.resize(count);
+    m_local.assign(count, glm::mat4(1.0f));
+    m_world.assign(count, glm::mat4(1.0f));
+    m_localDirty.assign(count, 1);
+    m_worldChanged.assign(count, 0);
+    m_fixedLocal.assign(count, 0);
+
+    for (size_t flat = 0; flat < count; ++flat)
+    {
+        const NodeTransform& node = nodes[order[flat]];
+        int parent = parents[order[flat]];
+        m_parent[flat] = parent >= 0 ? m_flatIndex[parent] : -1;
+
+        const float* t = node.translation;
+        const float* r = node.rotation;
+        m_translation[flat] = glm::vec3(t[0], t[1], t[2]);
+        m_rotation[flat] = glm::quat(r[3], r[0], r[1], r[2]); // glm::quat takes w first
+        m_scale[flat] = glm::vec3(node.scale[0], node.scale[1], node.scale[2]);
+        if (node.hasMatrix)
+        {
+            std::memcpy(&m_local[flat], node.matrix, sizeof(glm::mat4));
+            m_fixedLocal[flat] = 1;
+        }
+    }
+    update();
+}
+
+void TransformHierarchy::setTranslation(int node, const glm::vec3& translation)
+{
+    int flat = m_flatIndex[node];
+    m_translation[flat] = translation;
+    m_localDirty[flat] = 1;
+}
+
+void TransformHierarchy::setRotation(int node, const glm::quat& rotation)
+{
+    int flat = m_flatIndex[node];
+    m_rotation[flat] = rotation;
+    m_localDirty[flat] = 1;
+}
+
+void TransformHierarchy::setScale(int node, const glm::vec3& scale)
+{
+    int flat = m_flatIndex[node];
+    m_scale[flat] = scale;
+    m_localDirty[flat] = 1;
+}
+
+void TransformHierarchy::update()
+{
+    for (size_t i = 0; i < m_parent.size(); ++i)
+    {
+        bool changed = false;
+        if (m_localDirty[i])
+        {
+            if (!m_fixedLocal[i])
+            {
+                // T * R * S written out, no temporaries beyond the rotation matrix
+                glm::mat4 local = glm::mat4_cast(m_rotation[i]);
+                local[0] *= m_scale[i].x;
+                local[1] *= m_scale[i].y;
+                local[2] *= m_scale[i].z;
+                local[3] = glm::vec4(m_translation[i], 1.0f);
+                m_local[i] = local;
+            }
+            m_localDirty[i] = 0;
+            changed = true;
+        }
+
+        int parent = m_parent[i];
+        if (parent >= 0 && m_worldChanged[parent])
+            changed = true;
+        if (changed)
+            m_world[i] = parent >= 0 ? m_world[parent] * m_local[i] : m_local[i];
+        m_worldChanged[i] = changed;
+    }
+}
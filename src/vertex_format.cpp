@@ -0,0 +1,113 @@
+#include "vertex_format.h"
+#include <algorithm>
+#include <cstddef>
+#include <glad/glad.h>
+#include "packing.h"
+#include "skinning.h"
+
+static_assert(MAX_JOINTS <= 256, "Packed joints are uint8");
+
+size_t getVertexSize(VertexFormat format)
+{
+    return format == VertexFormat::Skinned ? sizeof(SkinnedVertex) : sizeof(StaticVertex);
+}
+
+VertexQuantization computeQuantization(const MeshVertex* vertices, size_t vertexCount)
+{
+    VertexQuantization quantization;
+    if (vertexCount == 0)
+        return quantization;
+    glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        glm::vec3 position(vertices[i].position[0], vertices[i].position[1],
+                           vertices[i].position[2]);
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    }
+    quantization.offset = boundsMin;
+    quantization.scale = boundsMax - boundsMin;
+    return quantization;
+}
+
+// The part both formats share, in the same order at the same offsets
+template <typename Packed>
+static void packCommon(const MeshVertex& vertex, const VertexQuantization& quantization,
+                       Packed& out)
+{
+    for (int c = 0; c < 3; ++c)
+    {
+        float scale = quantization.scale[c];
+        float t = scale > 0.0f ? (vertex.position[c] - quantization.offset[c]) / scale : 0.0f;
+        out.position[c] = packUnorm16(t);
+    }
+    out.position[3] = vertex.tangent[3] < 0.0f ? 0 : 65535;
+    packOctahedral(vertex.normal, out.normal);
+    packOctahedral(vertex.tangent, out.tangent);
+    out.texcoord[0] = floatToHalf(vertex.texcoord[0]);
+    out.texcoord[1] = floatToHalf(vertex.texcoord[1]);
+}
+
+void packVertices(const MeshVertex* vertices, size_t vertexCount,
+                  const VertexQuantization& quantization, StaticVertex* out)
+{
+    for (size_t i = 0; i < vertexCount; ++i)
+        packCommon(vertices[i], quantization, out[i]);
+}
+
+void packVertices(const MeshVertex* vertices, size_t vertexCount,
+                  const VertexQuantization& quantization, SkinnedVertex* out)
+{
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const MeshVertex& vertex = vertices[i];
+        SkinnedVertex& packed = out[i];
+        packCommon(vertex, quantization, packed);
+
+        // Rounded each on its own the weights can miss 255 by a step or two, the largest one
+        // takes up the difference so the skin stays affine
+        int sum = 0;
+        int largest = 0;
+        for (int j = 0; j < 4; ++j)
+        {
+            packed.joints[j] = static_cast<uint8_t>(std::min<uint16_t>(vertex.joints[j], 255));
+            packed.weights[j] = packUnorm8(vertex.weights[j]);
+            sum += packed.weights[j];
+            if (packed.weights[j] > packed.weights[largest])
+                largest = j;
+        }
+        if (sum > 0)
+            packed.weights[largest] = static_cast<uint8_t>(packed.weights[largest] + 255 - sum);
+    }
+}
+
+glm::vec3 unpackPosition(const uint16_t* position, const VertexQuantization& quantization)
+{
+    glm::vec3 t(unpackUnorm16(position[0]), unpackUnorm16(position[1]),
+                unpackUnorm16(position[2]));
+    return quantization.offset + t * quantization.scale;
+}
+
+void setVertexAttributes(VertexFormat format)
+{
+    // The shared fields sit at the same offsets in both
+    GLsizei stride = static_cast<GLsizei>(getVertexSize(format));
+    glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                          (void*)offsetof(StaticVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, stride,
+                          (void*)offsetof(StaticVertex, texcoord));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(8, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(StaticVertex, normal));
+    glEnableVertexAttribArray(8);
+    glVertexAttribPointer(9, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(StaticVertex, tangent));
+    glEnableVertexAttribArray(9);
+    if (format != VertexFormat::Skinned)
+        return;
+    // Joints, integers all the way to the shader
+    glVertexAttribIPointer(2, 4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(SkinnedVertex, joints));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                          (void*)offsetof(SkinnedVertex, weights));
+    glEnableVertexAttribArray(3);
+}